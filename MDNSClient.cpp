@@ -10,105 +10,671 @@
 MDNSClient::MDNSClient(mdns::MDns &mdns, Print& debug) {
 	_mdns = &mdns;
 	_debug = &debug;
+	hosts = hostTable;
+	hostCapacity = MAX_HOSTS;
+	init();
 }
 
 MDNSClient::MDNSClient(mdns::MDns * mdns, Print * debug) {
 	_mdns = mdns;
 	_debug = debug;
+	hosts = hostTable;
+	hostCapacity = MAX_HOSTS;
+	init();
+}
+
+MDNSClient::MDNSClient(mdns::MDns &mdns, HostInfo * hosts_, int hostCapacity_,
+		Print& debug) {
+	_mdns = &mdns;
+	_debug = &debug;
+	hosts = hosts_;
+	hostCapacity = hosts_ ? hostCapacity_ : 0;
+	init();
 }
 
 MDNSClient::~MDNSClient() {
-	// TODO Auto-generated destructor stub
+	_mdns->removeListener(this);
+}
+
+void MDNSClient::init() {
+	for (int i = 0; i < hostCapacity; i++) {
+		clearHost(i);
+	}
+	for (int i = 0; i < MAX_LOOKUPS; i++) {
+		lookups[i].type = LOOKUP_NONE;
+		lookups[i].status = STATUS_UNKNOWN;
+		lookups[i].handle = INVALID_LOOKUP;
+		lookups[i].notify = false;
+		lookups[i].queued = false;
+	}
+	_mdns->addListener(this);
 }
 
 IPAddress MDNSClient::lookupHost(const char *hostName, uint16_t timeout) {
-	IPAddress result = INADDR_NONE;
-	question = (char*) malloc(strlen(hostName) + 1);
-	Callback * oldCallback = _mdns->getCallback();
-	strcpy(question, hostName);
-	_mdns->setCallback(this);
-	unsigned long startedAt = millis();
+	const LookupHandle handle = startLookupHost(hostName, timeout);
+	while (getStatus(handle) == STATUS_PENDING) {
+		poll();
+	}
+	return getHostAddress(handle);
+}
+
+bool MDNSClient::lookupHost6(const char *hostName, uint8_t address[16],
+		uint16_t timeout) {
+	const LookupHandle handle = startLookupHost6(hostName, timeout);
+	while (getStatus(handle) == STATUS_PENDING) {
+		poll();
+	}
+	return getHostAddress6(handle, address);
+}
+
+int MDNSClient::lookupService(const char *svcName, uint16_t timeout) {
+	const LookupHandle handle = startLookupService(svcName, timeout);
+	while (getStatus(handle) == STATUS_PENDING) {
+		poll();
+	}
+	return getStatus(handle) == STATUS_RESOLVED ? getHostCount(handle) : 0;
+}
+
+int MDNSClient::lookupHosts(const char * const * hostNames, int count,
+		IPAddress * results, uint16_t timeout) {
+	const unsigned long started = millis();
+	const RecordCache &cache = _mdns->getCache();
+	int resolved = 0;
+	int waiting = 0;
+	int questions = 0;
 	_mdns->Clear();
-	struct Query query;
-	query.qclass = 1;    // "INternet"
-	query.qtype = MDNS_TYPE_A;
-	query.unicast_response = 0;
-	strncpy(query.qname_buffer, question, MAX_MDNS_NAME_LEN);
-	_mdns->AddQuery(query);
-	lookupType = LOOKUP_HOST;
-	clearHostsCache();
-	_mdns->Send();
+	for (int i = 0; i < count; i++) {
+		results[i] = INADDR_NONE;
+		DnsName name;
+		if (!name.set(hostNames[i])) {
+			continue;
+		}
+		const CacheEntry * cached = cache.find(name, MDNS_TYPE_A, started);
+		if (cached) {
+			results[i] = cached->getIPv4();
+			resolved++;
+			continue;
+		}
+		// As many questions to a packet as fit. One too big for a packet of
+		// its own is left unasked.
+		bool added = _mdns->AddRawQuery(name.getWire(), name.getLength(),
+				MDNS_TYPE_A, 1);
+		if (!added and questions) {
+			_mdns->Send();
+			_mdns->Clear();
+			questions = 0;
+			added = _mdns->AddRawQuery(name.getWire(), name.getLength(),
+					MDNS_TYPE_A, 1);
+		}
+		if (added) {
+			questions++;
+			waiting++;
+		}
+	}
+	if (questions) {
+		_mdns->Send();
+	}
 
-	while (millis() - startedAt < timeout) {
-		_mdns->loop();
-		if(hosts[0].host == question and hosts[0].ip != INADDR_NONE)
-		{
-			result = hosts[0].ip;
+	// processHostRecord() fills in the results as the answers arrive.
+	batchNames = hostNames;
+	batchResults = results;
+	batchCount = count;
+	batchWaiting = waiting;
+	while (batchWaiting > 0 and millis() - started < timeout) {
+		if (pending) {
+			poll();
+		} else {
+			_mdns->loop();
+		}
+	}
+	resolved += waiting - batchWaiting;
+	batchCount = 0;
+	batchWaiting = 0;
+	return resolved;
+}
+
+MDNSClient::LookupHandle MDNSClient::startLookupHost(const char *hostName,
+		uint16_t timeout, LookupCallback callback) {
+	return startLookup(LOOKUP_HOST, hostName, timeout, callback);
+}
+
+MDNSClient::LookupHandle MDNSClient::startLookupHost6(const char *hostName,
+		uint16_t timeout, LookupCallback callback) {
+	return startLookup(LOOKUP_HOST6, hostName, timeout, callback);
+}
+
+MDNSClient::LookupHandle MDNSClient::startLookupHostDual(const char *hostName,
+		uint16_t timeout, LookupCallback callback) {
+	return startLookup(LOOKUP_HOST_DUAL, hostName, timeout, callback);
+}
+
+MDNSClient::LookupHandle MDNSClient::startLookupService(const char *svcName,
+		uint16_t timeout, LookupCallback callback) {
+	return startLookup(LOOKUP_SERVICE, svcName, timeout, callback);
+}
+
+MDNSClient::LookupHandle MDNSClient::startBrowse(const char *svcName,
+		LookupCallback callback, unsigned long maxInterval) {
+	const LookupHandle handle = startLookup(LOOKUP_BROWSE, svcName, 0,
+			callback);
+	if (handle != INVALID_LOOKUP) {
+		Lookup &lookup = lookups[slotOf(handle)];
+		lookup.interval = 1000;
+		lookup.maxInterval = maxInterval < 1000 ? 1000 : maxInterval;
+		// Report what the cache already knows on the first poll().
+		lookup.found = getHostCount(handle);
+		lookup.notify = lookup.found > 0;
+	}
+	return handle;
+}
+
+MDNSClient::LookupHandle MDNSClient::startLookup(LookupType type,
+		const char *name, uint16_t timeout, LookupCallback callback) {
+	// Take the free slot which has been idle longest, so recent results stay
+	// readable for as long as possible.
+	int slot = -1;
+	for (int i = 1; i <= MAX_LOOKUPS; i++) {
+		const int candidate = (slotOf(lastHandle) + i) % MAX_LOOKUPS;
+		if (lookups[candidate].status != STATUS_PENDING
+				and !lookups[candidate].notify) {
+			slot = candidate;
 			break;
 		}
 	}
-	lookupType = LOOKUP_NONE;
-	_mdns->setCallback(oldCallback);
-	free(question);
-	question = NULL;
+	if (slot < 0) {
+		return INVALID_LOOKUP;
+	}
+	Lookup &lookup = lookups[slot];
+	if (!lookup.name.set(name)) {
+		return INVALID_LOOKUP;
+	}
 
-	return result;
+	// Handles carry the slot in their low bits and a sequence number above
+	// it, so a stale handle never matches a reused slot.
+	const LookupHandle sequence = lastHandle < 0 ?
+			0 : (lastHandle / MAX_LOOKUPS + 1) % (0x7FFF / MAX_LOOKUPS);
+	lastHandle = sequence * MAX_LOOKUPS + slot;
+	lookup.handle = lastHandle;
+	lookup.type = type;
+	lookup.status = STATUS_PENDING;
+	lookup.startedAt = millis();
+	lookup.timeout = timeout;
+	lookup.callback = callback;
+	lookup.ip = INADDR_NONE;
+	lookup.ip6Found = false;
+	lookup.notify = false;
+	lookup.queued = false;
+	lookup.missing = 0;
+	lookup.followUps = 0;
+	pending++;
+	clearHosts(slot);
+
+	// Answer from the records already heard while they are still valid.
+	if (isHostLookup(type)) {
+		const RecordCache &cache = _mdns->getCache();
+		const CacheEntry * cached = NULL;
+		if (type != LOOKUP_HOST6
+				and (cached = cache.find(lookup.name, MDNS_TYPE_A,
+						lookup.startedAt))) {
+			lookup.ip = cached->getIPv4();
+		}
+		if (type != LOOKUP_HOST
+				and (cached = cache.find(lookup.name, MDNS_TYPE_AAAA,
+						lookup.startedAt))) {
+			lookup.ip6Found = cached->getIPv6(lookup.ip6);
+		}
+	} else if (serviceFromCache(slot) == 0) {
+		// Partial results would only get in the way of the answers.
+		clearHosts(slot);
+	}
+	if (type != LOOKUP_BROWSE and isResolved(slot, lookup.startedAt)) {
+		finishLookup(slot, STATUS_RESOLVED);
+		return lookup.handle;
+	}
+
+	lookup.queued = true;
+	queued++;
+	return lookup.handle;
 }
 
-int MDNSClient::lookupService(const char *svcName, uint16_t timeout) {
-	int result = 0;
-	question = (char*) malloc(strlen(svcName) + 1);
-	Callback * oldCallback = _mdns->getCallback();
-	strcpy(question, svcName);
-	_mdns->setCallback(this);
-	unsigned long startedAt = millis();
-	_mdns->Clear();
-	struct Query query;
-	query.qclass = 1;    // "INternet"
-	query.qtype = MDNS_TYPE_PTR;
-	query.unicast_response = 0;
-	strncpy(query.qname_buffer, question, MAX_MDNS_NAME_LEN);
-	_mdns->AddQuery(query);
-	lookupType = LOOKUP_SERVICE;
-	clearHostsCache();
-	_mdns->Send();
+// Send the questions of all lookups started since the last poll(), as many
+// to a packet as will fit, followed by their Known Answers.
+void MDNSClient::sendQueries() {
+	const unsigned long now = millis();
+
+	int slot = 0;
+	while (queued) {
+		int batch[MAX_LOOKUPS];
+		int questions = 0;
+		_mdns->Clear();
+		for (; slot < MAX_LOOKUPS; slot++) {
+			if (!lookups[slot].queued) {
+				continue;
+			}
+			const DnsName &name = lookups[slot].name;
+			uint16_t types[2];
+			const int count = questionTypes(lookups[slot].type, types);
+			const bool added = _mdns->AddRawQuery(name.getWire(),
+					name.getLength(), types[0], 1);
+			if (!added and questions) {
+				// Packet full: this question starts the next one.
+				break;
+			}
+			// A question too big for a packet of its own is dropped and
+			// left to time out.
+			lookups[slot].queued = false;
+			queued--;
+			if (added) {
+				batch[questions++] = slot;
+				// The AAAA question of a dual-stack lookup only takes a pointer
+				// to the name just written. If even that doesn't fit, the A
+				// question goes alone.
+				for (int i = 1; i < count; i++) {
+					_mdns->AddRawQuery(name.getWire(), name.getLength(), types[i],
+							1);
+				}
+			}
+		}
+		// Known Answers go after all the questions, spilling over into
+		// packets of their own if need be.
+		for (int i = 0; i < questions; i++) {
+			addKnownAnswers(batch[i], now);
+		}
+		if (questions) {
+			_mdns->Send();
+		}
+	}
+}
+
+// List the cached answers to a lookup's question which have at least half
+// their TTL left (RFC 6762 section 7.1).
+void MDNSClient::addKnownAnswers(int slot, unsigned long now) {
+	const RecordCache &cache = _mdns->getCache();
+	uint16_t types[2];
+	const int count = questionTypes(lookups[slot].type, types);
+	for (int i = 0; i < count; i++) {
+		const CacheEntry * entry = NULL;
+		while ((entry = cache.find(lookups[slot].name, types[i], now, entry))) {
+			if (entry->remaining(now) <= entry->rrttl * 500) {
+				continue;
+			}
+			if (types[i] == MDNS_TYPE_PTR) {
+				// A suppressed PTR brings no SRV or A records along with it, so
+				// only list instances we can resolve without them.
+				const CacheEntry * srv = cache.find(entry->rdata, MDNS_TYPE_SRV,
+						now);
+				if (!srv or !cache.find(srv->rdata + 6, MDNS_TYPE_A, now)) {
+					continue;
+				}
+			}
+			if (!_mdns->AddKnownAnswer(*entry, now)) {
+				// Packet full: the rest follow in the next one, and TC tells
+				// responders to wait for them (RFC 6762 section 7.2).
+				_mdns->setTruncated();
+				_mdns->Send();
+				_mdns->Clear();
+				if (!_mdns->AddKnownAnswer(*entry, now)) {
+					return;
+				}
+			}
+		}
+	}
+}
 
-	while (millis() - startedAt < timeout) {
+void MDNSClient::poll() {
+	if (queued) {
+		sendQueries();
+	}
+	if (pending) {
 		_mdns->loop();
-		for (int i = 0; i < MAX_HOSTS; i++) {
-			if (hosts[i].host != "" and hosts[i].service != "" and hosts[i].port != 0 and hosts[i].ip != INADDR_NONE) {
-				result++;
+		const unsigned long now = millis();
+		bool followUp = false;
+		for (int i = 0; i < MAX_LOOKUPS; i++) {
+			if (lookups[i].status != STATUS_PENDING) {
+				continue;
+			}
+			if (!isHostLookup(lookups[i].type) and completeHosts(i, now)) {
+				followUp = true;
+			}
+			if (lookups[i].type == LOOKUP_BROWSE) {
+				updateBrowse(i, now);
+			} else if (isResolved(i, now)) {
+				finishLookup(i, STATUS_RESOLVED);
+			} else if (now - lookups[i].startedAt >= lookups[i].timeout) {
+				// Instances found complete still count.
+				finishLookup(i, lookups[i].type == LOOKUP_SERVICE
+						and getHostCount(lookups[i].handle) > 0 ?
+						STATUS_RESOLVED : STATUS_TIMEOUT);
 			}
 		}
-		if (result > 0) {
-			break;
+		if (followUp) {
+			sendFollowUps();
 		}
 	}
-	lookupType = LOOKUP_NONE;
-	_mdns->setCallback(oldCallback);
-	free(question);
-	question = NULL;
+	for (int i = 0; i < MAX_LOOKUPS; i++) {
+		if (lookups[i].notify) {
+			lookups[i].notify = false;
+			if (lookups[i].callback) {
+				lookups[i].callback(*this, lookups[i].handle,
+						lookups[i].status);
+			}
+		}
+	}
+}
 
+// Fill in the SRV and A records which the hosts of a service lookup lack
+// from the cache, where the Additional records of an answer leave them
+// whatever order they came in.
+// Returns whether it is time to ask for those still missing.
+bool MDNSClient::completeHosts(int slot, unsigned long now) {
+	Lookup &lookup = lookups[slot];
+	const RecordCache &cache = _mdns->getCache();
+	unsigned int missing = 0;
+	for (int i = 0; i < hostCapacity; i++) {
+		HostInfo &host = hosts[i];
+		if (host.lookup != slot or isComplete(host)) {
+			continue;
+		}
+		if (host.port == 0) {
+			const CacheEntry * srv = cache.find(DnsName(host.service),
+					MDNS_TYPE_SRV, now);
+			if (srv and srv->getRdataName(host.host, MDNS_HOST_NAME_LEN, 6)) {
+				host.port = srv->getSrvPort();
+				host.host_hash = hashDnsName(srv->rdata, srv->rdlength, 6);
+			} else {
+				host.host[0] = '\0';
+			}
+		}
+		if (host.host[0] != '\0' and host.ip == INADDR_NONE) {
+			const CacheEntry * a = cache.find(DnsName(host.host),
+					MDNS_TYPE_A, now);
+			if (a) {
+				host.ip = a->getIPv4();
+			}
+		}
+		missing += (host.port == 0) + (host.ip == INADDR_NONE);
+	}
+
+	if (missing == 0 or lookup.missing == 0 or missing < lookup.missing) {
+		// Records just found missing, or some of them came: a fresh start,
+		// giving the rest of the answer a moment to arrive.
+		lookup.followUps = 0;
+		lookup.followUpAt = now;
+	}
+	lookup.missing = missing;
+	if (missing == 0) {
+		return false;
+	}
+	const unsigned long wait = lookup.followUps == 0 ?
+			MDNS_FOLLOW_UP_DELAY : MDNS_FOLLOW_UP_INTERVAL;
+	if (lookup.followUps < MDNS_FOLLOW_UPS
+			and now - lookup.followUpAt >= wait) {
+		lookup.followUps++;
+		lookup.followUpAt = now;
+		return true;
+	}
+	return false;
+}
+
+// Ask in one packet for the SRV records of the instances found without one,
+// and the A records of the hosts found without an address.
+void MDNSClient::sendFollowUps() {
+	struct Query query;
+	query.qclass = 1;    // "INternet"
+	query.unicast_response = 0;
+	int questions = 0;
+	_mdns->Clear();
+	for (int i = 0; i < hostCapacity; i++) {
+		const HostInfo &host = hosts[i];
+		if (host.lookup < 0 or lookups[host.lookup].status != STATUS_PENDING
+				or isComplete(host)) {
+			continue;
+		}
+		const bool srv = host.port == 0;
+		const char * name = srv ? host.service : host.host;
+		const uint32_t hash = srv ? host.service_hash : host.host_hash;
+		// Several instances may share a host.
+		bool asked = false;
+		for (int j = 0; j < i and !asked; j++) {
+			asked = hosts[j].lookup >= 0
+					and lookups[hosts[j].lookup].status == STATUS_PENDING
+					and !isComplete(hosts[j]) and (hosts[j].port == 0) == srv
+					and (srv ? hosts[j].service_hash : hosts[j].host_hash) == hash
+					and strcmp(srv ? hosts[j].service : hosts[j].host, name) == 0;
+		}
+		if (asked) {
+			continue;
+		}
+		query.qtype = srv ? MDNS_TYPE_SRV : MDNS_TYPE_A;
+		strcpy(query.qname_buffer, name);
+		if (_mdns->AddQuery(query)) {
+			questions++;
+		}
+	}
+	if (questions) {
+		_mdns->Send();
+	}
+}
+
+void MDNSClient::updateBrowse(int slot, unsigned long now) {
+	Lookup &lookup = lookups[slot];
+	const int found = getHostCount(lookup.handle);
+	if (found != lookup.found) {
+		lookup.found = found;
+		lookup.notify = true;
+	}
+	if (!lookup.queued and now - lookup.startedAt >= lookup.interval) {
+		// Ask again, then wait twice as long before the next query.
+		lookup.startedAt = now;
+		lookup.interval = lookup.interval < lookup.maxInterval / 2 ?
+				lookup.interval * 2 : lookup.maxInterval;
+		lookup.queued = true;
+		queued++;
+	}
+}
+
+int MDNSClient::slotOf(LookupHandle handle) const {
+	if (handle == INVALID_LOOKUP) {
+		return MAX_LOOKUPS - 1;
+	}
+	return handle % MAX_LOOKUPS;
+}
+
+MDNSClient::LookupStatus MDNSClient::getStatus(LookupHandle handle) const {
+	if (handle == INVALID_LOOKUP
+			or lookups[slotOf(handle)].handle != handle) {
+		return STATUS_UNKNOWN;
+	}
+	return lookups[slotOf(handle)].status;
+}
+
+void MDNSClient::cancel(LookupHandle handle) {
+	if (getStatus(handle) == STATUS_UNKNOWN) {
+		return;
+	}
+	Lookup &lookup = lookups[slotOf(handle)];
+	if (lookup.status == STATUS_PENDING) {
+		pending--;
+	}
+	if (lookup.queued) {
+		lookup.queued = false;
+		queued--;
+	}
+	lookup.status = STATUS_UNKNOWN;
+	lookup.notify = false;
+	lookup.name.clear();
+}
+
+IPAddress MDNSClient::getHostAddress(LookupHandle handle) const {
+	if (getStatus(handle) != STATUS_RESOLVED
+			or (lookups[slotOf(handle)].type != LOOKUP_HOST
+					and lookups[slotOf(handle)].type != LOOKUP_HOST_DUAL)) {
+		return INADDR_NONE;
+	}
+	return lookups[slotOf(handle)].ip;
+}
+
+bool MDNSClient::getHostAddress6(LookupHandle handle, uint8_t address[16]) const {
+	if (getStatus(handle) != STATUS_RESOLVED
+			or !lookups[slotOf(handle)].ip6Found) {
+		return false;
+	}
+	memcpy(address, lookups[slotOf(handle)].ip6, 16);
+	return true;
+}
+
+bool MDNSClient::isHostLookup(LookupType type) {
+	return type == LOOKUP_HOST or type == LOOKUP_HOST6
+			or type == LOOKUP_HOST_DUAL;
+}
+
+// Record types a lookup asks for. Returns how many.
+int MDNSClient::questionTypes(LookupType type, uint16_t types[2]) {
+	switch (type) {
+	case LOOKUP_HOST:
+		types[0] = MDNS_TYPE_A;
+		return 1;
+	case LOOKUP_HOST6:
+		types[0] = MDNS_TYPE_AAAA;
+		return 1;
+	case LOOKUP_HOST_DUAL:
+		types[0] = MDNS_TYPE_A;
+		types[1] = MDNS_TYPE_AAAA;
+		return 2;
+	default:
+		types[0] = MDNS_TYPE_PTR;
+		return 1;
+	}
+}
+
+bool MDNSClient::isComplete(const HostInfo& host) {
+	return host.host[0] != '\0' and host.service[0] != '\0' and host.port != 0
+			and host.ip != INADDR_NONE;
+}
+
+int MDNSClient::getHostCount(LookupHandle handle) const {
+	if (getStatus(handle) == STATUS_UNKNOWN) {
+		return 0;
+	}
+	int result = 0;
+	for (int i = 0; i < hostCapacity; i++) {
+		if (hosts[i].lookup == slotOf(handle) and isComplete(hosts[i])) {
+			result++;
+		}
+	}
 	return result;
 }
 
-void MDNSClient::onAnswer(const Answer *answer) {
-	switch (lookupType) {
-		case LOOKUP_HOST:
-			processHostAnswer(answer);
-			break;
-		case LOOKUP_SERVICE:
-			processServiceAnswer(answer);
-			break;
-		default:
+const HostInfo * MDNSClient::getHost(LookupHandle handle, int index) const {
+	if (getStatus(handle) == STATUS_UNKNOWN) {
+		return NULL;
+	}
+	for (int i = 0; i < hostCapacity; i++) {
+		if (hosts[i].lookup == slotOf(handle) and isComplete(hosts[i])
+				and index-- == 0) {
+			return &hosts[i];
+		}
+	}
+	return NULL;
+}
+
+TxtIterator MDNSClient::getTxt(const HostInfo * host, bool * truncated) const {
+	if (truncated) {
+		*truncated = false;
+	}
+	if (!host or host->service[0] == '\0') {
+		return TxtIterator();
+	}
+	const CacheEntry * txt = _mdns->getCache().find(
+			DnsName(host->service), MDNS_TYPE_TXT, millis());
+	if (!txt) {
+		return TxtIterator();
+	}
+	if (truncated) {
+		*truncated = txt->truncated;
+	}
+	return txt->getTxt();
+}
+
+bool MDNSClient::isResolved(int slot, unsigned long now) const {
+	const Lookup &lookup = lookups[slot];
+	if (isHostLookup(lookup.type)) {
+		return lookup.ip != INADDR_NONE or lookup.ip6Found;
+	}
+	// Wait for the instances still missing records until the last
+	// follow-up has had its chance.
+	return getHostCount(lookup.handle) > 0 and (lookup.missing == 0
+			or (lookup.followUps == MDNS_FOLLOW_UPS
+					and now - lookup.followUpAt >= MDNS_FOLLOW_UP_INTERVAL));
+}
+
+void MDNSClient::finishLookup(int slot, LookupStatus status) {
+	lookups[slot].status = status;
+	lookups[slot].notify = true;
+	lookups[slot].name.clear();
+	pending--;
+}
+
+// Fill hosts[] from the PTR -> SRV -> A chain in the record cache.
+// Returns the number of complete hosts.
+int MDNSClient::serviceFromCache(int slot) {
+	RecordCache &cache = _mdns->getCache();
+	const unsigned long now = millis();
+	int result = 0;
+
+	const CacheEntry * ptr = NULL;
+	while ((ptr = cache.find(lookups[slot].name, MDNS_TYPE_PTR, now, ptr))) {
+		const CacheEntry * srv = cache.find(ptr->rdata, MDNS_TYPE_SRV, now);
+		if (!srv) {
+			continue;
+		}
+		const CacheEntry * a = cache.find(srv->rdata + 6, MDNS_TYPE_A, now);
+		if (!a) {
+			continue;
+		}
+		int i = 0;
+		while (i < hostCapacity and hosts[i].lookup != -1) {
+			i++;
+		}
+		if (i == hostCapacity) {
 			break;
+		}
+		if (!ptr->getRdataName(hosts[i].service, MDNS_HOST_NAME_LEN)
+				or !srv->getRdataName(hosts[i].host, MDNS_HOST_NAME_LEN, 6)) {
+			clearHost(i);
+			continue;
+		}
+		hosts[i].service_hash = srv->name_hash;
+		hosts[i].host_hash = a->name_hash;
+		hosts[i].port = srv->getSrvPort();
+		hosts[i].ip = a->getIPv4();
+		hosts[i].lookup = slot;
+		result++;
+	}
+	return result;
+}
+
+void MDNSClient::onRecord(const RecordView &record) {
+	if (!pending and !batchWaiting) {
+		return;
 	}
+	if (record.rrtype != MDNS_TYPE_A and record.rrtype != MDNS_TYPE_PTR
+			and record.rrtype != MDNS_TYPE_SRV
+			and record.rrtype != MDNS_TYPE_AAAA) {
+		return;
+	}
+
+	// Hash the name once; each waiter then rejects the record on its hash.
+	const uint32_t hash = hashDnsName(record.packet, record.packet_size,
+			record.name_offset);
+	processHostRecord(record, hash);
+	processServiceRecord(record, hash);
 
 #ifdef DEBUG_OUTPUT
 	if (_debug) {
 		_debug->println("======================= RESULTS ===================");
-		for (int i = 0; i < MAX_HOSTS; ++i) {
-			if (hosts[i].service != "" || hosts[i].host != "") {
+		for (int i = 0; i < hostCapacity; ++i) {
+			if (hosts[i].service[0] != '\0' || hosts[i].host[0] != '\0') {
 				_debug->print(">  ");
 				_debug->print(hosts[i].service);
 				_debug->print("    ");
@@ -125,95 +691,151 @@ void MDNSClient::onAnswer(const Answer *answer) {
 }
 
 
-void MDNSClient::processHostAnswer(const Answer* answer) {
+void MDNSClient::processHostRecord(const RecordView& record, uint32_t hash) {
 	// A typical A record matches an FQDN to network ipv4 address.
 	// eg:
 	//   name:    twinkle.local
 	//   address: 192.168.192.9
-	if (answer->rrtype == MDNS_TYPE_A and strcmp(answer->name_buffer, question) == 0 ) {
-		hosts[0].host = answer->name_buffer;
-		hosts[0].ip = answer->ipAddress;
+	// and an AAAA record to an ipv6 address.
+	if (record.rrtype != MDNS_TYPE_A and record.rrtype != MDNS_TYPE_AAAA) {
+		return;
+	}
+	if (record.rrtype == MDNS_TYPE_A) {
+		// Hosts asked for by lookupHosts().
+		for (int i = 0; i < batchCount and batchWaiting > 0; i++) {
+			if (batchResults[i] == INADDR_NONE
+					and dnsNameEquals(record.packet, record.packet_size,
+							record.name_offset, batchNames[i])) {
+				batchResults[i] = record.getIPv4();
+				batchWaiting--;
+			}
+		}
+	}
+	const LookupType single = record.rrtype == MDNS_TYPE_A ?
+			LOOKUP_HOST : LOOKUP_HOST6;
+	for (int i = 0; i < MAX_LOOKUPS; i++) {
+		Lookup &lookup = lookups[i];
+		if (lookup.status != STATUS_PENDING
+				or (lookup.type != single and lookup.type != LOOKUP_HOST_DUAL)
+				or lookup.name.getHash() != hash
+				or !lookup.name.matches(record.packet, record.packet_size,
+						record.name_offset)) {
+			continue;
+		}
+		if (single == LOOKUP_HOST) {
+			lookup.ip = record.getIPv4();
+		} else {
+			lookup.ip6Found = record.getIPv6(lookup.ip6);
+		}
 	}
 }
 
-void MDNSClient::processServiceAnswer(const Answer* answer) {
+void MDNSClient::processServiceRecord(const RecordView& record, uint32_t hash) {
+	// Names are compared in place in the packet. Only the names which get
+	// stored in hosts[] are ever expanded.
+
 	// A typical PTR record matches service to a human readable name.
 	// eg:
 	//  service: _mqtt._tcp.local
 	//  name:    Mosquitto MQTT server on twinkle.local
-	if (answer->rrtype == MDNS_TYPE_PTR
-			and strstr(answer->name_buffer, question) != 0) {
-		unsigned int i = 0;
-		for (; i < MAX_HOSTS; ++i) {
-			if (hosts[i].service == answer->rdata_buffer) {
-				// Already in hosts[][].
-				break;
+	if (record.rrtype == MDNS_TYPE_PTR) {
+		for (int slot = 0; slot < MAX_LOOKUPS; slot++) {
+			const Lookup &lookup = lookups[slot];
+			if (lookup.status != STATUS_PENDING
+					or (lookup.type != LOOKUP_SERVICE
+							and lookup.type != LOOKUP_BROWSE)
+					or lookup.name.getHash() != hash
+					or !lookup.name.matches(record.packet, record.packet_size,
+							record.name_offset)) {
+				continue;
+			}
+			const uint32_t service_hash = hashDnsName(record.packet,
+					record.packet_size, record.rdata_offset);
+			int free = -1;
+			int i = 0;
+			for (; i < hostCapacity; ++i) {
+				if (hosts[i].lookup == slot
+						and hosts[i].service_hash == service_hash
+						and dnsNameEquals(record.packet, record.packet_size,
+								record.rdata_offset, hosts[i].service)) {
+					// Already in hosts[][].
+					break;
+				}
+				if (hosts[i].lookup == -1 and free < 0) {
+					free = i;
+				}
+			}
+			if (i < hostCapacity) {
+				if (record.rrttl == 0 and lookup.type == LOOKUP_BROWSE) {
+					// Goodbye: the instance is gone.
+					clearHost(i);
+				}
+				continue;
 			}
-			if (hosts[i].service == "") {
+			if (record.rrttl == 0) {
+				continue;
+			}
+			if (free >= 0 and record.getRdataName(hosts[free].service,
+					MDNS_HOST_NAME_LEN)) {
 				// This hosts[][] entry is still empty.
-				hosts[i].service = answer->rdata_buffer;
-				break;
+				hosts[free].service_hash = service_hash;
+				hosts[free].lookup = slot;
+			} else if (free >= 0) {
+				clearHost(free);
+#ifdef DEBUG_OUTPUT
+				if (_debug) {
+					_debug->println(" ** ERROR ** Instance name too long");
+				}
+#endif
+			} else if (_debug) {
+				char name[MAX_MDNS_NAME_LEN];
+				record.getRdataName(name, MAX_MDNS_NAME_LEN);
+				_debug->print(" ** ERROR ** No space in buffer for ");
+				_debug->print('"');
+				_debug->print(name);
+				_debug->println('"');
 			}
 		}
-		if (i == MAX_HOSTS and _debug) {
-			_debug->print(" ** ERROR ** No space in buffer for ");
-			_debug->print('"');
-			_debug->print(answer->name_buffer);
-			_debug->print('"');
-			_debug->print("  :  ");
-			_debug->print('"');
-			_debug->println(answer->rdata_buffer);
-			_debug->print('"');
-		}
 	}
 
 	// A typical SRV record matches a human readable name to port and FQDN info.
 	// eg:
 	//  name:    Mosquitto MQTT server on twinkle.local
-	//  data:    p=0;w=0;port=1883;host=twinkle.local
-	if (answer->rrtype == MDNS_TYPE_SRV) {
-		unsigned int i = 0;
-		for (; i < MAX_HOSTS; ++i) {
-			if (hosts[i].service == answer->name_buffer) {
+	//  port:    1883
+	//  target:  twinkle.local
+	if (record.rrtype == MDNS_TYPE_SRV) {
+		for (int i = 0; i < hostCapacity; ++i) {
+			if (hosts[i].lookup >= 0
+					and lookups[hosts[i].lookup].status == STATUS_PENDING
+					and hosts[i].service_hash == hash
+					and dnsNameEquals(record.packet, record.packet_size,
+							record.name_offset, hosts[i].service)) {
 				// This hosts entry matches the name of the host we are looking for
 				// so parse data for port and hostname.
-				hosts[i].port = answer->port;
-				char *host_start = strstr(answer->rdata_buffer, "host=");
-				if (host_start) {
-					host_start += 5;
-					hosts[i].host = host_start;
+				if (record.getRdataName(hosts[i].host, MDNS_HOST_NAME_LEN, 6)) {
+					hosts[i].port = record.getSrvPort();
+					hosts[i].host_hash = hashDnsName(record.packet,
+							record.packet_size, record.rdata_offset + 6);
+				} else {
+					hosts[i].host[0] = '\0';
 				}
-				break;
 			}
 		}
-		if (i == MAX_HOSTS and _debug) {
-			_debug->print(" Did not find ");
-			_debug->print('"');
-			_debug->print(answer->name_buffer);
-			_debug->print('"');
-			_debug->println(" in hosts buffer.");
-		}
 	}
 
 	// A typical A record matches an FQDN to network ipv4 address.
 	// eg:
 	//   name:    twinkle.local
 	//   address: 192.168.192.9
-	if (answer->rrtype == MDNS_TYPE_A) {
-		int i = 0;
-		for (; i < MAX_HOSTS; ++i) {
-			if (hosts[i].host == answer->name_buffer) {
-				hosts[i].ip = answer->ipAddress;
-				break;
+	if (record.rrtype == MDNS_TYPE_A) {
+		for (int i = 0; i < hostCapacity; ++i) {
+			if (hosts[i].lookup >= 0
+					and lookups[hosts[i].lookup].status == STATUS_PENDING
+					and hosts[i].host_hash == hash
+					and dnsNameEquals(record.packet, record.packet_size,
+							record.name_offset, hosts[i].host)) {
+				hosts[i].ip = record.getIPv4();
 			}
 		}
-		if (i == MAX_HOSTS and _debug) {
-			_debug->print(" Did not find ");
-			_debug->print('"');
-			_debug->print(answer->name_buffer);
-			_debug->print('"');
-			_debug->println(" in hosts buffer.");
-		}
 	}
 }
-
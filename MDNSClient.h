@@ -10,48 +10,249 @@
 
 #include "mdns.h"
 
+// Number of hosts found by service lookups which MDNSClient holds, shared
+// by all lookups. A table of another size can be handed to the constructor
+// instead; define MAX_HOSTS as 0 then to save the memory.
+#ifndef MAX_HOSTS
 #define MAX_HOSTS 4
+#endif
+
+// Longest instance or host name, as a dotted string with its '\0', which a
+// HostInfo can hold. Instances with longer names are left out of the results.
+#ifndef MDNS_HOST_NAME_LEN
+#define MDNS_HOST_NAME_LEN (MAX_MDNS_NAME_LEN < 64 ? MAX_MDNS_NAME_LEN : 64)
+#endif
+#if MDNS_HOST_NAME_LEN > MAX_MDNS_NAME_LEN
+#error "MDNS_HOST_NAME_LEN must not exceed MAX_MDNS_NAME_LEN"
+#endif
+
 #define HOSTS_SERVICE_NAME 0
 #define HOSTS_PORT 1
 #define HOSTS_HOST_NAME 2
 #define HOSTS_ADDRESS 3
 
+// Number of lookups which can be in flight at the same time.
+#ifndef MAX_LOOKUPS
+#define MAX_LOOKUPS 4
+#endif
+
+// Default ceiling of the interval between browse queries, in ms.
+#ifndef MDNS_BROWSE_MAX_INTERVAL
+#define MDNS_BROWSE_MAX_INTERVAL 3600000UL
+#endif
+
+// Service instances whose SRV or A record didn't come with the answer are
+// asked for after MDNS_FOLLOW_UP_DELAY ms, then again every
+// MDNS_FOLLOW_UP_INTERVAL ms, MDNS_FOLLOW_UPS times in all.
+#define MDNS_FOLLOW_UP_DELAY 100
+#define MDNS_FOLLOW_UP_INTERVAL 1000
+#define MDNS_FOLLOW_UPS 2
+
 using namespace mdns;
 
+// A service instance found by a lookup. Names are stored inline, so filling
+// it in never touches the heap.
 struct HostInfo {
-	String service;
-	String host;
+	char service[MDNS_HOST_NAME_LEN];  // Instance name, "" if free.
+	char host[MDNS_HOST_NAME_LEN];     // Target of its SRV record, "" if not known yet.
 	uint16_t port;
 	IPAddress ip;
+	uint32_t service_hash;  // hashDnsName() of service, for fast reject.
+	uint32_t host_hash;     // hashDnsName() of host, for fast reject.
+	int8_t lookup;          // Slot of the service lookup which owns it, -1 if free.
 };
 
+static_assert(MAX_LOOKUPS <= 127, "HostInfo::lookup can't hold a slot of MAX_LOOKUPS");
+
 class MDNSClient : public Callback {
 public:
 	enum LookupType {
 		LOOKUP_NONE,
 		LOOKUP_HOST,
-		LOOKUP_SERVICE
+		LOOKUP_SERVICE,
+		LOOKUP_BROWSE,
+		LOOKUP_HOST6,
+		LOOKUP_HOST_DUAL
+	};
+	enum LookupStatus {
+		STATUS_UNKNOWN,   // No such lookup, or it was cancelled or superseded.
+		STATUS_PENDING,   // Waiting for answers.
+		STATUS_RESOLVED,  // Answered. Results are available.
+		STATUS_TIMEOUT    // Nothing usable arrived in time.
 	};
+	typedef int LookupHandle;
+	static const LookupHandle INVALID_LOOKUP = -1;
+
+	// Called from poll() when a lookup finishes.
+	typedef void (*LookupCallback)(MDNSClient& client, LookupHandle handle,
+			LookupStatus status);
+
 	MDNSClient(MDns& mdns, Print& debug = Serial);
 	MDNSClient(MDns * mdns, Print * debug = &Serial);
+	// Keep the hosts found by service lookups in a table supplied by the
+	// caller, which must outlive the client, instead of the MAX_HOSTS built in.
+	MDNSClient(MDns& mdns, HostInfo * hosts, int hostCapacity,
+			Print& debug = Serial);
 	virtual ~MDNSClient();
+
+	// Blocking lookups. These call poll() until the lookup finishes.
 	IPAddress lookupHost(const char * hostName, uint16_t timeout = 5000);
+	bool lookupHost6(const char * hostName, uint8_t address[16],
+			uint16_t timeout = 5000);
 	int lookupService(const char *svcName, uint16_t timeout = 5000);
-	virtual void onAnswer(const Answer* answer);
+
+	// Resolve several hosts at once. Those not cached are all asked for
+	// straight away, as many to a packet as fit; no lookup slot is used.
+	// Waits until every host has answered or timeout ms have passed. Fills
+	// results[] with the addresses, INADDR_NONE for the ones not found.
+	// Returns the number of hosts resolved.
+	int lookupHosts(const char * const * hostNames, int count,
+			IPAddress * results, uint16_t timeout = 5000);
+
+	// Non-blocking lookups. Start one, then call poll() from the main loop until
+	// getStatus() is no longer STATUS_PENDING or the callback has been called.
+	// A service lookup takes the SRV and A records of each instance from the
+	// Additional records of the answer, so usually resolves in a single round
+	// trip. Only the records still missing are asked for, with one query for
+	// all instances. It resolves once every instance found is complete, or at
+	// the timeout if at least one is.
+	// Up to MAX_LOOKUPS lookups can be in flight at once; answers are handed
+	// to the right one as they arrive. Results come from the record cache
+	// straight away when possible.
+	// The question goes out on the next poll(), packed into as few packets as
+	// possible with those of other lookups started in the meantime. Answers
+	// already cached are listed with it so responders don't repeat them.
+	// Returns INVALID_LOOKUP if the name is not valid or MAX_LOOKUPS lookups
+	// are already in progress.
+	// Don't start lookups from within MDns callbacks: the query is built in the
+	// packet buffer MDns is parsing.
+	LookupHandle startLookupHost(const char * hostName, uint16_t timeout = 5000,
+			LookupCallback callback = NULL);
+	LookupHandle startLookupService(const char *svcName, uint16_t timeout = 5000,
+			LookupCallback callback = NULL);
+
+	// Host lookups by AAAA record, and by A and AAAA records at once. The
+	// dual-stack lookup asks both questions in one packet and resolves on
+	// whichever address arrives first; read them with getHostAddress() and
+	// getHostAddress6(). Answers to both usually come in the same response.
+	LookupHandle startLookupHost6(const char * hostName, uint16_t timeout = 5000,
+			LookupCallback callback = NULL);
+	LookupHandle startLookupHostDual(const char * hostName,
+			uint16_t timeout = 5000, LookupCallback callback = NULL);
+
+	// Keep browsing for instances of a service until cancelled. Queries go
+	// out at 1s, 2s, 4s... intervals up to maxInterval (RFC 6762 section 5.2),
+	// listing what has been found as Known Answers, so a long running browse
+	// costs next to no traffic. Instances accumulate in the results read with
+	// getHostCount() and getHost(); those saying goodbye are dropped.
+	// The callback is called with STATUS_PENDING whenever the results change.
+	// Uses a lookup slot, which stays STATUS_PENDING.
+	LookupHandle startBrowse(const char *svcName, LookupCallback callback = NULL,
+			unsigned long maxInterval = MDNS_BROWSE_MAX_INTERVAL);
+
+	// Advance the lookups in progress: send the questions of new lookups,
+	// call MDns::loop() once, check for completion or timeout and call the
+	// completion callbacks.
+	// Costs next to nothing when no lookup is pending.
+	void poll();
+
+	LookupStatus getStatus(LookupHandle handle) const;
+
+	// Abandon a lookup. Its callback won't be called.
+	void cancel(LookupHandle handle);
+
+	// Address found by a resolved host lookup, INADDR_NONE otherwise.
+	IPAddress getHostAddress(LookupHandle handle) const;
+
+	// Copy the IPv6 address found by a resolved AAAA or dual-stack lookup.
+	// Returns false if there is none.
+	bool getHostAddress6(LookupHandle handle, uint8_t address[16]) const;
+
+	// Hosts found by a service lookup, complete with port and address.
+	// Results stay available until the lookup's slot is reused.
+	int getHostCount(LookupHandle handle) const;
+	const HostInfo * getHost(LookupHandle handle, int index) const;
+
+	// TXT record of a host found by a service lookup, read in place in the
+	// record cache. Empty if none was received. Of a record longer than
+	// MDNS_CACHE_TXT_LEN only the leading strings which fit are kept, and
+	// truncated, if given, is set. Valid until the next poll().
+	TxtIterator getTxt(const HostInfo * host, bool * truncated = NULL) const;
+
+	// Only answers matter, so the queries of other hosts are dropped unread.
+	virtual uint8_t getInterest() const {
+		return INTEREST_RESPONSES;
+	}
+	virtual void onRecord(const RecordView& record);
 private:
+	struct Lookup {
+		DnsName name;
+		LookupHandle handle;
+		LookupType type;
+		LookupStatus status;
+		unsigned long startedAt;  // For a browse: when the last query was due.
+		uint16_t timeout;
+		unsigned long interval;     // Browse: time to the next query.
+		unsigned long maxInterval;  // Browse: ceiling of interval.
+		uint8_t found;              // Browse: complete hosts last reported.
+		unsigned int missing;       // SRV and A records the hosts lack,
+		unsigned long followUpAt;   // last changed or asked for then,
+		uint8_t followUps;          // and asked for this many times.
+		LookupCallback callback;
+		IPAddress ip;  // Result of a host lookup.
+		uint8_t ip6[16];  // Result of an AAAA lookup, if ip6Found.
+		bool ip6Found;
+		bool notify;   // callback is due on the next poll()
+		bool queued;   // question not sent yet
+	};
+
 	Print * _debug;
 	MDns * _mdns;
-	HostInfo hosts[MAX_HOSTS];
-	char * question = NULL;
-	LookupType lookupType = LOOKUP_NONE;
-	void processHostAnswer(const Answer* answer);
-	void processServiceAnswer(const Answer* answer);
-	void clearHostsCache() {
-		for (int i = 0; i < MAX_HOSTS; i++) {
-			hosts[i].host = "";
-			hosts[i].service = "";
-			hosts[i].ip = INADDR_NONE;
-			hosts[i].port = 0;
+	HostInfo * hosts;
+	int hostCapacity;
+	HostInfo hostTable[MAX_HOSTS > 0 ? MAX_HOSTS : 1];
+	Lookup lookups[MAX_LOOKUPS];
+	LookupHandle lastHandle = INVALID_LOOKUP;
+	int pending = 0;  // Number of lookups in STATUS_PENDING.
+	int queued = 0;   // Number of lookups whose question is not sent yet.
+	// Hosts of the lookupHosts() call in progress, and how many of those
+	// asked for are still unanswered.
+	const char * const * batchNames = NULL;
+	IPAddress * batchResults = NULL;
+	int batchCount = 0;
+	int batchWaiting = 0;
+
+	void init();
+	LookupHandle startLookup(LookupType type, const char * name,
+			uint16_t timeout, LookupCallback callback);
+	int slotOf(LookupHandle handle) const;
+	static bool isHostLookup(LookupType type);
+	static int questionTypes(LookupType type, uint16_t types[2]);
+	void sendQueries();
+	void addKnownAnswers(int slot, unsigned long now);
+	void updateBrowse(int slot, unsigned long now);
+	bool completeHosts(int slot, unsigned long now);
+	void sendFollowUps();
+	bool isResolved(int slot, unsigned long now) const;
+	void finishLookup(int slot, LookupStatus status);
+	static bool isComplete(const HostInfo& host);
+	int serviceFromCache(int slot);
+	void processHostRecord(const RecordView& record, uint32_t hash);
+	void processServiceRecord(const RecordView& record, uint32_t hash);
+	void clearHost(int i) {
+		hosts[i].host[0] = '\0';
+		hosts[i].service[0] = '\0';
+		hosts[i].ip = INADDR_NONE;
+		hosts[i].port = 0;
+		hosts[i].service_hash = 0;
+		hosts[i].host_hash = 0;
+		hosts[i].lookup = -1;
+	}
+	void clearHosts(int slot) {
+		for (int i = 0; i < hostCapacity; i++) {
+			if (hosts[i].lookup == slot) {
+				clearHost(i);
+			}
 		}
 	}
 };
@@ -0,0 +1,1210 @@
+/*
+ * MDNSResponder.cpp
+ *
+ * Answers the queries of other hosts for our hostname and services.
+ */
+
+#include "MDNSResponder.h"
+
+// "_services._dns-sd._udp.local", which lists the service types on offer
+// (RFC 6763 section 9).
+static const byte ENUMERATION_NAME[] = {
+	9, '_', 's', 'e', 'r', 'v', 'i', 'c', 'e', 's',
+	7, '_', 'd', 'n', 's', '-', 's', 'd',
+	4, '_', 'u', 'd', 'p',
+	5, 'l', 'o', 'c', 'a', 'l',
+	0
+};
+
+// An empty TXT record still holds one empty string (RFC 6763 section 6.1).
+static const byte EMPTY_TXT[] = { 0 };
+
+static bool isType(unsigned int qtype, unsigned int rrtype) {
+	return qtype == rrtype or qtype == 255;  // 255: "ANY"
+}
+
+static bool isDigit(char c) {
+	return c >= '0' and c <= '9';
+}
+
+// Next label to try after a conflict: "name" -> "name-2" -> "name-3" for a
+// host, "Name" -> "Name (2)" -> "Name (3)" for a service instance (RFC 6763
+// appendix D). label holds up to 63 characters and room for the suffix.
+static void nextLabel(char *label, bool service) {
+	unsigned int length = strlen(label);
+	unsigned long n = 1;
+	// Take off the number of a previous rename.
+	if (service and length > 0 and label[length - 1] == ')') {
+		unsigned int i = length - 1;
+		while (i > 0 and isDigit(label[i - 1])) {
+			i--;
+		}
+		if (i < length - 1 and i >= 2 and label[i - 1] == '('
+				and label[i - 2] == ' ') {
+			n = strtoul(label + i, NULL, 10);
+			length = i - 2;
+		}
+	} else if (!service) {
+		unsigned int i = length;
+		while (i > 0 and isDigit(label[i - 1])) {
+			i--;
+		}
+		if (i < length and i >= 1 and label[i - 1] == '-') {
+			n = strtoul(label + i, NULL, 10);
+			length = i - 1;
+		}
+	}
+	char suffix[16];
+	snprintf(suffix, sizeof(suffix), service ? " (%lu)" : "-%lu", n + 1);
+	if (length + strlen(suffix) > 63) {
+		length = 63 - strlen(suffix);
+	}
+	strcpy(label + length, suffix);
+}
+
+MDNSResponder::MDNSResponder(MDns &mdns, Print& debug) {
+	_mdns = &mdns;
+	_debug = &debug;
+	init();
+}
+
+MDNSResponder::MDNSResponder(MDns * mdns, Print * debug) {
+	_mdns = mdns;
+	_debug = debug;
+	init();
+}
+
+MDNSResponder::~MDNSResponder() {
+	_mdns->removeListener(this);
+}
+
+void MDNSResponder::init() {
+	for (int i = 0; i < MDNS_RESPONDER_SERVICES; i++) {
+		services[i].used = false;
+	}
+	hostClaim.state = CLAIM_DONE;
+	answers.clear();
+	additionals.clear();
+	scheduled.clear();
+	scheduledAdditionals.clear();
+	conflicts.clear();
+	deferred.clear();
+	challenged.clear();
+	memset(lastMulticast, 0, sizeof(lastMulticast));
+	memset(due, 0, sizeof(due));
+	resetStatistics();
+	rebuildIndex();
+	_mdns->addListener(this);
+}
+
+bool MDNSResponder::setHostname(const char *hostName, IPAddress address) {
+	this->address = address;
+	const bool valid = hostname.set(hostName);
+	forgetMulticast(-1);
+	rebuildIndex();
+	if (valid) {
+		startProbing(hostClaim, random(MDNS_PROBE_INTERVAL));
+	}
+	return valid;
+}
+
+void MDNSResponder::setAddress(IPAddress address) {
+	this->address = address;
+	forgetMulticast(-1);
+	if ((hostClaim.state == CLAIM_ANNOUNCING or hostClaim.state == CLAIM_DONE)
+			and !hostname.empty()) {
+		startAnnouncing(hostClaim);
+	}
+}
+
+bool MDNSResponder::getHostname(char *buffer, int buffer_len) const {
+	if (buffer_len <= 0) {
+		return false;
+	}
+	return decodeDnsName(buffer, 0, buffer_len, hostname.getWire(),
+			hostname.getLength(), 0) >= 0 and (int) strlen(buffer)
+			< buffer_len - 1;
+}
+
+bool MDNSResponder::getServiceInstance(int id, char *buffer,
+		int buffer_len) const {
+	if (id < 0 or id >= MDNS_RESPONDER_SERVICES or !services[id].used
+			or buffer_len <= 0) {
+		return false;
+	}
+	const byte * label = pool + services[id].name;
+	const int length = label[0] < buffer_len ? label[0] : buffer_len - 1;
+	memcpy(buffer, label + 1, length);
+	buffer[length] = '\0';
+	return length == label[0];
+}
+
+bool MDNSResponder::isClaimed() const {
+	if (isProbing(RECORD_HOST)) {
+		return false;
+	}
+	for (int i = 0; i < MDNS_RESPONDER_SERVICES; i++) {
+		if (services[i].used and isProbing(recordBit(i, RECORD_SRV))) {
+			return false;
+		}
+	}
+	return true;
+}
+
+int MDNSResponder::addService(const char *instance, const char *service,
+		uint16_t port) {
+	// The instance name is a single label, dots and all.
+	const unsigned int label_length = strlen(instance);
+	DnsName type;
+	if (label_length == 0 or label_length > 63 or !type.set(service)
+			or 1 + label_length + type.getLength() > MAX_MDNS_NAME_LEN - 1) {
+		return -1;
+	}
+	int id = 0;
+	while (id < MDNS_RESPONDER_SERVICES and services[id].used) {
+		id++;
+	}
+	const unsigned int name_length = 1 + label_length + type.getLength();
+	if (id == MDNS_RESPONDER_SERVICES
+			or pool_used + name_length > MDNS_RESPONDER_POOL_SIZE) {
+		return -1;
+	}
+
+	Service &entry = services[id];
+	entry.name = pool_used;
+	entry.name_length = name_length;
+	entry.type_offset = 1 + label_length;
+	entry.txt = entry.name + name_length;
+	entry.txt_length = 0;
+	entry.port = port;
+	pool[entry.name] = label_length;
+	memcpy(pool + entry.name + 1, instance, label_length);
+	memcpy(pool + entry.name + entry.type_offset, type.getWire(),
+			type.getLength());
+	pool_used += name_length;
+	entry.name_hash = hashDnsName(pool + entry.name, name_length, 0);
+	entry.type_hash = type.getHash();
+	entry.used = true;
+	forgetMulticast(id);
+	rebuildIndex();
+	startProbing(entry.claim, random(MDNS_PROBE_INTERVAL));
+	return id;
+}
+
+bool MDNSResponder::addServiceText(int id, const char *text) {
+	if (id < 0 or id >= MDNS_RESPONDER_SERVICES or !services[id].used) {
+		return false;
+	}
+	const unsigned int length = strlen(text);
+	Service &entry = services[id];
+	const unsigned int at = entry.txt + entry.txt_length;
+	if (length > 255 or !poolResize(at, 1 + length)) {
+		return false;
+	}
+	pool[at] = length;
+	memcpy(pool + at + 1, text, length);
+	entry.txt_length += 1 + length;
+	return true;
+}
+
+void MDNSResponder::removeService(int id) {
+	if (id < 0 or id >= MDNS_RESPONDER_SERVICES or !services[id].used) {
+		return;
+	}
+	Service &service = services[id];
+	// A name given up on belongs to another host by now.
+	if (!isProbing(recordBit(id, RECORD_SRV))) {
+		RecordMask goodbye;
+		goodbye.clear();
+		goodbye.set(recordBit(id, RECORD_PTR));
+		goodbye.set(recordBit(id, RECORD_SRV));
+		goodbye.set(recordBit(id, RECORD_TXT));
+		// The type stays listed while another instance of it is left.
+		bool last_of_type = true;
+		for (int i = 0; i < MDNS_RESPONDER_SERVICES; i++) {
+			if (i != id and services[i].used
+					and services[i].type_hash == service.type_hash
+					and dnsNameEquals(pool, pool_used,
+							services[i].name + services[i].type_offset,
+							getType(service))) {
+				last_of_type = false;
+			}
+		}
+		if (last_of_type) {
+			goodbye.set(recordBit(id, RECORD_ENUMERATION));
+		}
+		RecordMask none;
+		none.clear();
+		sendRecords(goodbye, none, REPLY_GOODBYE, 0);
+	}
+	// Answers still pending would otherwise be built from whatever takes
+	// its place in the pool.
+	dropPending(id);
+	forgetMulticast(id);
+	service.used = false;
+	poolResize(service.name, -(int) (service.name_length + service.txt_length));
+	rebuildIndex();
+}
+
+// Open a gap of delta bytes at offset at of pool, or close one if delta is
+// negative, moving the services stored after it.
+bool MDNSResponder::poolResize(unsigned int at, int delta) {
+	if (delta > 0 and pool_used + delta > MDNS_RESPONDER_POOL_SIZE) {
+		return false;
+	}
+	const unsigned int from = delta > 0 ? at : at - delta;
+	memmove(pool + at + (delta > 0 ? delta : 0), pool + from,
+			pool_used - from);
+	pool_used += delta;
+	for (int i = 0; i < MDNS_RESPONDER_SERVICES; i++) {
+		if (services[i].used and services[i].name >= at) {
+			services[i].name += delta;
+			services[i].txt += delta;
+		}
+	}
+	return true;
+}
+
+// Registration is rare, so the index is simply rebuilt every time.
+void MDNSResponder::rebuildIndex() {
+	for (unsigned int i = 0; i < INDEX_SIZE; i++) {
+		index[i].kind = NAME_NONE;
+	}
+	if (!hostname.empty()) {
+		addToIndex(hostname.getHash(), NAME_HOST, 0);
+	}
+	addToIndex(hashDnsName(ENUMERATION_NAME, sizeof(ENUMERATION_NAME), 0),
+			NAME_ENUMERATION, 0);
+	for (int i = 0; i < MDNS_RESPONDER_SERVICES; i++) {
+		Service &service = services[i];
+		if (!service.used) {
+			continue;
+		}
+		addToIndex(service.name_hash, NAME_INSTANCE, i);
+		addToIndex(service.type_hash, NAME_TYPE, i);
+
+		// The enumeration lists each type once, however many instances it has.
+		service.first_of_type = true;
+		for (int j = 0; j < i and service.first_of_type; j++) {
+			if (services[j].used and services[j].type_hash == service.type_hash
+					and dnsNameEquals(pool, pool_used,
+							services[j].name + services[j].type_offset,
+							getType(service))) {
+				service.first_of_type = false;
+			}
+		}
+	}
+}
+
+void MDNSResponder::addToIndex(uint32_t hash, NameKind kind, int service) {
+	unsigned int i = hash & (INDEX_SIZE - 1);
+	while (index[i].kind != NAME_NONE) {
+		i = (i + 1) & (INDEX_SIZE - 1);
+	}
+	index[i].hash = hash;
+	index[i].kind = kind;
+	index[i].service = service;
+}
+
+const byte * MDNSResponder::getName(const IndexEntry& entry) const {
+	switch (entry.kind) {
+	case NAME_HOST:
+		return hostname.getWire();
+	case NAME_ENUMERATION:
+		return ENUMERATION_NAME;
+	case NAME_TYPE:
+		return getType(services[entry.service]);
+	default:
+		return pool + services[entry.service].name;
+	}
+}
+
+void MDNSResponder::onPacket(const MDns* packet) {
+	query = packet->isQuery();
+	truncated = packet->isTruncated();
+	unicast = true;
+	shared = false;
+	defend = false;
+	answers.clear();
+	additionals.clear();
+	asker = packet->getRemoteIP();
+	askerPort = packet->getRemotePort();
+	queryId = packet->getQueryId();
+	legacy = query and askerPort != MDNS_SOURCE_PORT;
+	legacyCount = 0;
+}
+
+bool MDNSResponder::isInterestingAsker(IPAddress asker) const {
+	return holding and asker == holdAsker;
+}
+
+bool MDNSResponder::isInterestingQuestion(uint32_t name_hash,
+		unsigned int qtype) const {
+	for (unsigned int i = name_hash & (INDEX_SIZE - 1);
+			index[i].kind != NAME_NONE; i = (i + 1) & (INDEX_SIZE - 1)) {
+		if (index[i].hash == name_hash) {
+			return true;
+		}
+	}
+	return false;
+}
+
+void MDNSResponder::onQuestion(const QuestionView& question) {
+	if (!query or (question.qclass != 1 and question.qclass != 255)) {
+		return;
+	}
+
+	// Hash the name once and look it up. Only the names with that hash are
+	// compared, in place in the packet.
+	const uint32_t hash = hashDnsName(question.packet, question.packet_size,
+			question.name_offset);
+	bool answered = false;
+	for (unsigned int i = hash & (INDEX_SIZE - 1); index[i].kind != NAME_NONE;
+			i = (i + 1) & (INDEX_SIZE - 1)) {
+		if (index[i].hash == hash
+				and dnsNameEquals(question.packet, question.packet_size,
+						question.name_offset, getName(index[i]))) {
+			const bool matched = answerQuestion(index[i], question.qtype);
+			if (matched and legacy and legacyCount < MDNS_LEGACY_QUESTIONS) {
+				LegacyQuestion &repeat = legacyQuestions[legacyCount++];
+				repeat.name = index[i];
+				repeat.qtype = question.qtype;
+				repeat.qclass = question.qclass;
+			}
+			answered |= matched;
+		}
+	}
+
+	if (answered and !question.unicast_response) {
+		unicast = false;
+	}
+}
+
+// Mark the records of an owned name which answer a question of type qtype.
+bool MDNSResponder::answerQuestion(const IndexEntry& entry, unsigned int qtype) {
+	const int id = entry.service;
+	switch (entry.kind) {
+	case NAME_HOST:
+		if (isType(qtype, MDNS_TYPE_A)) {
+			answers.set(RECORD_HOST);
+			return true;
+		}
+		break;
+	case NAME_ENUMERATION:
+		if (isType(qtype, MDNS_TYPE_PTR)) {
+			for (int i = 0; i < MDNS_RESPONDER_SERVICES; i++) {
+				if (services[i].used and services[i].first_of_type) {
+					answers.set(recordBit(i, RECORD_ENUMERATION));
+				}
+			}
+			shared = true;
+			return true;
+		}
+		break;
+	case NAME_TYPE:
+		if (isType(qtype, MDNS_TYPE_PTR)) {
+			// Send everything needed to reach the instance, so the asker
+			// doesn't have to come back for it (RFC 6763 section 12.1).
+			answers.set(recordBit(id, RECORD_PTR));
+			additionals.set(recordBit(id, RECORD_SRV));
+			additionals.set(recordBit(id, RECORD_TXT));
+			additionals.set(RECORD_HOST);
+			shared = true;
+			return true;
+		}
+		break;
+	case NAME_INSTANCE:
+		if (isType(qtype, MDNS_TYPE_SRV)) {
+			answers.set(recordBit(id, RECORD_SRV));
+			additionals.set(RECORD_HOST);
+		}
+		if (isType(qtype, MDNS_TYPE_TXT)) {
+			answers.set(recordBit(id, RECORD_TXT));
+		}
+		return isType(qtype, MDNS_TYPE_SRV) or isType(qtype, MDNS_TYPE_TXT);
+	}
+	return false;
+}
+
+// In a query, drop the answers the asker listed as known (RFC 6762 section
+// 7.1), and those held for its truncated query if it sent one (section 7.2).
+// In a response from another host, drop the scheduled answers it has just
+// given (section 7.4). Either way only if the TTL seen is at least half of
+// ours.
+// Records of other hosts for the names we claim are checked for conflicts.
+void MDNSResponder::onRecord(const RecordView& record) {
+	RecordMask &mask = query ? answers : scheduled;
+	const bool held = query and holding and asker == holdAsker
+			and scheduled.any;
+	const bool known = (mask.any or held)
+			and (!query or record.section == SECTION_ANSWER);
+	// Queries only matter for their Known Answers, and for the records a
+	// probe proposes in its Authority section.
+	if (!known and query and record.section != SECTION_AUTHORITY) {
+		return;
+	}
+	const uint32_t hash = hashDnsName(record.packet, record.packet_size,
+			record.name_offset);
+	for (unsigned int i = hash & (INDEX_SIZE - 1); index[i].kind != NAME_NONE;
+			i = (i + 1) & (INDEX_SIZE - 1)) {
+		if (index[i].hash != hash
+				or !dnsNameEquals(record.packet, record.packet_size,
+						record.name_offset, getName(index[i]))) {
+			continue;
+		}
+		if (index[i].kind == NAME_HOST or index[i].kind == NAME_INSTANCE) {
+			checkConflict(index[i], record);
+		}
+		if (known) {
+			// Additional records the asker has are left out too.
+			dropKnownAnswer(index[i], record,
+					query ? additionals : scheduledAdditionals);
+			int dropped = dropKnownAnswer(index[i], record, mask);
+			if (held) {
+				dropKnownAnswer(index[i], record, scheduledAdditionals);
+				dropped += dropKnownAnswer(index[i], record, scheduled);
+			}
+			if (query) {
+				statistics.known_answers += dropped;
+			} else {
+				statistics.duplicates += dropped;
+			}
+		}
+	}
+}
+
+// Returns the number of records dropped from mask.
+int MDNSResponder::dropKnownAnswer(const IndexEntry& entry,
+		const RecordView& known, RecordMask& mask) {
+	const int id = entry.service;
+	int dropped = 0;
+	switch (entry.kind) {
+	case NAME_HOST:
+		if (isKnownAnswer(-1, RECORD_HOST, known)) {
+			dropped += mask.reset(RECORD_HOST);
+		}
+		break;
+	case NAME_ENUMERATION:
+		for (int i = 0; i < MDNS_RESPONDER_SERVICES; i++) {
+			if (mask.has(recordBit(i, RECORD_ENUMERATION))
+					and isKnownAnswer(i, RECORD_ENUMERATION, known)) {
+				dropped += mask.reset(recordBit(i, RECORD_ENUMERATION));
+			}
+		}
+		break;
+	case NAME_TYPE:
+		if (isKnownAnswer(id, RECORD_PTR, known)) {
+			dropped += mask.reset(recordBit(id, RECORD_PTR));
+		}
+		break;
+	case NAME_INSTANCE:
+		if (isKnownAnswer(id, RECORD_SRV, known)) {
+			dropped += mask.reset(recordBit(id, RECORD_SRV));
+		}
+		if (isKnownAnswer(id, RECORD_TXT, known)) {
+			dropped += mask.reset(recordBit(id, RECORD_TXT));
+		}
+		break;
+	}
+	return dropped;
+}
+
+// Whether known, whose name is already known to match, holds the same data
+// as one of our records, with at least half its TTL left.
+bool MDNSResponder::isKnownAnswer(int id, int record,
+		const RecordView& known) const {
+	const unsigned long ttl = id < 0 or record == RECORD_SRV ?
+			MDNS_HOST_TTL : MDNS_SERVICE_TTL;
+	return known.rrttl >= ttl / 2 and hasData(id, record, known);
+}
+
+// Whether known, whose name is already known to match, holds the same data
+// as one of our records.
+bool MDNSResponder::hasData(int id, int record,
+		const RecordView& known) const {
+	const byte * packet = known.packet;
+	const unsigned int size = known.packet_size;
+	if (id < 0) {
+		return known.rrtype == MDNS_TYPE_A and known.rdlength == 4
+				and known.getIPv4() == address;
+	}
+
+	const Service &service = services[id];
+	switch (record) {
+	case RECORD_PTR:
+		return known.rrtype == MDNS_TYPE_PTR
+				and dnsNameEquals(packet, size, known.rdata_offset,
+						pool + service.name);
+	case RECORD_SRV:
+		return known.rrtype == MDNS_TYPE_SRV and known.rdlength > 6
+				and known.getSrvPort() == service.port
+				and hostname.matches(packet, size, known.rdata_offset + 6);
+	case RECORD_TXT:
+		if (service.txt_length == 0) {
+			return known.rrtype == MDNS_TYPE_TXT and known.rdlength == 1
+					and packet[known.rdata_offset] == 0;
+		}
+		return known.rrtype == MDNS_TYPE_TXT
+				and known.rdlength == service.txt_length
+				and memcmp(packet + known.rdata_offset, pool + service.txt,
+						service.txt_length) == 0;
+	case RECORD_ENUMERATION:
+		return known.rrtype == MDNS_TYPE_PTR
+				and dnsNameEquals(packet, size, known.rdata_offset,
+						getType(service));
+	}
+	return false;
+}
+
+// A record of another host for our hostname or one of our instance names.
+// While we probe for the name, any answer for it means it's taken (RFC 6762
+// section 8.1) and a probe for it is a tiebreak (section 8.2). Once claimed,
+// only an answer with other data than ours challenges it, and it is probed
+// for again (section 9); a probe for it is to be defended.
+void MDNSResponder::checkConflict(const IndexEntry& entry,
+		const RecordView& record) {
+	const int id = entry.kind == NAME_HOST ? -1 : entry.service;
+	const Claim &claim = id < 0 ? hostClaim : services[id].claim;
+	const unsigned int bit = recordBit(id, RECORD_SRV);
+	if (claim.state == CLAIM_FAILED) {
+		return;
+	}
+	if (query) {
+		if (record.section != SECTION_AUTHORITY) {
+			return;
+		}
+		if (claim.state != CLAIM_PROBING) {
+			defend = true;
+		} else if (compareProposed(id, record) < 0) {
+			deferred.set(bit);
+		}
+		return;
+	}
+	if (claim.state == CLAIM_PROBING) {
+		conflicts.set(bit);
+	} else if (id < 0) {
+		if (record.rrtype == MDNS_TYPE_A
+				and !hasData(-1, RECORD_HOST, record)) {
+			challenged.set(bit);
+		}
+	} else if ((record.rrtype == MDNS_TYPE_SRV
+			and !hasData(id, RECORD_SRV, record))
+			or (record.rrtype == MDNS_TYPE_TXT
+			and !hasData(id, RECORD_TXT, record))) {
+		challenged.set(bit);
+	}
+}
+
+// Order of a record another host proposes in its probe against ours of the
+// same type: by class, then by rdata byte for byte with names expanded
+// (RFC 6762 section 8.2). Returns < 0 if ours comes first, so we lose, > 0
+// if theirs does and 0 if they are the same or can't be compared.
+int MDNSResponder::compareProposed(int id, const RecordView& theirs) const {
+	int record;
+	if (id < 0 and theirs.rrtype == MDNS_TYPE_A) {
+		record = RECORD_HOST;
+	} else if (id >= 0 and theirs.rrtype == MDNS_TYPE_SRV) {
+		record = RECORD_SRV;
+	} else if (id >= 0 and theirs.rrtype == MDNS_TYPE_TXT) {
+		record = RECORD_TXT;
+	} else {
+		return 0;
+	}
+	RecordData ours;
+	if (!getRecord(id, record, ours)) {
+		return 0;
+	}
+	if (theirs.rrclass != (ours.rrclass & 0x7FFF)) {
+		return theirs.rrclass > (ours.rrclass & 0x7FFF) ? -1 : 1;
+	}
+
+	const byte * data = theirs.packet + theirs.rdata_offset;
+	unsigned int length = theirs.rdlength;
+	byte expanded[6 + MAX_MDNS_NAME_LEN];
+	if (record == RECORD_SRV) {
+		if (length <= 6) {
+			return 0;
+		}
+		memcpy(expanded, data, 6);
+		const int name_length = copyDnsName(expanded + 6, MAX_MDNS_NAME_LEN,
+				theirs.packet, theirs.packet_size, theirs.rdata_offset + 6);
+		if (name_length < 0) {
+			return 0;
+		}
+		data = expanded;
+		length = 6 + name_length;
+	}
+	const int order = memcmp(ours.rdata, data,
+			ours.rdlength < length ? ours.rdlength : length);
+	if (order != 0) {
+		return order;
+	}
+	return (int) ours.rdlength - (int) length;
+}
+
+// Rename the names found to be in use and claim them again. Those which
+// lost a tiebreak keep their name and are probed for again a little later.
+// Those challenged keep it too, and are probed for again at once: the
+// answer may have been stale, and a name is only renamed if a probe finds
+// it in use. A name which can't be renamed is given up on: the old one is
+// taken.
+void MDNSResponder::resolveConflicts() {
+	unsigned long wait = MDNS_PROBE_DEFER;
+	if (conflicts.any) {
+		if (conflictCount < 255) {
+			conflictCount++;
+		}
+		wait = conflictCount >= MDNS_CONFLICT_LIMIT ?
+				MDNS_PROBE_BACKOFF : random(MDNS_PROBE_INTERVAL);
+	} else if (challenged.any) {
+		wait = random(MDNS_PROBE_INTERVAL);
+	}
+	if (conflicts.has(RECORD_HOST) or deferred.has(RECORD_HOST)
+			or challenged.has(RECORD_HOST)) {
+		if (!conflicts.has(RECORD_HOST) or renameHost()) {
+			startProbing(hostClaim, wait);
+		} else {
+			hostClaim.state = CLAIM_FAILED;
+		}
+	}
+	for (int i = 0; i < MDNS_RESPONDER_SERVICES; i++) {
+		const unsigned int bit = recordBit(i, RECORD_SRV);
+		if (services[i].used and (conflicts.has(bit) or deferred.has(bit)
+				or challenged.has(bit))) {
+			if (!conflicts.has(bit) or renameService(i)) {
+				startProbing(services[i].claim, wait);
+			} else {
+				services[i].claim.state = CLAIM_FAILED;
+			}
+		}
+	}
+	// The probe timer is shared, so a name joining probes already under way
+	// may need it pushed back.
+	probeAt = millis();
+	probeWait = wait;
+	conflicts.clear();
+	deferred.clear();
+	challenged.clear();
+}
+
+bool MDNSResponder::renameHost() {
+	const byte * wire = hostname.getWire();
+	char name[MAX_MDNS_NAME_LEN + 16];
+	memcpy(name, wire + 1, wire[0]);
+	name[wire[0]] = '\0';
+	nextLabel(name, false);
+	// Then the domain, eg: ".local".
+	const unsigned int length = strlen(name);
+	name[length] = '.';
+	// Set on a copy: a name which doesn't fit would leave none.
+	DnsName renamed;
+	if (decodeDnsName(name, length + 1, sizeof(name), wire,
+			hostname.getLength(), 1 + wire[0]) < 0 or !renamed.set(name)) {
+#ifdef DEBUG_OUTPUT
+		if (_debug) {
+			_debug->print("MDNSResponder: hostname in use, no room for ");
+			_debug->println(name);
+		}
+#endif
+		return false;
+	}
+#ifdef DEBUG_OUTPUT
+	if (_debug) {
+		_debug->print("MDNSResponder: hostname in use, trying ");
+		_debug->println(name);
+	}
+#endif
+	hostname = renamed;
+	forgetMulticast(-1);
+	rebuildIndex();
+	return true;
+}
+
+bool MDNSResponder::renameService(int id) {
+	Service &entry = services[id];
+	char label[64 + 16];
+	memcpy(label, pool + entry.name + 1, pool[entry.name]);
+	label[pool[entry.name]] = '\0';
+	nextLabel(label, true);
+	const unsigned int length = strlen(label);
+	const int delta = (int) length - pool[entry.name];
+	if (entry.name_length + delta > MAX_MDNS_NAME_LEN - 1
+			or !poolResize(entry.name + 1, delta)) {
+#ifdef DEBUG_OUTPUT
+		if (_debug) {
+			_debug->print("MDNSResponder: instance name in use, no room for ");
+			_debug->println(label);
+		}
+#endif
+		return false;
+	}
+#ifdef DEBUG_OUTPUT
+	if (_debug) {
+		_debug->print("MDNSResponder: instance name in use, trying ");
+		_debug->println(label);
+	}
+#endif
+	// poolResize() only moves the services stored after the label.
+	entry.txt += delta;
+	entry.name_length += delta;
+	entry.type_offset += delta;
+	pool[entry.name] = length;
+	memcpy(pool + entry.name + 1, label, length);
+	entry.name_hash = hashDnsName(pool + entry.name, entry.name_length, 0);
+	forgetMulticast(id);
+	rebuildIndex();
+	return true;
+}
+
+void MDNSResponder::startProbing(Claim& claim, unsigned long wait) {
+	claim.state = CLAIM_PROBING;
+	claim.count = 0;
+	// Names joining probes already under way go out with the next one.
+	if (!probing) {
+		probing = true;
+		probeAt = millis();
+		probeWait = wait;
+	}
+}
+
+void MDNSResponder::startAnnouncing(Claim& claim) {
+	claim.state = CLAIM_ANNOUNCING;
+	claim.count = 0;
+	if (!announcing) {
+		announcing = true;
+		announceAt = millis();
+		announceWait = 0;
+	}
+}
+
+// Send the next probe for the names being claimed: a question for each of
+// them, the first asking for a unicast reply, and the records we propose in
+// the Authority section. Names whose last probe went unchallenged for
+// MDNS_PROBE_INTERVAL are ours, and go on to be announced.
+void MDNSResponder::probe(unsigned long now) {
+	RecordMask proposed;
+	proposed.clear();
+	bool more = false;  // Some name is left to probe for next time.
+	_mdns->Clear();
+	for (int id = -1; id < MDNS_RESPONDER_SERVICES; id++) {
+		Claim &claim = id < 0 ? hostClaim : services[id].claim;
+		if ((id >= 0 and !services[id].used) or claim.state != CLAIM_PROBING) {
+			continue;
+		}
+		if (claim.count == MDNS_PROBE_COUNT) {
+			conflictCount = 0;
+			startAnnouncing(claim);
+			continue;
+		}
+		const unsigned int qclass = claim.count == 0 ? 0x8001 : 1;
+		const bool added = id < 0 ?
+				_mdns->AddRawQuery(hostname.getWire(), hostname.getLength(),
+						255, qclass) :
+				_mdns->AddRawQuery(pool + services[id].name,
+						services[id].name_length, 255, qclass);
+		if (added) {
+			claim.count++;
+			proposed.set(recordBit(id, RECORD_SRV));
+		}
+		more = true;
+	}
+	if (proposed.any) {
+		for (int id = -1; id < MDNS_RESPONDER_SERVICES; id++) {
+			if (!proposed.has(recordBit(id, RECORD_SRV))) {
+				continue;
+			}
+			if (id < 0) {
+				addRecord(-1, RECORD_HOST, SECTION_AUTHORITY);
+			} else {
+				addRecord(id, RECORD_SRV, SECTION_AUTHORITY);
+				addRecord(id, RECORD_TXT, SECTION_AUTHORITY);
+			}
+		}
+		_mdns->Send();
+	}
+	probing = more;
+	probeAt = now;
+	probeWait = MDNS_PROBE_INTERVAL;
+}
+
+// Multicast the records of the names just claimed, or changed
+// (RFC 6762 section 8.3).
+void MDNSResponder::announce(unsigned long now) {
+	RecordMask mask;
+	mask.clear();
+	bool more = false;  // Some name is left to announce again.
+	for (int id = -1; id < MDNS_RESPONDER_SERVICES; id++) {
+		Claim &claim = id < 0 ? hostClaim : services[id].claim;
+		if ((id >= 0 and !services[id].used)
+				or claim.state != CLAIM_ANNOUNCING) {
+			continue;
+		}
+		if (id < 0) {
+			mask.set(RECORD_HOST);
+		} else {
+			mask.set(recordBit(id, RECORD_PTR));
+			mask.set(recordBit(id, RECORD_SRV));
+			mask.set(recordBit(id, RECORD_TXT));
+			if (services[id].first_of_type) {
+				mask.set(recordBit(id, RECORD_ENUMERATION));
+			}
+		}
+		if (++claim.count == MDNS_ANNOUNCE_COUNT) {
+			claim.state = CLAIM_DONE;
+		} else {
+			more = true;
+		}
+	}
+	if (mask.any) {
+		RecordMask none;
+		none.clear();
+		sendRecords(mask, none, REPLY_MULTICAST);
+	}
+	announcing = more;
+	announceAt = now;
+	announceWait = MDNS_ANNOUNCE_INTERVAL;
+}
+
+// Whether the record belongs to a name not claimed yet or given up on, or to
+// no service.
+bool MDNSResponder::isProbing(unsigned int bit) const {
+	if (bit == RECORD_HOST) {
+		return hostClaim.state == CLAIM_PROBING
+				or hostClaim.state == CLAIM_FAILED;
+	}
+	const Service &service = services[(bit - RECORD_SERVICE) / 4];
+	return !service.used or service.claim.state == CLAIM_PROBING
+			or service.claim.state == CLAIM_FAILED;
+}
+
+void MDNSResponder::onLoop(MDns* mdns) {
+	const unsigned long now = millis();
+	if (conflicts.any or deferred.any or challenged.any) {
+		resolveConflicts();
+	}
+	if (answers.any) {
+		if (defend) {
+			// Defend our names against a probe straight away (section 8.1).
+			sendRecords(answers, additionals, REPLY_MULTICAST,
+					MDNS_DEFENSE_INTERVAL);
+		} else if (legacy) {
+			sendRecords(answers, additionals, REPLY_LEGACY);
+		} else if (unicast) {
+			sendRecords(answers, additionals, REPLY_UNICAST);
+		} else {
+			schedule(now);
+		}
+		answers.clear();
+		additionals.clear();
+	}
+	if (scheduled.any or scheduledAdditionals.any) {
+		sendDue(now);
+	}
+	if (holding and (long) (now - holdUntil) >= 0) {
+		holding = false;
+	}
+	if (probing and now - probeAt >= probeWait) {
+		probe(now);
+	}
+	if (announcing and now - announceAt >= announceWait) {
+		announce(now);
+	}
+}
+
+// Queue the answers to the query just parsed for multicast. Records only we
+// hold go out now, in a packet of their own; shared ones are held back so
+// other responders' answers can be overheard. Each record waits until its
+// own deadline, which a later query never brings forward. The answers join
+// those already due within the delay they may take, to share packets.
+void MDNSResponder::schedule(unsigned long now) {
+	if (!truncated and !shared) {
+		RecordMask unique = answers;
+		unique.remove(scheduled);
+		if (unique.any) {
+			RecordMask extra = additionals;
+			extra.remove(scheduled);
+			sendRecords(unique, extra, REPLY_MULTICAST);
+		}
+		return;
+	}
+	const unsigned long min = truncated ?
+			MDNS_TRUNCATED_DELAY_MIN : MDNS_RESPONSE_DELAY_MIN;
+	const unsigned long max = truncated ?
+			MDNS_TRUNCATED_DELAY_MAX : MDNS_RESPONSE_DELAY_MAX;
+	unsigned long at = now + random(min, max + 1);
+	for (unsigned int bit = 0; bit < RECORDS; bit++) {
+		if ((scheduled.has(bit) or scheduledAdditionals.has(bit))
+				and due[bit] - now >= min and due[bit] - now < at - now) {
+			at = due[bit];
+		}
+	}
+	for (unsigned int bit = 0; bit < RECORDS; bit++) {
+		if (!answers.has(bit) and !additionals.has(bit)) {
+			continue;
+		}
+		// Answers held for a truncated query may only wait longer.
+		if ((!scheduled.has(bit) and !scheduledAdditionals.has(bit))
+				or (truncated and (long) (at - due[bit]) > 0)) {
+			due[bit] = at;
+		}
+		if (answers.has(bit)) {
+			scheduled.set(bit);
+		} else {
+			scheduledAdditionals.set(bit);
+		}
+	}
+	if (truncated) {
+		holding = true;
+		holdAsker = asker;
+		holdUntil = at;
+	}
+}
+
+// Multicast the scheduled records whose deadline has passed.
+void MDNSResponder::sendDue(unsigned long now) {
+	RecordMask ready;
+	RecordMask extra;
+	ready.clear();
+	extra.clear();
+	for (unsigned int bit = 0; bit < RECORDS; bit++) {
+		if ((long) (now - due[bit]) < 0) {
+			continue;
+		}
+		if (scheduled.has(bit)) {
+			ready.set(bit);
+		} else if (scheduledAdditionals.has(bit)) {
+			extra.set(bit);
+		}
+	}
+	if (ready.any) {
+		sendRecords(ready, extra, REPLY_MULTICAST);
+	}
+	scheduled.remove(ready);
+	scheduledAdditionals.remove(ready);
+	scheduledAdditionals.remove(extra);
+}
+
+// Send the records of mask as answers, with those of extra not among them
+// as Additional records in the last packet, as far as they fit. Records
+// multicast less than interval ms ago are left out of a multicast.
+void MDNSResponder::sendRecords(const RecordMask& mask, const RecordMask& extra,
+		Reply reply, unsigned long interval) {
+	// The host record goes last, after the records which point to it.
+	const unsigned long now = millis();
+	const bool unicast = reply == REPLY_UNICAST or reply == REPLY_LEGACY;
+	int records = 0;   // In the packet being built.
+	bool answered = false;
+	startPacket(reply);
+	for (unsigned int n = 1; n <= 2 * RECORDS; n++) {
+		const unsigned int bit = n % RECORDS;
+		const bool answer = n <= RECORDS;
+		if (!answer and !answered) {
+			// All the answers were left out.
+			break;
+		}
+		if (!(answer ? mask.has(bit) : extra.has(bit) and !mask.has(bit))
+				or isProbing(bit)) {
+			continue;
+		}
+		if (!unicast and multicastSince(bit, now, interval)) {
+			if (answer) {
+				statistics.rate_limited++;
+			}
+			continue;
+		}
+		bool added = addRecord(bit,
+				answer ? SECTION_ANSWER : SECTION_ADDITIONAL, reply);
+		if (!added and answer and records) {
+			// Packet full: send it and carry on in a new one.
+			send(reply);
+			startPacket(reply);
+			records = 0;
+			added = addRecord(bit, SECTION_ANSWER, reply);
+		}
+		if (added) {
+			records++;
+			answered = answered or answer;
+			statistics.sent++;
+			if (!unicast) {
+				// 0 stands for never, so skip it.
+				const uint16_t tick = now >> MDNS_TICK_SHIFT;
+				lastMulticast[bit] = tick ? tick : 1;
+			}
+		}
+	}
+	if (records) {
+		send(reply);
+	}
+}
+
+// Whether the record was multicast less than interval ms before now.
+bool MDNSResponder::multicastSince(unsigned int bit, unsigned long now,
+		unsigned long interval) const {
+	if (lastMulticast[bit] == 0) {
+		return false;
+	}
+	const uint16_t elapsed = (uint16_t) (now >> MDNS_TICK_SHIFT)
+			- lastMulticast[bit];
+	// Whole ticks, so records sent exactly interval ms apart aren't held back.
+	return elapsed < interval >> MDNS_TICK_SHIFT;
+}
+
+// Take the records of a service out of the answers and conflicts pending.
+void MDNSResponder::dropPending(int id) {
+	RecordMask * const masks[] = { &answers, &additionals, &scheduled,
+			&scheduledAdditionals, &conflicts, &deferred, &challenged };
+	for (unsigned int i = 0; i < sizeof(masks) / sizeof(masks[0]); i++) {
+		for (int record = RECORD_PTR; record <= RECORD_ENUMERATION; record++) {
+			masks[i]->reset(recordBit(id, record));
+		}
+	}
+}
+
+// A new or changed record may go out straight away.
+void MDNSResponder::forgetMulticast(int id) {
+	if (id < 0) {
+		lastMulticast[RECORD_HOST] = 0;
+		return;
+	}
+	for (int record = RECORD_PTR; record <= RECORD_ENUMERATION; record++) {
+		lastMulticast[recordBit(id, record)] = 0;
+	}
+}
+
+// Start a reply. One to a legacy query repeats its ID and the questions
+// answered, so the resolver can match it up.
+void MDNSResponder::startPacket(Reply reply) {
+	_mdns->Clear();
+	if (reply != REPLY_LEGACY) {
+		return;
+	}
+	_mdns->setQueryId(queryId);
+	for (unsigned int i = 0; i < legacyCount; i++) {
+		const byte * name = getName(legacyQuestions[i].name);
+		_mdns->AddRawQuery(name, skipDnsName(name, MAX_MDNS_NAME_LEN, 0),
+				legacyQuestions[i].qtype, legacyQuestions[i].qclass);
+	}
+}
+
+void MDNSResponder::send(Reply reply) {
+	if (reply == REPLY_LEGACY) {
+		_mdns->SendUnicast(asker, askerPort);
+	} else if (reply == REPLY_UNICAST) {
+		_mdns->SendUnicast(asker);
+	} else {
+		_mdns->Send();
+	}
+}
+
+bool MDNSResponder::addRecord(unsigned int bit, Section section,
+		Reply reply) {
+	if (bit == RECORD_HOST) {
+		return addRecord(-1, RECORD_HOST, section, reply);
+	}
+	return addRecord((bit - RECORD_SERVICE) / 4, (bit - RECORD_SERVICE) % 4,
+			section, reply);
+}
+
+bool MDNSResponder::addRecord(int id, int record, Section section,
+		Reply reply) {
+	RecordData data;
+	if (!getRecord(id, record, data)) {
+		return false;
+	}
+	if (reply == REPLY_LEGACY) {
+		data.rrclass &= 0x7FFF;
+		if (data.rrttl > MDNS_LEGACY_TTL) {
+			data.rrttl = MDNS_LEGACY_TTL;
+		}
+	} else if (reply == REPLY_GOODBYE) {
+		data.rrttl = 0;
+	}
+	if (section == SECTION_AUTHORITY) {
+		return _mdns->AddRawAuthority(data.name, data.name_length, data.rrtype,
+				data.rrclass, data.rrttl, data.rdata, data.rdlength,
+				data.rdata_name_offset);
+	}
+	if (section == SECTION_ADDITIONAL) {
+		return _mdns->AddRawAdditional(data.name, data.name_length,
+				data.rrtype, data.rrclass, data.rrttl, data.rdata, data.rdlength,
+				data.rdata_name_offset);
+	}
+	return _mdns->AddRawAnswer(data.name, data.name_length, data.rrtype,
+			data.rrclass, data.rrttl, data.rdata, data.rdlength,
+			data.rdata_name_offset);
+}
+
+bool MDNSResponder::getRecord(int id, int record, RecordData& data) const {
+	// Records unique to us set the cache-flush bit (0x8000) of their class.
+	data.rrclass = 0x8001;
+	if (id < 0) {
+		if (hostname.empty()) {
+			return false;
+		}
+		for (int i = 0; i < 4; i++) {
+			data.buffer[i] = address[i];
+		}
+		data.name = hostname.getWire();
+		data.name_length = hostname.getLength();
+		data.rrtype = MDNS_TYPE_A;
+		data.rrttl = MDNS_HOST_TTL;
+		data.rdata = data.buffer;
+		data.rdlength = data.rdata_name_offset = 4;
+		return true;
+	}
+
+	const Service &service = services[id];
+	if (!service.used) {
+		return false;
+	}
+	data.name = pool + service.name;
+	data.name_length = service.name_length;
+	switch (record) {
+	case RECORD_PTR:
+	case RECORD_ENUMERATION:
+		if (record == RECORD_PTR) {
+			data.name = getType(service);
+			data.name_length = service.name_length - service.type_offset;
+			data.rdata = pool + service.name;
+			data.rdlength = service.name_length;
+		} else {
+			data.name = ENUMERATION_NAME;
+			data.name_length = sizeof(ENUMERATION_NAME);
+			data.rdata = getType(service);
+			data.rdlength = service.name_length - service.type_offset;
+		}
+		data.rrtype = MDNS_TYPE_PTR;
+		data.rrclass = 1;
+		data.rrttl = MDNS_SERVICE_TTL;
+		data.rdata_name_offset = 0;
+		return true;
+	case RECORD_SRV:
+		if (hostname.empty()) {
+			return false;
+		}
+		data.buffer[0] = data.buffer[1] = 0;  // Priority.
+		data.buffer[2] = data.buffer[3] = 0;  // Weight.
+		data.buffer[4] = service.port >> 8;
+		data.buffer[5] = service.port & 0xFF;
+		memcpy(data.buffer + 6, hostname.getWire(), hostname.getLength());
+		data.rrtype = MDNS_TYPE_SRV;
+		data.rrttl = MDNS_HOST_TTL;
+		data.rdata = data.buffer;
+		data.rdlength = 6 + hostname.getLength();
+		data.rdata_name_offset = 6;
+		return true;
+	case RECORD_TXT:
+		data.rrtype = MDNS_TYPE_TXT;
+		data.rrttl = MDNS_SERVICE_TTL;
+		if (service.txt_length == 0) {
+			data.rdata = EMPTY_TXT;
+			data.rdlength = sizeof(EMPTY_TXT);
+		} else {
+			data.rdata = pool + service.txt;
+			data.rdlength = service.txt_length;
+		}
+		data.rdata_name_offset = data.rdlength;
+		return true;
+	}
+	return false;
+}
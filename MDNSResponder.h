@@ -0,0 +1,406 @@
+/*
+ * MDNSResponder.h
+ *
+ * Answers the queries of other hosts for our hostname and services.
+ */
+
+#ifndef LIBRARIES_RTL8720DN_MDNS_MDNSRESPONDER_H_
+#define LIBRARIES_RTL8720DN_MDNS_MDNSRESPONDER_H_
+
+#include "mdns.h"
+
+// Number of service instances which can be registered.
+#ifndef MDNS_RESPONDER_SERVICES
+#define MDNS_RESPONDER_SERVICES 4
+#endif
+
+// Bytes shared by the names and TXT records of all registered services.
+#ifndef MDNS_RESPONDER_POOL_SIZE
+#define MDNS_RESPONDER_POOL_SIZE 512
+#endif
+
+// Delay of answers which other hosts may give too, in ms. Answers to several
+// queries in that window go out together (RFC 6762 section 6).
+#define MDNS_RESPONSE_DELAY_MIN 20
+#define MDNS_RESPONSE_DELAY_MAX 120
+
+// Delay of answers to a query with more Known Answers to come, in ms
+// (RFC 6762 section 7.2).
+#define MDNS_TRUNCATED_DELAY_MIN 400
+#define MDNS_TRUNCATED_DELAY_MAX 500
+
+// TTLs recommended by RFC 6762 section 10, in seconds.
+#define MDNS_HOST_TTL 120      // Records naming a host: A, SRV.
+#define MDNS_SERVICE_TTL 4500  // Everything else: PTR, TXT.
+
+// Replies to legacy resolvers, which query from a port other than 5353, are
+// plain unicast DNS: they repeat the query ID and the questions answered,
+// give TTLs of at most MDNS_LEGACY_TTL seconds and never set the cache-flush
+// bit (RFC 6762 sections 6.7 and 10.2). Questions past the first
+// MDNS_LEGACY_QUESTIONS are answered but not repeated.
+#define MDNS_LEGACY_TTL 10
+#ifndef MDNS_LEGACY_QUESTIONS
+#define MDNS_LEGACY_QUESTIONS 4
+#endif
+
+// Least time between two multicasts of the same record, in ms: once a
+// second, or four times when defending a name being probed for (RFC 6762
+// sections 6 and 8.1). Answers due sooner are dropped.
+#define MDNS_MULTICAST_INTERVAL 1000
+#define MDNS_DEFENSE_INTERVAL 250
+
+// Claiming a name before answering for it (RFC 6762 section 8): probes
+// 250 ms apart asking whether anyone else uses it, then announcements of the
+// records 1 s apart.
+#define MDNS_PROBE_COUNT 3
+#define MDNS_PROBE_INTERVAL 250
+#define MDNS_ANNOUNCE_COUNT 2
+#define MDNS_ANNOUNCE_INTERVAL 1000
+
+// Wait before probing again after losing a tiebreak with another host
+// probing for the same name, in ms (section 8.2).
+#define MDNS_PROBE_DEFER 1000
+
+// After this many conflicts in a row, probe only every MDNS_PROBE_BACKOFF ms
+// (section 8.1).
+#define MDNS_CONFLICT_LIMIT 15
+#define MDNS_PROBE_BACKOFF 5000
+
+// The time of the last multicast of each record is kept in ticks of
+// 2^MDNS_TICK_SHIFT ms, 16 bits each. They wrap after about 35 minutes.
+#define MDNS_TICK_SHIFT 5
+
+#if MDNS_RESPONDER_SERVICES > 255
+#error "MDNS_RESPONDER_SERVICES can't be more than 255"
+#endif
+
+using namespace mdns;
+
+// Smallest power of two holding at least twice names.
+static constexpr unsigned int mdnsIndexSize(unsigned int names,
+		unsigned int size = 1) {
+	return size >= 2 * names ? size : mdnsIndexSize(names, 2 * size);
+}
+
+// Responder for a hostname (A record) and DNS-SD services (PTR, SRV and TXT
+// records). Questions are matched against the registered records as the
+// packet is parsed; the reply is sent from onLoop(), once the packet has
+// been handled, and leaves out the Known Answers listed by the asker.
+// The records needed to use an answer come along as Additional records, eg:
+// SRV, TXT and A with a PTR record, so the asker needs a single query.
+// The names owned are indexed by hash, so matching a question or a Known
+// Answer costs the same however many services are registered.
+// Legacy resolvers, such as "dig -p 5353", get a unicast reply at once.
+// Answers only we can give go out straight away. Shared ones, such as PTR
+// records, wait 20-120 ms to be merged with the answers to other queries
+// into as few packets as possible, and are dropped if another host
+// multicasts them in the meantime. No record is multicast more than once a
+// second, however many queries ask for it.
+// Names are claimed from onLoop() as well: the hostname and each service
+// instance are probed for, then announced, without blocking. A name found
+// to be in use is renamed, eg: "mydevice-2.local" or "Kitchen sensor (2)",
+// and claimed again. One already claimed is first probed for again, and
+// only renamed if that finds it in use.
+class MDNSResponder : public Callback {
+public:
+	// Records left out of the answers, and why.
+	struct Statistics {
+		unsigned long sent;           // Records sent, unicast or multicast.
+		unsigned long rate_limited;   // Multicast less than a second ago.
+		unsigned long known_answers;  // Listed as known by the asker.
+		unsigned long duplicates;     // Multicast by another host meanwhile.
+	};
+
+	MDNSResponder(MDns& mdns, Print& debug = Serial);
+	MDNSResponder(MDns * mdns, Print * debug = &Serial);
+	virtual ~MDNSResponder();
+
+	// Answer for hostName, eg: "mydevice.local", with address, once it has
+	// been claimed.
+	// Returns false if the name is not valid.
+	bool setHostname(const char * hostName, IPAddress address);
+
+	// Change the address given out, eg: after a new DHCP lease. The new
+	// address is announced.
+	void setAddress(IPAddress address);
+
+	// The hostname in use, which differs from the one set if it had to be
+	// renamed. Returns false if it was truncated.
+	bool getHostname(char * buffer, int buffer_len) const;
+
+	// Register an instance of a service, eg: "Kitchen sensor" of
+	// "_http._tcp.local" on port 80. Its host is the one set by setHostname().
+	// Returns an id for addServiceText() and removeService(), or -1 if a name
+	// is not valid or there is no room left.
+	int addService(const char * instance, const char * service, uint16_t port);
+
+	// Append a string, usually "key=value", to the TXT record of a service.
+	bool addServiceText(int id, const char * text);
+
+	// Withdraw a service. Records of it already announced are multicast
+	// with a TTL of 0 at once, so other hosts drop them (RFC 6762 section
+	// 10.1); don't call it from within MDns callbacks.
+	void removeService(int id);
+
+	// The instance name of a service, which may have been renamed.
+	// Returns false if there is no such service or it was truncated.
+	bool getServiceInstance(int id, char * buffer, int buffer_len) const;
+
+	// Whether every name has been probed for. Records are only given out
+	// once their name is claimed. Stays false if a name in use could not be
+	// renamed, eg: as it would be too long; its records are not given out.
+	bool isClaimed() const;
+
+	const Statistics& getStatistics() const {
+		return statistics;
+	}
+	void resetStatistics() {
+		memset(&statistics, 0, sizeof(statistics));
+	}
+
+	// Every response, for conflicts and duplicate answers, but only the
+	// queries asking about a name owned.
+	virtual uint8_t getInterest() const {
+		return INTEREST_ALL | INTEREST_QUESTION_FILTER;
+	}
+	virtual bool isInterestingQuestion(uint32_t name_hash,
+			unsigned int qtype) const;
+	virtual bool isInterestingAsker(IPAddress asker) const;
+	virtual void onPacket(const MDns* packet);
+	virtual void onQuestion(const QuestionView& question);
+	virtual void onRecord(const RecordView& record);
+	virtual void onLoop(MDns* mdns);
+
+private:
+	// Bits of the record mask. Service i uses RECORD_SERVICE + 4 * i + offset.
+	enum {
+		RECORD_HOST = 0,
+		RECORD_SERVICE = 1,
+		RECORD_PTR = 0,         // Service type -> instance.
+		RECORD_SRV = 1,         // Instance -> port and host.
+		RECORD_TXT = 2,         // Instance -> text.
+		RECORD_ENUMERATION = 3  // _services._dns-sd._udp -> service type.
+	};
+
+	// Number of bits in the record mask: the host, then 4 per service.
+	static const unsigned int RECORDS = RECORD_SERVICE + 4 * MDNS_RESPONDER_SERVICES;
+
+	// Owned names: the hostname, the enumeration name and for each service
+	// its type and instance name. The index has twice as many buckets,
+	// rounded up to a power of two, so probe sequences stay short.
+	static const unsigned int INDEX_SIZE =
+			mdnsIndexSize(2 + 2 * MDNS_RESPONDER_SERVICES);
+
+	enum NameKind {
+		NAME_NONE,         // Empty bucket.
+		NAME_HOST,
+		NAME_ENUMERATION,
+		NAME_TYPE,
+		NAME_INSTANCE
+	};
+
+	// One bit per record, numbered by recordBit().
+	struct RecordMask {
+		uint32_t words[(RECORDS + 31) / 32];
+		bool any;  // Some bit is set.
+
+		void clear() {
+			memset(words, 0, sizeof(words));
+			any = false;
+		}
+		void set(unsigned int bit) {
+			words[bit / 32] |= (uint32_t) 1 << (bit % 32);
+			any = true;
+		}
+		// Returns whether the bit was set.
+		bool reset(unsigned int bit) {
+			const bool was = has(bit);
+			words[bit / 32] &= ~((uint32_t) 1 << (bit % 32));
+			return was;
+		}
+		bool has(unsigned int bit) const {
+			return words[bit / 32] & (uint32_t) 1 << (bit % 32);
+		}
+		void add(const RecordMask& other) {
+			for (unsigned int i = 0; i < sizeof(words) / sizeof(words[0]); i++) {
+				words[i] |= other.words[i];
+			}
+			any = any or other.any;
+		}
+		void remove(const RecordMask& other) {
+			any = false;
+			for (unsigned int i = 0; i < sizeof(words) / sizeof(words[0]); i++) {
+				words[i] &= ~other.words[i];
+				any = any or words[i];
+			}
+		}
+	};
+
+	// How the records of a reply go out.
+	enum Reply {
+		REPLY_MULTICAST,
+		REPLY_UNICAST,   // To the asker, at port 5353.
+		REPLY_LEGACY,    // To a legacy resolver, at its own port.
+		REPLY_GOODBYE    // Multicast with a TTL of 0.
+	};
+
+	enum ClaimState {
+		CLAIM_PROBING,     // count: probes sent.
+		CLAIM_ANNOUNCING,  // count: announcements sent.
+		CLAIM_DONE,
+		CLAIM_FAILED       // In use, and no name left to rename it to.
+	};
+
+	// Progress in claiming a name.
+	struct Claim {
+		uint8_t state;  // ClaimState.
+		uint8_t count;
+	};
+
+	// One of our records, ready to be added to a packet.
+	struct RecordData {
+		const byte * name;
+		unsigned int name_length;
+		unsigned int rrtype;
+		unsigned int rrclass;
+		unsigned long rrttl;
+		const byte * rdata;
+		unsigned int rdlength;
+		unsigned int rdata_name_offset;
+		byte buffer[6 + MAX_MDNS_NAME_LEN];  // rdata built on the fly.
+	};
+
+	// Bucket of the open addressing index of owned names.
+	struct IndexEntry {
+		uint32_t hash;     // hashDnsName() of the name.
+		uint8_t kind;      // NameKind.
+		uint8_t service;   // Service id for NAME_TYPE and NAME_INSTANCE.
+	};
+
+	// Names are kept in wire format in pool. The service type is the tail of
+	// the instance name, eg: "Kitchen sensor" "_http" "_tcp" "local".
+	struct Service {
+		uint16_t name;         // Offset of the instance name in pool.
+		uint16_t txt;          // Offset of the TXT rdata in pool.
+		uint16_t txt_length;
+		uint16_t port;
+		uint8_t name_length;
+		uint8_t type_offset;   // Start of the service type in the name.
+		uint32_t name_hash;    // hashDnsName() of the instance name.
+		uint32_t type_hash;    // hashDnsName() of the service type.
+		bool used;
+		bool first_of_type;    // No service before it has the same type.
+		Claim claim;           // Of the instance name.
+	};
+
+	Print * _debug;
+	MDns * _mdns;
+	DnsName hostname;
+	Claim hostClaim;
+	IPAddress address;
+	Service services[MDNS_RESPONDER_SERVICES];
+	byte pool[MDNS_RESPONDER_POOL_SIZE];
+	unsigned int pool_used = 0;
+	IndexEntry index[INDEX_SIZE];
+
+	// State of the packet being parsed.
+	bool query = false;    // It's a query.
+	bool unicast = false;  // Every question answered asked for a unicast reply.
+	bool shared = false;   // Some answer is a shared record.
+	bool truncated = false;  // More Known Answers are to come.
+	bool defend = false;   // It's another host's probe for a name we hold.
+	bool legacy = false;   // It's a legacy unicast query.
+	RecordMask answers;    // Records answering it.
+	RecordMask additionals;  // Records going with the answers.
+	IPAddress asker;
+	uint16_t askerPort = 0;
+	uint16_t queryId = 0;
+
+	// Questions of a legacy query answered, to be repeated in the reply.
+	struct LegacyQuestion {
+		IndexEntry name;
+		uint16_t qtype;
+		uint16_t qclass;
+	};
+	LegacyQuestion legacyQuestions[MDNS_LEGACY_QUESTIONS];
+	unsigned int legacyCount = 0;
+
+	// Multicast answers waiting for their delay to pass, each until its own
+	// millis() in due, by recordBit().
+	RecordMask scheduled;
+	RecordMask scheduledAdditionals;
+	unsigned long due[RECORDS];
+
+	// Some of them answer a truncated query: the Known Answers holdAsker
+	// sends until holdUntil apply to them too.
+	bool holding = false;
+	IPAddress holdAsker;
+	unsigned long holdUntil = 0;
+
+	// Names claimed by another host, names whose probe lost a tiebreak, and
+	// names we hold which another host answered for with other data, by the
+	// recordBit() of their host or SRV record.
+	RecordMask conflicts;
+	RecordMask deferred;
+	RecordMask challenged;
+
+	// Probes and announcements of the names being claimed.
+	bool probing = false;
+	unsigned long probeAt = 0;    // millis() of the last probe.
+	unsigned long probeWait = 0;  // ms from probeAt to the next.
+	bool announcing = false;
+	unsigned long announceAt = 0;
+	unsigned long announceWait = 0;
+	uint8_t conflictCount = 0;    // Since a name was last claimed.
+
+	// Tick of the last multicast of each record, by recordBit(); 0: never.
+	uint16_t lastMulticast[RECORDS];
+	Statistics statistics;
+
+	void init();
+	bool poolResize(unsigned int at, int delta);
+	void rebuildIndex();
+	void addToIndex(uint32_t hash, NameKind kind, int service);
+	const byte * getName(const IndexEntry& entry) const;
+	const byte * getType(const Service& service) const {
+		return pool + service.name + service.type_offset;
+	}
+
+	static unsigned int recordBit(int id, int record) {
+		return id < 0 ? RECORD_HOST : RECORD_SERVICE + 4 * id + record;
+	}
+
+	bool answerQuestion(const IndexEntry& entry, unsigned int qtype);
+	int dropKnownAnswer(const IndexEntry& entry, const RecordView& known,
+			RecordMask& mask);
+	bool isKnownAnswer(int id, int record, const RecordView& known) const;
+	bool hasData(int id, int record, const RecordView& known) const;
+	void checkConflict(const IndexEntry& entry, const RecordView& record);
+	int compareProposed(int id, const RecordView& theirs) const;
+	void resolveConflicts();
+	bool renameHost();
+	bool renameService(int id);
+	void startProbing(Claim& claim, unsigned long wait);
+	void startAnnouncing(Claim& claim);
+	void probe(unsigned long now);
+	void announce(unsigned long now);
+	bool isProbing(unsigned int bit) const;
+	void schedule(unsigned long now);
+	void sendDue(unsigned long now);
+	void sendRecords(const RecordMask& mask, const RecordMask& extra,
+			Reply reply, unsigned long interval = MDNS_MULTICAST_INTERVAL);
+	bool multicastSince(unsigned int bit, unsigned long now,
+			unsigned long interval) const;
+	void forgetMulticast(int id);  // id -1 for the host record.
+	void dropPending(int id);
+	// id -1 for the host record.
+	bool getRecord(int id, int record, RecordData& data) const;
+	bool addRecord(unsigned int bit, Section section = SECTION_ANSWER,
+			Reply reply = REPLY_MULTICAST);
+	bool addRecord(int id, int record, Section section = SECTION_ANSWER,
+			Reply reply = REPLY_MULTICAST);
+	void startPacket(Reply reply);
+	void send(Reply reply);
+};
+
+#endif /* LIBRARIES_RTL8720DN_MDNS_MDNSRESPONDER_H_ */
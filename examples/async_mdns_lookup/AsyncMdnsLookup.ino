@@ -0,0 +1,85 @@
+#include "Arduino.h"
+
+/*
+ * This sketch resolves the service defined by QUESTION_SERVICE without
+ * blocking loop(): the lookup is started, MDNSClient::poll() advances it on
+ * every pass and a callback reports the result. Everything else in loop()
+ * keeps running while the network is queried.
+ */
+
+
+#include "MDNSClient.h"
+
+#include "secrets.h"  // Contains the following:
+// char ssid[] = "Get off my wlan";      //  your network SSID (name)
+// char pass[] = "secretwlanpass";       // your network password
+
+int status = WL_IDLE_STATUS;        // Indicator of WiFi status
+
+#define QUESTION_SERVICE "_mqtt._tcp.local"
+
+// Make this value as large as available ram allows.
+#define MAX_MDNS_PACKET_SIZE 512
+
+WiFiUDP udp;
+
+byte buffer[MAX_MDNS_PACKET_SIZE];
+mdns::MDns my_mdns(udp, buffer, MAX_MDNS_PACKET_SIZE);
+MDNSClient mdnsClient(my_mdns);
+
+void lookupDone(MDNSClient& client, MDNSClient::LookupHandle handle,
+		MDNSClient::LookupStatus status)
+{
+	if (status != MDNSClient::STATUS_RESOLVED) {
+		Serial.println(QUESTION_SERVICE " =====> not found");
+		return;
+	}
+	for (int i = 0; i < client.getHostCount(handle); i++) {
+		const HostInfo * host = client.getHost(handle, i);
+		Serial.print(QUESTION_SERVICE " =====> ");
+		Serial.print(host->host);
+		Serial.print(":");
+		Serial.print(host->port);
+		Serial.print(" ");
+		Serial.println(host->ip);
+	}
+}
+
+void setup()
+{
+    //Initialize serial and wait for port to open:
+    Serial.begin(9600);
+    while (!Serial) {
+        ; // wait for serial port to connect. Needed for native USB port only
+    }
+
+    // attempt to connect to Wifi network:
+    while (status != WL_CONNECTED) {
+        Serial.print("Attempting to connect to WPA SSID: ");
+        status = WiFi.begin(ssid, pass);
+        delay(1000);
+    }
+
+    my_mdns.begin(); // call to startUdpMulticast
+}
+
+unsigned long timer1 = millis();
+unsigned long passes = 0;
+void loop()
+{
+	if (millis() - timer1 >= 10000)
+	{
+		timer1 = millis();
+		Serial.print(passes);
+		Serial.println(" passes through loop() in the last 10s");
+		passes = 0;
+
+		mdnsClient.startLookupService(QUESTION_SERVICE, 5000, lookupDone);
+	}
+
+	// Cheap when no lookup is pending; otherwise handles one packet at most.
+	mdnsClient.poll();
+
+	// Sensor sampling, watchdog, MQTT keepalives... keep running here.
+	passes++;
+}
@@ -0,0 +1,75 @@
+#include "Arduino.h"
+
+/*
+ * This sketch keeps track of the hosts providing the service defined by
+ * QUESTION_SERVICE. Rather than asking again every few seconds, one browse
+ * runs for as long as the sketch does: queries go out at 1s, 2s, 4s...
+ * intervals up to BROWSE_MAX_INTERVAL and new hosts are reported as they
+ * show up.
+ */
+
+
+#include "MDNSClient.h"
+
+#include "secrets.h"  // Contains the following:
+// char ssid[] = "Get off my wlan";      //  your network SSID (name)
+// char pass[] = "secretwlanpass";       // your network password
+
+int status = WL_IDLE_STATUS;        // Indicator of WiFi status
+
+#define QUESTION_SERVICE "_mqtt._tcp.local"
+
+// Longest wait between two queries, in ms.
+#define BROWSE_MAX_INTERVAL (60UL * 60 * 1000)
+
+// Make this value as large as available ram allows.
+#define MAX_MDNS_PACKET_SIZE 512
+
+WiFiUDP udp;
+
+byte buffer[MAX_MDNS_PACKET_SIZE];
+mdns::MDns my_mdns(udp, buffer, MAX_MDNS_PACKET_SIZE);
+MDNSClient mdnsClient(my_mdns);
+
+void browseChanged(MDNSClient& client, MDNSClient::LookupHandle handle,
+		MDNSClient::LookupStatus status)
+{
+	Serial.print(QUESTION_SERVICE " =====> ");
+	Serial.print(client.getHostCount(handle));
+	Serial.println(" host(s)");
+	for (int i = 0; i < client.getHostCount(handle); i++) {
+		const HostInfo * host = client.getHost(handle, i);
+		Serial.print("    ");
+		Serial.print(host->host);
+		Serial.print(":");
+		Serial.print(host->port);
+		Serial.print(" ");
+		Serial.println(host->ip);
+	}
+}
+
+void setup()
+{
+    //Initialize serial and wait for port to open:
+    Serial.begin(9600);
+    while (!Serial) {
+        ; // wait for serial port to connect. Needed for native USB port only
+    }
+
+    // attempt to connect to Wifi network:
+    while (status != WL_CONNECTED) {
+        Serial.print("Attempting to connect to WPA SSID: ");
+        status = WiFi.begin(ssid, pass);
+        delay(1000);
+    }
+
+    my_mdns.begin(); // call to startUdpMulticast
+
+    mdnsClient.startBrowse(QUESTION_SERVICE, browseChanged, BROWSE_MAX_INTERVAL);
+}
+
+void loop()
+{
+	// Sends the next query when it is due and handles one packet at most.
+	mdnsClient.poll();
+}
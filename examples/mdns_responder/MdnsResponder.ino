@@ -0,0 +1,68 @@
+#include "Arduino.h"
+
+/*
+ * This sketch makes the board discoverable: it answers for HOSTNAME with its
+ * address and advertises a web server on port 80 as SERVICE_INSTANCE.
+ * Try "ping mydevice.local" or "avahi-browse -r _http._tcp" from a PC.
+ */
+
+
+#include "MDNSResponder.h"
+
+#include "secrets.h"  // Contains the following:
+// char ssid[] = "Get off my wlan";      //  your network SSID (name)
+// char pass[] = "secretwlanpass";       // your network password
+
+int status = WL_IDLE_STATUS;        // Indicator of WiFi status
+
+#define HOSTNAME "mydevice.local"
+#define SERVICE_INSTANCE "Kitchen sensor"
+#define SERVICE_TYPE "_http._tcp.local"
+
+// Make this value as large as available ram allows.
+#define MAX_MDNS_PACKET_SIZE 512
+
+WiFiUDP udp;
+
+byte buffer[MAX_MDNS_PACKET_SIZE];
+mdns::MDns my_mdns(udp, buffer, MAX_MDNS_PACKET_SIZE);
+MDNSResponder responder(my_mdns);
+bool claimed = false;
+
+void setup()
+{
+    //Initialize serial and wait for port to open:
+    Serial.begin(9600);
+    while (!Serial) {
+        ; // wait for serial port to connect. Needed for native USB port only
+    }
+
+    // attempt to connect to Wifi network:
+    while (status != WL_CONNECTED) {
+        Serial.print("Attempting to connect to WPA SSID: ");
+        status = WiFi.begin(ssid, pass);
+        delay(1000);
+    }
+
+    responder.setHostname(HOSTNAME, WiFi.localIP());
+    int web = responder.addService(SERVICE_INSTANCE, SERVICE_TYPE, 80);
+    responder.addServiceText(web, "path=/");
+
+    my_mdns.begin(); // call to startUdpMulticast
+}
+
+void loop()
+{
+	// Questions for our records are answered from within loop(), which also
+	// claims the names, taking a second or so without holding up the sketch.
+	my_mdns.loop();
+
+	if (!claimed and responder.isClaimed()) {
+		// Another device may have had the name already.
+		char name[MAX_MDNS_NAME_LEN];
+		responder.getHostname(name, sizeof(name));
+		Serial.print("Answering as ");
+		Serial.println(name);
+		claimed = true;
+	}
+}
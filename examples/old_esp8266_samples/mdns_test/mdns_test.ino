@@ -61,30 +61,16 @@ void answerCallback(const mdns::Answer* answer) {
   // A typical SRV record matches a human readable name to port and FQDN info.
   // eg:
   //  name:    Mosquitto MQTT server on twinkle.local
-  //  data:    p=0;w=0;port=1883;host=twinkle.local
+  //  port:    1883
+  //  target:  twinkle.local
   if (answer->rrtype == MDNS_TYPE_SRV) {
     unsigned int i = 0;
     for (; i < MAX_HOSTS; ++i) {
       if (hosts[i][HOSTS_SERVICE_NAME] == answer->name_buffer) {
         // This hosts entry matches the name of the host we are looking for
-        // so parse data for port and hostname.
-        char* port_start = strstr(answer->rdata_buffer, "port=");
-        if (port_start) {
-          port_start += 5;
-          char* port_end = strchr(port_start, ';');
-          char port[1 + port_end - port_start];
-          strncpy(port, port_start, port_end - port_start);
-          port[port_end - port_start] = '\0';
-
-          if (port_end) {
-            char* host_start = strstr(port_end, "host=");
-            if (host_start) {
-              host_start += 5;
-              hosts[i][HOSTS_PORT] = port;
-              hosts[i][HOSTS_HOST_NAME] = host_start;
-            }
-          }
-        }
+        // so take its port and hostname.
+        hosts[i][HOSTS_PORT] = String(answer->port);
+        hosts[i][HOSTS_HOST_NAME] = answer->rdata_buffer;
         break;
       }
     }
@@ -105,7 +91,7 @@ void answerCallback(const mdns::Answer* answer) {
     int i = 0;
     for (; i < MAX_HOSTS; ++i) {
       if (hosts[i][HOSTS_HOST_NAME] == answer->name_buffer) {
-        hosts[i][HOSTS_ADDRESS] = answer->rdata_buffer;
+        hosts[i][HOSTS_ADDRESS] = answer->ipAddress.get_address();
         break;
       }
     }
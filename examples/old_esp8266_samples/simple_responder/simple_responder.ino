@@ -85,10 +85,7 @@ void SendQueryAnswer() {
   answer.rrset = false;
   answer.valid = true;
   strcpy(answer.name_buffer,hostname);
-  answer.rdata_buffer[0] = WiFi.localIP()[0];
-    answer.rdata_buffer[1] = WiFi.localIP()[1];
-    answer.rdata_buffer[2] = WiFi.localIP()[2];
-    answer.rdata_buffer[3] = WiFi.localIP()[3];
+  answer.ipAddress = WiFi.localIP();
   my_mdns.Clear();
   if(!my_mdns.AddAnswer(answer)) {
     Serial.println("AddAnswer returned false");
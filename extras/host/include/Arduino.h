@@ -0,0 +1,41 @@
+/*
+ * Arduino.h
+ *
+ * Host build stand-in for the AmebaD Arduino core. Provides just enough of
+ * the core for mdns.cpp and MDNSClient.cpp to compile and run on Linux.
+ */
+
+#ifndef HOST_ARDUINO_H_
+#define HOST_ARDUINO_H_
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+typedef uint8_t byte;
+typedef bool boolean;
+
+#include "WString.h"
+#include "Print.h"
+#include "IPAddress.h"
+#include "host_clock.h"
+
+// Serial port stand-in which writes to stdout.
+class HostSerial : public Print {
+public:
+	void begin(unsigned long) {}
+	operator bool() const { return true; }
+	virtual size_t write(uint8_t c);
+	virtual size_t write(const uint8_t *buffer, size_t size);
+	using Print::write;
+};
+
+extern HostSerial Serial;
+
+// Pseudo-random numbers in [0, howbig) and [howsmall, howbig).
+long random(long howbig);
+long random(long howsmall, long howbig);
+void randomSeed(unsigned long seed);
+
+#endif /* HOST_ARDUINO_H_ */
@@ -0,0 +1,56 @@
+/*
+ * IPAddress.h
+ *
+ * Host build stand-in for the AmebaD IPAddress class.
+ */
+
+#ifndef HOST_IPADDRESS_H_
+#define HOST_IPADDRESS_H_
+
+#include <stdint.h>
+
+#include "Printable.h"
+
+// <netinet/in.h> defines INADDR_NONE as a macro, which would hide the
+// Arduino constant of the same name.
+#ifdef INADDR_NONE
+#undef INADDR_NONE
+#endif
+
+class IPAddress : public Printable {
+public:
+	IPAddress();
+	IPAddress(uint8_t first_octet, uint8_t second_octet, uint8_t third_octet,
+			uint8_t fourth_octet);
+	// Address in network byte order, as stored by lwIP.
+	IPAddress(uint32_t address);
+	IPAddress(const uint8_t *address);
+
+	operator uint32_t() const { return _address.dword; }
+	bool operator==(const IPAddress &addr) const {
+		return _address.dword == addr._address.dword;
+	}
+	bool operator==(const uint8_t *addr) const;
+
+	uint8_t operator[](int index) const { return _address.bytes[index]; }
+	uint8_t& operator[](int index) { return _address.bytes[index]; }
+
+	IPAddress& operator=(const uint8_t *address);
+	IPAddress& operator=(uint32_t address);
+
+	virtual size_t printTo(Print &p) const;
+
+	// Dotted quad representation. Points to storage owned by this object.
+	char * get_address() const;
+
+private:
+	union {
+		uint8_t bytes[4];
+		uint32_t dword;
+	} _address;
+	mutable char _text[16];
+};
+
+extern const IPAddress INADDR_NONE;
+
+#endif /* HOST_IPADDRESS_H_ */
@@ -0,0 +1,79 @@
+/*
+ * LoopbackUDP.h
+ *
+ * In-memory WiFiUDP replacement for the host build.
+ *
+ * Every LoopbackUDP attached to the same LoopbackSegment sees the datagrams
+ * sent by the others, as if they shared a LAN. Datagrams can also be
+ * injected directly, which is how captured traffic is replayed through
+ * MDns::loop() without touching the network.
+ */
+
+#ifndef HOST_LOOPBACK_UDP_H_
+#define HOST_LOOPBACK_UDP_H_
+
+#include <deque>
+#include <vector>
+
+#include "wifi_Udp.h"
+
+class LoopbackUDP;
+
+class LoopbackSegment {
+public:
+	LoopbackSegment() : first(NULL) {}
+
+	// Deliver a datagram to every endpoint except the sender.
+	void deliver(const LoopbackUDP *sender, const uint8_t *data, size_t size);
+
+private:
+	friend class LoopbackUDP;
+	LoopbackUDP *first;
+};
+
+class LoopbackUDP : public WiFiUDP {
+public:
+	LoopbackUDP(LoopbackSegment *segment = NULL,
+			IPAddress address = IPAddress(127, 0, 0, 1));
+	virtual ~LoopbackUDP();
+
+	// Queue a datagram as though it had arrived from the network. A port
+	// other than 5353 makes it a legacy unicast query.
+	void inject(const uint8_t *data, size_t size,
+			IPAddress from = IPAddress(127, 0, 0, 1), uint16_t port = 5353);
+
+	// Number of datagrams sent through this endpoint.
+	unsigned long sentCount() const { return sent_count; }
+
+	// Last datagram sent through this endpoint, and where it went.
+	const std::vector<uint8_t>& lastSent() const { return last_sent; }
+	IPAddress lastSentIP() const { return last_ip; }
+	uint16_t lastSentPort() const { return last_port; }
+
+	virtual uint8_t begin(uint16_t port);
+	virtual void stop();
+	virtual int endPacket();
+	virtual int parsePacket();
+
+	IPAddress localIP() const { return address; }
+
+private:
+	struct Datagram {
+		std::vector<uint8_t> data;
+		IPAddress from;
+		uint16_t port;
+	};
+
+	LoopbackSegment *segment;
+	LoopbackUDP *next;
+	IPAddress address;
+	std::deque<Datagram> queue;
+	std::vector<uint8_t> last_sent;
+	IPAddress last_ip;
+	uint16_t last_port;
+	unsigned long sent_count;
+
+	friend class LoopbackSegment;
+};
+
+#endif /* HOST_LOOPBACK_UDP_H_ */
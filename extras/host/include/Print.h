@@ -0,0 +1,56 @@
+/*
+ * Print.h
+ *
+ * Host build stand-in for the Arduino core Print class.
+ */
+
+#ifndef HOST_PRINT_H_
+#define HOST_PRINT_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "Printable.h"
+#include "WString.h"
+
+#define DEC 10
+#define HEX 16
+#define OCT 8
+#define BIN 2
+
+class Print {
+public:
+	virtual ~Print() {}
+
+	virtual size_t write(uint8_t c) = 0;
+	virtual size_t write(const uint8_t *buffer, size_t size);
+	size_t write(const char *str);
+
+	size_t print(const char str[]);
+	size_t print(char c);
+	size_t print(const String &s);
+	size_t print(unsigned char n, int base = DEC);
+	size_t print(int n, int base = DEC);
+	size_t print(unsigned int n, int base = DEC);
+	size_t print(long n, int base = DEC);
+	size_t print(unsigned long n, int base = DEC);
+	size_t print(double n, int digits = 2);
+	size_t print(const Printable &p);
+
+	size_t println();
+	size_t println(const char str[]);
+	size_t println(char c);
+	size_t println(const String &s);
+	size_t println(unsigned char n, int base = DEC);
+	size_t println(int n, int base = DEC);
+	size_t println(unsigned int n, int base = DEC);
+	size_t println(long n, int base = DEC);
+	size_t println(unsigned long n, int base = DEC);
+	size_t println(double n, int digits = 2);
+	size_t println(const Printable &p);
+
+private:
+	size_t printNumber(unsigned long n, int base);
+};
+
+#endif /* HOST_PRINT_H_ */
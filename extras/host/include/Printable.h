@@ -0,0 +1,20 @@
+/*
+ * Printable.h
+ *
+ * Host build stand-in for the Arduino core Printable interface.
+ */
+
+#ifndef HOST_PRINTABLE_H_
+#define HOST_PRINTABLE_H_
+
+#include <stddef.h>
+
+class Print;
+
+class Printable {
+public:
+	virtual ~Printable() {}
+	virtual size_t printTo(Print& p) const = 0;
+};
+
+#endif /* HOST_PRINTABLE_H_ */
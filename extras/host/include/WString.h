@@ -0,0 +1,40 @@
+/*
+ * WString.h
+ *
+ * Host build stand-in for the Arduino core String class. Only the subset
+ * used by the library is provided.
+ */
+
+#ifndef HOST_WSTRING_H_
+#define HOST_WSTRING_H_
+
+#include <string>
+#include <string.h>
+
+class String {
+public:
+	String(const char *str = "") : _str(str ? str : "") {}
+	String(const String &other) : _str(other._str) {}
+
+	String& operator=(const String &other) {
+		_str = other._str;
+		return *this;
+	}
+	String& operator=(const char *str) {
+		_str = str ? str : "";
+		return *this;
+	}
+
+	bool operator==(const String &other) const { return _str == other._str; }
+	bool operator==(const char *str) const { return str && _str == str; }
+	bool operator!=(const String &other) const { return !(*this == other); }
+	bool operator!=(const char *str) const { return !(*this == str); }
+
+	unsigned int length() const { return _str.length(); }
+	const char * c_str() const { return _str.c_str(); }
+
+private:
+	std::string _str;
+};
+
+#endif /* HOST_WSTRING_H_ */
@@ -0,0 +1,33 @@
+/*
+ * WiFi.h
+ *
+ * Host build stand-in for the AmebaD WiFi class. Only the local address is
+ * modelled; the host is considered to be permanently connected.
+ */
+
+#ifndef HOST_WIFI_H_
+#define HOST_WIFI_H_
+
+#include "Arduino.h"
+
+#define WL_IDLE_STATUS 0
+#define WL_CONNECTED 3
+
+class WiFiClass {
+public:
+	// Address of the first non-loopback IPv4 interface that is up, unless
+	// overridden by config() or the MDNS_HOST_IP environment variable.
+	IPAddress localIP();
+
+	// Pin the local address, selecting the interface used for multicast.
+	void config(IPAddress local_ip);
+
+	int status() { return WL_CONNECTED; }
+
+private:
+	IPAddress _local_ip;
+};
+
+extern WiFiClass WiFi;
+
+#endif /* HOST_WIFI_H_ */
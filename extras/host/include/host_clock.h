@@ -0,0 +1,25 @@
+/*
+ * host_clock.h
+ *
+ * Monotonic clock backing millis(), micros() and delay() on the host.
+ *
+ * By default the clock follows CLOCK_MONOTONIC. Tools that replay captures
+ * or exercise TTL handling can switch to a manual clock which only moves
+ * when hostClockAdvance() or delay() is called, making runs deterministic.
+ */
+
+#ifndef HOST_CLOCK_H_
+#define HOST_CLOCK_H_
+
+unsigned long millis();
+unsigned long micros();
+void delay(unsigned long ms);
+
+// Stop following the system clock. Time stands still at its current value
+// until advanced explicitly.
+void hostClockSetManual(bool manual);
+
+// Move the manual clock forwards. Ignored while following the system clock.
+void hostClockAdvance(unsigned long ms);
+
+#endif /* HOST_CLOCK_H_ */
@@ -0,0 +1,30 @@
+/*
+ * lwip/igmp.h
+ *
+ * Host build stand-in for the lwIP IGMP API. Joined groups are recorded and
+ * applied to the host sockets opened by WiFiUDP::begin().
+ */
+
+#ifndef HOST_LWIP_IGMP_H_
+#define HOST_LWIP_IGMP_H_
+
+#include <stdint.h>
+
+#include "lwip/opt.h"
+
+typedef int8_t err_t;
+
+#define ERR_OK 0
+#define ERR_MEM -1
+
+typedef struct ip4_addr {
+	uint32_t addr;
+} ip4_addr_t;
+
+err_t igmp_joingroup(const ip4_addr_t *ifaddr, const ip4_addr_t *groupaddr);
+
+// Host only: number of groups joined so far and access to each of them.
+int host_igmp_group_count();
+void host_igmp_group(int index, ip4_addr_t *ifaddr, ip4_addr_t *groupaddr);
+
+#endif /* HOST_LWIP_IGMP_H_ */
@@ -0,0 +1,38 @@
+/*
+ * lwip/mld6.h
+ *
+ * Host build stand-in for the lwIP MLD (IPv6 multicast membership) API.
+ * Joined groups are only recorded: the host WiFiUDP socket is IPv4 only.
+ */
+
+#ifndef HOST_LWIP_MLD6_H_
+#define HOST_LWIP_MLD6_H_
+
+#include <stdint.h>
+
+#include "lwip/opt.h"
+#include "lwip/igmp.h"
+
+typedef struct ip6_addr {
+	uint32_t addr[4];
+} ip6_addr_t;
+
+#define PP_HTONL(x) ((((x) & 0x000000FFUL) << 24) | (((x) & 0x0000FF00UL) << 8) \
+		| (((x) & 0x00FF0000UL) >> 8) | (((x) & 0xFF000000UL) >> 24))
+
+#define IP6_ADDR(ip6addr, idx0, idx1, idx2, idx3) do { \
+		(ip6addr)->addr[0] = (idx0); \
+		(ip6addr)->addr[1] = (idx1); \
+		(ip6addr)->addr[2] = (idx2); \
+		(ip6addr)->addr[3] = (idx3); } while (0)
+
+extern const ip6_addr_t host_ip6_addr_any;
+#define IP6_ADDR_ANY6 (&host_ip6_addr_any)
+
+err_t mld6_joingroup(const ip6_addr_t *srcaddr, const ip6_addr_t *groupaddr);
+
+// Host only: number of groups joined so far and access to each of them.
+int host_mld6_group_count();
+void host_mld6_group(int index, ip6_addr_t *groupaddr);
+
+#endif /* HOST_LWIP_MLD6_H_ */
@@ -0,0 +1,19 @@
+/*
+ * lwip/netif.h
+ *
+ * Host build stand-in for the lwIP network interface structure.
+ */
+
+#ifndef HOST_LWIP_NETIF_H_
+#define HOST_LWIP_NETIF_H_
+
+#include <stdint.h>
+
+#define NETIF_FLAG_IGMP 0x80U
+#define NETIF_FLAG_MLD6 0x40U
+
+struct netif {
+	uint8_t flags;
+};
+
+#endif /* HOST_LWIP_NETIF_H_ */
@@ -0,0 +1,15 @@
+/*
+ * lwip/opt.h
+ *
+ * Host build stand-in for the lwIP configuration. Only the options looked at
+ * by the library are defined.
+ */
+
+#ifndef HOST_LWIP_OPT_H_
+#define HOST_LWIP_OPT_H_
+
+#define LWIP_IGMP 1
+#define LWIP_IPV6 1
+#define LWIP_IPV6_MLD 1
+
+#endif /* HOST_LWIP_OPT_H_ */
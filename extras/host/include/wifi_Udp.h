@@ -0,0 +1,68 @@
+/*
+ * wifi_Udp.h
+ *
+ * Host build stand-in for the AmebaD WiFiUDP class, backed by a POSIX UDP
+ * socket.
+ *
+ * On the device multicast membership belongs to the network interface:
+ * igmp_joingroup() is called once and every UDP socket bound to the port
+ * sees the group's traffic. The host emulates that by having begin() join
+ * every group previously registered with igmp_joingroup().
+ *
+ * All methods are virtual so other transports (see LoopbackUDP.h) can be
+ * handed to MDns in place of a real socket.
+ */
+
+#ifndef HOST_WIFI_UDP_H_
+#define HOST_WIFI_UDP_H_
+
+#include "Arduino.h"
+
+#define WIFI_UDP_BUFFER_SIZE 1536
+
+class WiFiUDP {
+public:
+	WiFiUDP();
+	virtual ~WiFiUDP();
+
+	virtual uint8_t begin(uint16_t port);
+	virtual void stop();
+
+	virtual int beginPacket(IPAddress ip, uint16_t port);
+	virtual size_t write(uint8_t c);
+	virtual size_t write(const uint8_t *buffer, size_t size);
+	virtual int endPacket();
+
+	// Receive the next datagram without blocking.
+	// Returns its size, or 0 if nothing is waiting.
+	virtual int parsePacket();
+	virtual int available();
+	virtual int read();
+	virtual int read(unsigned char *buffer, size_t len);
+	int read(char *buffer, size_t len) {
+		return read((unsigned char*) buffer, len);
+	}
+	virtual void flush();
+
+	virtual IPAddress remoteIP();
+	virtual uint16_t remotePort();
+
+protected:
+	// Outgoing datagram being assembled between beginPacket() and endPacket().
+	uint8_t tx_buffer[WIFI_UDP_BUFFER_SIZE];
+	size_t tx_size;
+	IPAddress tx_ip;
+	uint16_t tx_port;
+
+	// Datagram returned by the last parsePacket().
+	uint8_t rx_buffer[WIFI_UDP_BUFFER_SIZE];
+	size_t rx_size;
+	size_t rx_pos;
+	IPAddress rx_ip;
+	uint16_t rx_port;
+
+private:
+	int fd;
+};
+
+#endif /* HOST_WIFI_UDP_H_ */
@@ -0,0 +1,78 @@
+/*
+ * Arduino.cpp
+ *
+ * Host build: clock, random number and Serial stand-ins.
+ */
+
+#include <time.h>
+
+#include "Arduino.h"
+
+HostSerial Serial;
+
+size_t HostSerial::write(uint8_t c) {
+	return fputc(c, stdout) == EOF ? 0 : 1;
+}
+
+size_t HostSerial::write(const uint8_t *buffer, size_t size) {
+	return fwrite(buffer, 1, size, stdout);
+}
+
+long random(long howbig) {
+	return howbig > 0 ? rand() % howbig : 0;
+}
+
+long random(long howsmall, long howbig) {
+	return howsmall < howbig ? howsmall + random(howbig - howsmall) : howsmall;
+}
+
+void randomSeed(unsigned long seed) {
+	srand(seed);
+}
+
+static bool manual_clock = false;
+static unsigned long long manual_micros = 0;
+
+static unsigned long long monotonicMicros() {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (unsigned long long) ts.tv_sec * 1000000ULL + ts.tv_nsec / 1000;
+}
+
+unsigned long micros() {
+	if (manual_clock) {
+		return (unsigned long) manual_micros;
+	}
+	return (unsigned long) monotonicMicros();
+}
+
+unsigned long millis() {
+	if (manual_clock) {
+		return (unsigned long) (manual_micros / 1000);
+	}
+	return (unsigned long) (monotonicMicros() / 1000);
+}
+
+void delay(unsigned long ms) {
+	if (manual_clock) {
+		hostClockAdvance(ms);
+		return;
+	}
+	struct timespec ts;
+	ts.tv_sec = ms / 1000;
+	ts.tv_nsec = (ms % 1000) * 1000000L;
+	nanosleep(&ts, NULL);
+}
+
+void hostClockSetManual(bool manual) {
+	if (manual && !manual_clock) {
+		manual_micros = monotonicMicros();
+	}
+	manual_clock = manual;
+}
+
+void hostClockAdvance(unsigned long ms) {
+	if (manual_clock) {
+		manual_micros += (unsigned long long) ms * 1000;
+	}
+}
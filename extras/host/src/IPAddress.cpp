@@ -0,0 +1,57 @@
+/*
+ * IPAddress.cpp
+ *
+ * Host build stand-in for the AmebaD IPAddress class.
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include "IPAddress.h"
+#include "Print.h"
+
+const IPAddress INADDR_NONE(0, 0, 0, 0);
+
+IPAddress::IPAddress() {
+	_address.dword = 0;
+}
+
+IPAddress::IPAddress(uint8_t first_octet, uint8_t second_octet,
+		uint8_t third_octet, uint8_t fourth_octet) {
+	_address.bytes[0] = first_octet;
+	_address.bytes[1] = second_octet;
+	_address.bytes[2] = third_octet;
+	_address.bytes[3] = fourth_octet;
+}
+
+IPAddress::IPAddress(uint32_t address) {
+	_address.dword = address;
+}
+
+IPAddress::IPAddress(const uint8_t *address) {
+	memcpy(_address.bytes, address, sizeof(_address.bytes));
+}
+
+bool IPAddress::operator==(const uint8_t *addr) const {
+	return memcmp(addr, _address.bytes, sizeof(_address.bytes)) == 0;
+}
+
+IPAddress& IPAddress::operator=(const uint8_t *address) {
+	memcpy(_address.bytes, address, sizeof(_address.bytes));
+	return *this;
+}
+
+IPAddress& IPAddress::operator=(uint32_t address) {
+	_address.dword = address;
+	return *this;
+}
+
+size_t IPAddress::printTo(Print &p) const {
+	return p.print(get_address());
+}
+
+char * IPAddress::get_address() const {
+	snprintf(_text, sizeof(_text), "%u.%u.%u.%u", _address.bytes[0],
+			_address.bytes[1], _address.bytes[2], _address.bytes[3]);
+	return _text;
+}
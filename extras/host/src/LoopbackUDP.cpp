@@ -0,0 +1,85 @@
+/*
+ * LoopbackUDP.cpp
+ *
+ * In-memory WiFiUDP replacement for the host build.
+ */
+
+#include "LoopbackUDP.h"
+
+void LoopbackSegment::deliver(const LoopbackUDP *sender, const uint8_t *data,
+		size_t size) {
+	for (LoopbackUDP *endpoint = first; endpoint != NULL;
+			endpoint = endpoint->next) {
+		if (endpoint != sender) {
+			endpoint->inject(data, size, sender->address, 5353);
+		}
+	}
+}
+
+LoopbackUDP::LoopbackUDP(LoopbackSegment *segment, IPAddress address) :
+		segment(segment), next(NULL), address(address), last_port(0),
+		sent_count(0) {
+	if (segment) {
+		next = segment->first;
+		segment->first = this;
+	}
+}
+
+LoopbackUDP::~LoopbackUDP() {
+	if (segment) {
+		LoopbackUDP **link = &segment->first;
+		while (*link != this) {
+			link = &(*link)->next;
+		}
+		*link = next;
+	}
+}
+
+void LoopbackUDP::inject(const uint8_t *data, size_t size, IPAddress from,
+		uint16_t port) {
+	Datagram datagram;
+	datagram.data.assign(data, data + size);
+	datagram.from = from;
+	datagram.port = port;
+	queue.push_back(datagram);
+}
+
+uint8_t LoopbackUDP::begin(uint16_t) {
+	return 1;
+}
+
+void LoopbackUDP::stop() {
+	queue.clear();
+	rx_size = rx_pos = 0;
+}
+
+int LoopbackUDP::endPacket() {
+	last_sent.assign(tx_buffer, tx_buffer + tx_size);
+	last_ip = tx_ip;
+	last_port = tx_port;
+	sent_count++;
+	if (segment) {
+		segment->deliver(this, tx_buffer, tx_size);
+	}
+	tx_size = 0;
+	return 1;
+}
+
+int LoopbackUDP::parsePacket() {
+	rx_size = rx_pos = 0;
+	if (queue.empty()) {
+		return 0;
+	}
+	const Datagram &datagram = queue.front();
+	rx_size = datagram.data.size();
+	if (rx_size > sizeof(rx_buffer)) {
+		rx_size = sizeof(rx_buffer);
+	}
+	if (rx_size) {
+		memcpy(rx_buffer, &datagram.data[0], rx_size);
+	}
+	rx_ip = datagram.from;
+	rx_port = datagram.port;
+	queue.pop_front();
+	return rx_size;
+}
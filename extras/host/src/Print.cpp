@@ -0,0 +1,129 @@
+/*
+ * Print.cpp
+ *
+ * Host build stand-in for the Arduino core Print class.
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include "Print.h"
+
+size_t Print::write(const uint8_t *buffer, size_t size) {
+	size_t n = 0;
+	while (size--) {
+		n += write(*buffer++);
+	}
+	return n;
+}
+
+size_t Print::write(const char *str) {
+	if (str == NULL) {
+		return 0;
+	}
+	return write((const uint8_t*) str, strlen(str));
+}
+
+size_t Print::print(const char str[]) {
+	return write(str);
+}
+
+size_t Print::print(char c) {
+	return write((uint8_t) c);
+}
+
+size_t Print::print(const String &s) {
+	return write((const uint8_t*) s.c_str(), s.length());
+}
+
+size_t Print::print(unsigned char n, int base) {
+	return print((unsigned long) n, base);
+}
+
+size_t Print::print(int n, int base) {
+	return print((long) n, base);
+}
+
+size_t Print::print(unsigned int n, int base) {
+	return print((unsigned long) n, base);
+}
+
+size_t Print::print(long n, int base) {
+	if (base == DEC && n < 0) {
+		return print('-') + printNumber(-(unsigned long) n, DEC);
+	}
+	return printNumber((unsigned long) n, base);
+}
+
+size_t Print::print(unsigned long n, int base) {
+	return printNumber(n, base);
+}
+
+size_t Print::print(double n, int digits) {
+	char tmp[32];
+	snprintf(tmp, sizeof(tmp), "%.*f", digits, n);
+	return write(tmp);
+}
+
+size_t Print::print(const Printable &p) {
+	return p.printTo(*this);
+}
+
+size_t Print::println() {
+	return write("\r\n");
+}
+
+size_t Print::println(const char str[]) {
+	return print(str) + println();
+}
+
+size_t Print::println(char c) {
+	return print(c) + println();
+}
+
+size_t Print::println(const String &s) {
+	return print(s) + println();
+}
+
+size_t Print::println(unsigned char n, int base) {
+	return print(n, base) + println();
+}
+
+size_t Print::println(int n, int base) {
+	return print(n, base) + println();
+}
+
+size_t Print::println(unsigned int n, int base) {
+	return print(n, base) + println();
+}
+
+size_t Print::println(long n, int base) {
+	return print(n, base) + println();
+}
+
+size_t Print::println(unsigned long n, int base) {
+	return print(n, base) + println();
+}
+
+size_t Print::println(double n, int digits) {
+	return print(n, digits) + println();
+}
+
+size_t Print::println(const Printable &p) {
+	return print(p) + println();
+}
+
+size_t Print::printNumber(unsigned long n, int base) {
+	char buf[8 * sizeof(long) + 1];
+	char *str = &buf[sizeof(buf) - 1];
+	*str = '\0';
+	if (base < 2) {
+		base = 10;
+	}
+	do {
+		char c = n % base;
+		n /= base;
+		*--str = c < 10 ? c + '0' : c + 'A' - 10;
+	} while (n);
+	return write(str);
+}
@@ -0,0 +1,49 @@
+/*
+ * WiFi.cpp
+ *
+ * Host build stand-in for the AmebaD WiFi class.
+ */
+
+#include <arpa/inet.h>
+#include <ifaddrs.h>
+#include <net/if.h>
+#include <netinet/in.h>
+#include <stdlib.h>
+
+#include "WiFi.h"
+
+WiFiClass WiFi;
+
+IPAddress WiFiClass::localIP() {
+	if ((uint32_t) _local_ip != 0) {
+		return _local_ip;
+	}
+
+	const char *env = getenv("MDNS_HOST_IP");
+	struct in_addr addr;
+	if (env && inet_pton(AF_INET, env, &addr) == 1) {
+		_local_ip = IPAddress((uint32_t) addr.s_addr);
+		return _local_ip;
+	}
+
+	struct ifaddrs *interfaces = NULL;
+	if (getifaddrs(&interfaces) == 0) {
+		for (struct ifaddrs *i = interfaces; i != NULL; i = i->ifa_next) {
+			if (i->ifa_addr == NULL || i->ifa_addr->sa_family != AF_INET
+					|| !(i->ifa_flags & IFF_UP)
+					|| (i->ifa_flags & IFF_LOOPBACK)) {
+				continue;
+			}
+			const struct sockaddr_in *sin =
+					(const struct sockaddr_in*) i->ifa_addr;
+			_local_ip = IPAddress((uint32_t) sin->sin_addr.s_addr);
+			break;
+		}
+		freeifaddrs(interfaces);
+	}
+	return _local_ip;
+}
+
+void WiFiClass::config(IPAddress local_ip) {
+	_local_ip = local_ip;
+}
@@ -0,0 +1,71 @@
+/*
+ * lwip.cpp
+ *
+ * Host build stand-ins for the lwIP symbols used by mdns.cpp.
+ */
+
+#include <string.h>
+
+#include "lwip/igmp.h"
+#include "lwip/mld6.h"
+#include "lwip/netif.h"
+
+struct netif xnetif[1];
+
+#define HOST_IGMP_MAX_GROUPS 4
+#define HOST_MLD6_MAX_GROUPS 4
+
+static ip4_addr_t joined_ifaddr[HOST_IGMP_MAX_GROUPS];
+static ip4_addr_t joined_group[HOST_IGMP_MAX_GROUPS];
+static int joined_count = 0;
+
+err_t igmp_joingroup(const ip4_addr_t *ifaddr, const ip4_addr_t *groupaddr) {
+	for (int i = 0; i < joined_count; i++) {
+		if (joined_group[i].addr == groupaddr->addr
+				&& joined_ifaddr[i].addr == ifaddr->addr) {
+			return ERR_OK;
+		}
+	}
+	if (joined_count == HOST_IGMP_MAX_GROUPS) {
+		return ERR_MEM;
+	}
+	joined_ifaddr[joined_count] = *ifaddr;
+	joined_group[joined_count] = *groupaddr;
+	joined_count++;
+	return ERR_OK;
+}
+
+int host_igmp_group_count() {
+	return joined_count;
+}
+
+void host_igmp_group(int index, ip4_addr_t *ifaddr, ip4_addr_t *groupaddr) {
+	*ifaddr = joined_ifaddr[index];
+	*groupaddr = joined_group[index];
+}
+
+const ip6_addr_t host_ip6_addr_any = { { 0, 0, 0, 0 } };
+
+static ip6_addr_t joined_group6[HOST_MLD6_MAX_GROUPS];
+static int joined_count6 = 0;
+
+err_t mld6_joingroup(const ip6_addr_t *, const ip6_addr_t *groupaddr) {
+	for (int i = 0; i < joined_count6; i++) {
+		if (memcmp(&joined_group6[i], groupaddr, sizeof(ip6_addr_t)) == 0) {
+			return ERR_OK;
+		}
+	}
+	if (joined_count6 == HOST_MLD6_MAX_GROUPS) {
+		return ERR_MEM;
+	}
+	joined_group6[joined_count6++] = *groupaddr;
+	return ERR_OK;
+}
+
+int host_mld6_group_count() {
+	return joined_count6;
+}
+
+void host_mld6_group(int index, ip6_addr_t *groupaddr) {
+	*groupaddr = joined_group6[index];
+}
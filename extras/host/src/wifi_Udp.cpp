@@ -0,0 +1,163 @@
+/*
+ * wifi_Udp.cpp
+ *
+ * Host build stand-in for the AmebaD WiFiUDP class, backed by a POSIX UDP
+ * socket.
+ */
+
+#include <arpa/inet.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "wifi_Udp.h"
+#include "lwip/igmp.h"
+
+WiFiUDP::WiFiUDP() :
+		tx_size(0), tx_port(0), rx_size(0), rx_pos(0), rx_port(0), fd(-1) {
+}
+
+WiFiUDP::~WiFiUDP() {
+	if (fd >= 0) {
+		close(fd);
+	}
+}
+
+uint8_t WiFiUDP::begin(uint16_t port) {
+	stop();
+
+	fd = socket(AF_INET, SOCK_DGRAM, 0);
+	if (fd < 0) {
+		return 0;
+	}
+
+	// Several mDNS stacks may share port 5353 on a desktop machine.
+	int on = 1;
+	setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+#ifdef SO_REUSEPORT
+	setsockopt(fd, SOL_SOCKET, SO_REUSEPORT, &on, sizeof(on));
+#endif
+
+	struct sockaddr_in local;
+	memset(&local, 0, sizeof(local));
+	local.sin_family = AF_INET;
+	local.sin_addr.s_addr = htonl(INADDR_ANY);
+	local.sin_port = htons(port);
+	if (bind(fd, (struct sockaddr*) &local, sizeof(local)) < 0) {
+		stop();
+		return 0;
+	}
+
+	// Apply the multicast memberships requested through igmp_joingroup().
+	for (int i = 0; i < host_igmp_group_count(); i++) {
+		ip4_addr_t ifaddr, group;
+		host_igmp_group(i, &ifaddr, &group);
+		struct ip_mreq mreq;
+		mreq.imr_multiaddr.s_addr = group.addr;
+		mreq.imr_interface.s_addr = ifaddr.addr;
+		setsockopt(fd, IPPROTO_IP, IP_ADD_MEMBERSHIP, &mreq, sizeof(mreq));
+		setsockopt(fd, IPPROTO_IP, IP_MULTICAST_IF, &mreq.imr_interface,
+				sizeof(mreq.imr_interface));
+	}
+	unsigned char ttl = 255;
+	setsockopt(fd, IPPROTO_IP, IP_MULTICAST_TTL, &ttl, sizeof(ttl));
+
+	fcntl(fd, F_SETFL, fcntl(fd, F_GETFL, 0) | O_NONBLOCK);
+	return 1;
+}
+
+void WiFiUDP::stop() {
+	if (fd >= 0) {
+		close(fd);
+		fd = -1;
+	}
+	rx_size = rx_pos = 0;
+}
+
+int WiFiUDP::beginPacket(IPAddress ip, uint16_t port) {
+	tx_ip = ip;
+	tx_port = port;
+	tx_size = 0;
+	return 1;
+}
+
+size_t WiFiUDP::write(uint8_t c) {
+	return write(&c, 1);
+}
+
+size_t WiFiUDP::write(const uint8_t *buffer, size_t size) {
+	if (size > sizeof(tx_buffer) - tx_size) {
+		size = sizeof(tx_buffer) - tx_size;
+	}
+	memcpy(tx_buffer + tx_size, buffer, size);
+	tx_size += size;
+	return size;
+}
+
+int WiFiUDP::endPacket() {
+	if (fd < 0) {
+		return 0;
+	}
+	struct sockaddr_in remote;
+	memset(&remote, 0, sizeof(remote));
+	remote.sin_family = AF_INET;
+	remote.sin_addr.s_addr = (uint32_t) tx_ip;
+	remote.sin_port = htons(tx_port);
+	ssize_t sent = sendto(fd, tx_buffer, tx_size, 0,
+			(struct sockaddr*) &remote, sizeof(remote));
+	tx_size = 0;
+	return sent < 0 ? 0 : 1;
+}
+
+int WiFiUDP::parsePacket() {
+	rx_size = rx_pos = 0;
+	if (fd < 0) {
+		return 0;
+	}
+	struct sockaddr_in remote;
+	socklen_t remote_len = sizeof(remote);
+	ssize_t received = recvfrom(fd, rx_buffer, sizeof(rx_buffer), 0,
+			(struct sockaddr*) &remote, &remote_len);
+	if (received <= 0) {
+		return 0;
+	}
+	rx_size = received;
+	rx_ip = IPAddress((uint32_t) remote.sin_addr.s_addr);
+	rx_port = ntohs(remote.sin_port);
+	return rx_size;
+}
+
+int WiFiUDP::available() {
+	return rx_size - rx_pos;
+}
+
+int WiFiUDP::read() {
+	if (rx_pos >= rx_size) {
+		return -1;
+	}
+	return rx_buffer[rx_pos++];
+}
+
+int WiFiUDP::read(unsigned char *buffer, size_t len) {
+	size_t n = rx_size - rx_pos;
+	if (n > len) {
+		n = len;
+	}
+	memcpy(buffer, rx_buffer + rx_pos, n);
+	rx_pos += n;
+	return n;
+}
+
+void WiFiUDP::flush() {
+	rx_pos = rx_size;
+}
+
+IPAddress WiFiUDP::remoteIP() {
+	return rx_ip;
+}
+
+uint16_t WiFiUDP::remotePort() {
+	return rx_port;
+}
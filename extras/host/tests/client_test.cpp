@@ -0,0 +1,646 @@
+/*
+ * client_test.cpp
+ *
+ * MDNSClient on a loopback LAN: what it asks, and what it makes of the
+ * answers.
+ */
+
+#include "test.h"
+#include "MDNSClient.h"
+
+// A device looking things up, with a peer answering it. The client is
+// polled every millisecond.
+class Client : public Lan {
+public:
+	MDNSClient client;
+	Peer peer;
+
+	Client() : client(&mdns, NULL) {
+	}
+
+	// The peer answers with an A record.
+	void answer(const char *name, IPAddress address) {
+		peer.clear();
+		peer.a(name, address);
+		peer.deliver(udp, false);
+	}
+
+protected:
+	virtual void step() {
+		client.poll();
+	}
+};
+
+// What the lookup callback was last called with.
+static int callbacks;
+static MDNSClient::LookupHandle calledHandle;
+static MDNSClient::LookupStatus calledStatus;
+
+static void onLookup(MDNSClient&, MDNSClient::LookupHandle handle,
+		MDNSClient::LookupStatus status) {
+	callbacks++;
+	calledHandle = handle;
+	calledStatus = status;
+}
+
+static void testCallback() {
+	Client lan;
+	callbacks = 0;
+	const MDNSClient::LookupHandle handle = lan.client.startLookupHost(
+			"peer.local", 1000, onLookup);
+	CHECK(handle != MDNSClient::INVALID_LOOKUP);
+	CHECK_EQ(MDNSClient::STATUS_PENDING, lan.client.getStatus(handle));
+	lan.loop();
+	CHECK_EQ(1, lan.sent.size());
+	if (lan.sent.size() == 1) {
+		CHECK(lan.sent[0].isQuery());
+		CHECK_EQ(1, lan.sent[0].asks(MDNS_TYPE_A, "peer.local"));
+	}
+	CHECK_EQ(0, callbacks);
+
+	lan.answer("peer.local", PEER_IP);
+	lan.loop();
+	CHECK_EQ(1, callbacks);
+	CHECK_EQ(handle, calledHandle);
+	CHECK_EQ(MDNSClient::STATUS_RESOLVED, calledStatus);
+	CHECK_EQ(MDNSClient::STATUS_RESOLVED, lan.client.getStatus(handle));
+	CHECK(lan.client.getHostAddress(handle) == PEER_IP);
+
+	// Once only.
+	lan.run(2000);
+	CHECK_EQ(1, callbacks);
+}
+
+static void testTimeout() {
+	Client lan;
+	callbacks = 0;
+	const MDNSClient::LookupHandle handle = lan.client.startLookupHost(
+			"peer.local", 500, onLookup);
+	lan.run(499);
+	CHECK_EQ(MDNSClient::STATUS_PENDING, lan.client.getStatus(handle));
+	CHECK_EQ(0, callbacks);
+	lan.run(1);
+	CHECK_EQ(MDNSClient::STATUS_TIMEOUT, lan.client.getStatus(handle));
+	CHECK_EQ(1, callbacks);
+	CHECK_EQ(MDNSClient::STATUS_TIMEOUT, calledStatus);
+	CHECK(lan.client.getHostAddress(handle) == INADDR_NONE);
+
+	// An answer too late changes nothing.
+	lan.answer("peer.local", PEER_IP);
+	lan.run(10);
+	CHECK_EQ(MDNSClient::STATUS_TIMEOUT, lan.client.getStatus(handle));
+	CHECK(lan.client.getHostAddress(handle) == INADDR_NONE);
+	CHECK_EQ(1, callbacks);
+}
+
+static void testStaleHandle() {
+	Client lan;
+	const MDNSClient::LookupHandle stale = lan.client.startLookupHost(
+			"peer.local");
+	lan.loop();
+	lan.answer("peer.local", PEER_IP);
+	lan.loop();
+	CHECK_EQ(MDNSClient::STATUS_RESOLVED, lan.client.getStatus(stale));
+
+	// The resolved slot is the last to be taken again.
+	char names[MAX_LOOKUPS][16];
+	MDNSClient::LookupHandle handles[MAX_LOOKUPS];
+	for (int i = 0; i < MAX_LOOKUPS; i++) {
+		sprintf(names[i], "host%d.local", i);
+		handles[i] = lan.client.startLookupHost(names[i]);
+		CHECK(handles[i] != MDNSClient::INVALID_LOOKUP);
+		CHECK(handles[i] != stale);
+		if (i < MAX_LOOKUPS - 1) {
+			CHECK_EQ(MDNSClient::STATUS_RESOLVED, lan.client.getStatus(stale));
+		}
+	}
+	CHECK_EQ(MDNSClient::STATUS_UNKNOWN, lan.client.getStatus(stale));
+	CHECK(lan.client.getHostAddress(stale) == INADDR_NONE);
+	CHECK_EQ(MDNSClient::INVALID_LOOKUP,
+			lan.client.startLookupHost("more.local"));
+
+	// Cancelling by the stale handle leaves its successor alone.
+	lan.client.cancel(stale);
+	const MDNSClient::LookupHandle reused = handles[MAX_LOOKUPS - 1];
+	CHECK_EQ(MDNSClient::STATUS_PENDING, lan.client.getStatus(reused));
+	lan.loop();
+	lan.answer(names[MAX_LOOKUPS - 1], DEVICE_IP);
+	lan.loop();
+	CHECK_EQ(MDNSClient::STATUS_RESOLVED, lan.client.getStatus(reused));
+	CHECK(lan.client.getHostAddress(reused) == DEVICE_IP);
+	CHECK(lan.client.getHostAddress(stale) == INADDR_NONE);
+}
+
+static void testConcurrentLookups() {
+	Client lan;
+	const IPAddress first(10, 0, 0, 21);
+	const IPAddress second(10, 0, 0, 22);
+	const IPAddress box(10, 0, 0, 23);
+	const MDNSClient::LookupHandle a = lan.client.startLookupHost("a.local");
+	const MDNSClient::LookupHandle b = lan.client.startLookupHost("b.local");
+	const MDNSClient::LookupHandle http = lan.client.startLookupService(
+			"_http._tcp.local");
+	lan.loop();
+	// All questions in one packet.
+	CHECK_EQ(1, lan.sent.size());
+	if (lan.sent.size() == 1) {
+		CHECK_EQ(1, lan.sent[0].asks(MDNS_TYPE_A, "a.local"));
+		CHECK_EQ(1, lan.sent[0].asks(MDNS_TYPE_A, "b.local"));
+		CHECK_EQ(1, lan.sent[0].asks(MDNS_TYPE_PTR, "_http._tcp.local"));
+	}
+
+	// Answers in another order than asked, each to its own lookup.
+	lan.answer("b.local", second);
+	lan.loop();
+	CHECK_EQ(MDNSClient::STATUS_PENDING, lan.client.getStatus(a));
+	CHECK_EQ(MDNSClient::STATUS_RESOLVED, lan.client.getStatus(b));
+	CHECK_EQ(MDNSClient::STATUS_PENDING, lan.client.getStatus(http));
+
+	lan.peer.clear();
+	lan.peer.ptr("_http._tcp.local", "Box._http._tcp.local");
+	lan.peer.srv("Box._http._tcp.local", "box.local", 8080);
+	lan.peer.a("box.local", box);
+	lan.peer.deliver(lan.udp, false);
+	lan.answer("a.local", first);
+	lan.run(2);
+	CHECK_EQ(MDNSClient::STATUS_RESOLVED, lan.client.getStatus(a));
+	CHECK_EQ(MDNSClient::STATUS_RESOLVED, lan.client.getStatus(http));
+	CHECK(lan.client.getHostAddress(a) == first);
+	CHECK(lan.client.getHostAddress(b) == second);
+	CHECK(lan.client.getHostAddress(http) == INADDR_NONE);
+	CHECK_EQ(0, lan.client.getHostCount(a));
+	CHECK_EQ(1, lan.client.getHostCount(http));
+	const HostInfo *host = lan.client.getHost(http, 0);
+	CHECK(host != NULL);
+	if (host) {
+		CHECK(strcmp(host->service, "Box._http._tcp.local") == 0);
+		CHECK(strcmp(host->host, "box.local") == 0);
+		CHECK_EQ(8080, host->port);
+		CHECK(host->ip == box);
+	}
+}
+
+static void testLookupHostsSplit() {
+	Client lan;
+	const int count = 40;
+	char names[count][48];
+	const char *hostNames[count];
+	for (int i = 0; i < count; i++) {
+		sprintf(names[i], "a-rather-long-host-name-number-%02d.local", i);
+		hostNames[i] = names[i];
+	}
+	// One is cached already, so not asked for.
+	lan.answer(names[7], IPAddress(10, 1, 0, 7));
+	lan.mdns.loop();
+
+	// lookupHosts() blocks, so the answers are waiting before it asks.
+	for (int i = 0; i < count; i += 10) {
+		lan.peer.clear();
+		for (int j = i; j < i + 10; j++) {
+			if (j != 7) {
+				lan.peer.a(names[j], IPAddress(10, 1, 0, j));
+			}
+		}
+		lan.peer.deliver(lan.udp, false);
+	}
+	IPAddress results[count];
+	CHECK_EQ(count, lan.client.lookupHosts(hostNames, count, results));
+	for (int i = 0; i < count; i++) {
+		CHECK(results[i] == IPAddress(10, 1, 0, i));
+	}
+
+	// The questions fill a packet, and the rest go in a second one.
+	lan.loop();
+	CHECK_EQ(2, lan.sent.size());
+	if (lan.sent.size() != 2) {
+		return;
+	}
+	for (int i = 0; i < 2; i++) {
+		CHECK(lan.sent[i].isQuery());
+		CHECK(lan.sent[i].data.size() <= MAX_PACKET_SIZE);
+	}
+	CHECK(lan.sent[0].data.size() > MAX_PACKET_SIZE - 40);
+	for (int i = 0; i < count; i++) {
+		CHECK_EQ(i == 7 ? 0 : 1, lan.sent[0].asks(MDNS_TYPE_A, names[i])
+				+ lan.sent[1].asks(MDNS_TYPE_A, names[i]));
+	}
+}
+
+// Cache instances "Box0 on the top shelf by the door", "Box1 on..." of
+// _http._tcp.local, all on box.local, with PTR records lasting ptrTtl s.
+static void cacheInstances(Client &lan, int count, unsigned long ptrTtl) {
+	lan.peer.clear();
+	for (int i = 0; i < count; i++) {
+		char name[64];
+		sprintf(name, "Box%d on the top shelf by the door._http._tcp.local", i);
+		lan.peer.ptr("_http._tcp.local", name, ptrTtl);
+		lan.peer.srv(name, "box.local", 80, 4500);
+	}
+	lan.peer.a("box.local", PEER_IP, 4500);
+	lan.peer.deliver(lan.udp, false);
+	lan.mdns.loop();
+}
+
+// Number of PTR records listing instance in query, the last one in found.
+static int listed(const Sent &query, const char *instance,
+		RecordView *found = NULL) {
+	RecordIterator records(&query.data[0], query.data.size());
+	RecordView record;
+	int n = 0;
+	while (records.nextRecord(record)) {
+		if (record.rrtype == MDNS_TYPE_PTR
+				&& dnsNameEquals(&query.data[0], query.data.size(),
+						record.rdata_offset, instance)) {
+			n++;
+			if (found) {
+				*found = record;
+			}
+		}
+	}
+	return n;
+}
+
+static void testKnownAnswerTtl() {
+	Client lan;
+	cacheInstances(lan, 1, 100);
+	lan.peer.clear();
+	lan.peer.ptr("_http._tcp.local", "Long._http._tcp.local");
+	lan.peer.srv("Long._http._tcp.local", "box.local", 80, 4500);
+	lan.peer.deliver(lan.udp, false);
+	lan.mdns.loop();
+
+	const unsigned long started = millis();
+	lan.client.startBrowse("_http._tcp.local");
+	lan.run(64000);
+	int checked = 0;
+	for (size_t i = 0; i < lan.sent.size(); i++) {
+		const Sent &query = lan.sent[i];
+		RecordView record;
+		CHECK_EQ(1, listed(query, "Long._http._tcp.local", &record));
+		// Listed with the TTL it has left.
+		CHECK_EQ(4500 - (query.at - started + 999) / 1000, record.rrttl);
+		// Box0 only while it has more than half its 100 s left.
+		CHECK_EQ(query.at - started < 50000 ? 1 : 0,
+				listed(query, "Box0 on the top shelf by the door._http._tcp.local"));
+		checked++;
+	}
+	// Queries at 0, 1, 3, 7, 15, 31 and 63 s.
+	CHECK_EQ(7, checked);
+}
+
+static void testKnownAnswerSpill() {
+	Client lan;
+	const int instances = 7;
+	cacheInstances(lan, instances, 4500);
+
+	// Three more lookups with long names leave little room for the Known
+	// Answers of the first.
+	lan.client.startBrowse("_http._tcp.local");
+	char names[3][256];
+	for (int i = 0; i < 3; i++) {
+		char *p = names[i];
+		for (int label = 0; label < 4; label++) {
+			memset(p, 'a' + i, 60);
+			p += 60;
+			*p++ = '.';
+		}
+		strcpy(p, "local");
+		CHECK(lan.client.startBrowse(names[i]) != MDNSClient::INVALID_LOOKUP);
+	}
+	lan.loop();
+	CHECK_EQ(2, lan.sent.size());
+	if (lan.sent.size() != 2) {
+		return;
+	}
+	const Sent &first = lan.sent[0];
+	const Sent &second = lan.sent[1];
+	CHECK(first.isQuery());
+	CHECK(first.isTruncated());
+	CHECK_EQ(1, first.asks(MDNS_TYPE_PTR, "_http._tcp.local"));
+	const int spilled = instances
+			- first.answers(MDNS_TYPE_PTR, "_http._tcp.local");
+	CHECK(spilled > 0);
+	CHECK(spilled < instances);
+	// The rest follow at once, without the questions.
+	CHECK(second.isQuery());
+	CHECK(!second.isTruncated());
+	CHECK_EQ(first.at, second.at);
+	CHECK_EQ(0, second.asks(0, "_http._tcp.local"));
+	CHECK_EQ(spilled,
+			second.answers(MDNS_TYPE_PTR, "_http._tcp.local"));
+	for (int i = 0; i < instances; i++) {
+		char name[64];
+		sprintf(name, "Box%d on the top shelf by the door._http._tcp.local", i);
+		CHECK_EQ(1, listed(first, name) + listed(second, name));
+	}
+}
+
+static void testBrowseBackoff() {
+	Client lan;
+	const unsigned long started = millis();
+	const MDNSClient::LookupHandle handle = lan.client.startBrowse(
+			"_http._tcp.local", NULL, 8000);
+	lan.run(40000);
+	CHECK_EQ(MDNSClient::STATUS_PENDING, lan.client.getStatus(handle));
+	// Queries at 0, 1, 3 and 7 s, then every 8 s.
+	const unsigned long expected[] = { 0, 1000, 3000, 7000, 15000, 23000,
+			31000, 39000 };
+	const size_t count = sizeof(expected) / sizeof(expected[0]);
+	CHECK_EQ(count, lan.sent.size());
+	for (size_t i = 0; i < count and i < lan.sent.size(); i++) {
+		CHECK(lan.sent[i].isQuery());
+		CHECK_EQ(1, lan.sent[i].asks(MDNS_TYPE_PTR, "_http._tcp.local"));
+		// Each goes on the poll() after it falls due.
+		CHECK_EQ(expected[i] + 1, lan.sent[i].at - started);
+	}
+}
+
+static void testBrowseGoodbye() {
+	Client lan;
+	callbacks = 0;
+	const unsigned long started = millis();
+	const MDNSClient::LookupHandle handle = lan.client.startBrowse(
+			"_http._tcp.local", onLookup);
+	lan.run(1);
+	CHECK_EQ(1, lan.sent.size());
+	CHECK_EQ(0, callbacks);
+
+	lan.peer.clear();
+	lan.peer.ptr("_http._tcp.local", "Box._http._tcp.local");
+	lan.peer.srv("Box._http._tcp.local", "box.local", 80);
+	lan.peer.a("box.local", PEER_IP);
+	lan.peer.deliver(lan.udp, false);
+	lan.loop();
+	CHECK_EQ(1, callbacks);
+	CHECK_EQ(MDNSClient::STATUS_PENDING, calledStatus);
+	CHECK_EQ(1, lan.client.getHostCount(handle));
+
+	// What was found is listed as a Known Answer from then on.
+	lan.run(1000);
+	CHECK_EQ(2, lan.sent.size());
+	if (lan.sent.size() == 2) {
+		CHECK_EQ(1001, lan.sent[1].at - started);
+		CHECK_EQ(1, listed(lan.sent[1], "Box._http._tcp.local"));
+	}
+
+	// Until it says goodbye.
+	lan.peer.clear();
+	lan.peer.ptr("_http._tcp.local", "Box._http._tcp.local", 0);
+	lan.peer.deliver(lan.udp, false);
+	lan.loop();
+	CHECK_EQ(2, callbacks);
+	CHECK_EQ(MDNSClient::STATUS_PENDING, calledStatus);
+	CHECK_EQ(0, lan.client.getHostCount(handle));
+	CHECK(lan.client.getHost(handle, 0) == NULL);
+	lan.run(2000);
+	CHECK_EQ(3, lan.sent.size());
+	if (lan.sent.size() == 3) {
+		CHECK_EQ(0, listed(lan.sent[2], "Box._http._tcp.local"));
+	}
+	CHECK_EQ(2, callbacks);
+}
+
+static void testFollowUps() {
+	Client lan;
+	const MDNSClient::LookupHandle handle = lan.client.startLookupService(
+			"_http._tcp.local", 5000);
+	lan.run(1);
+	lan.reset();
+
+	// An answer without the SRV and A records of its instance.
+	lan.peer.clear();
+	lan.peer.ptr("_http._tcp.local", "Box._http._tcp.local");
+	lan.peer.deliver(lan.udp, false);
+	lan.loop();
+	const unsigned long answered = millis();
+	lan.run(3000);
+	CHECK_EQ(MDNS_FOLLOW_UPS, lan.sent.size());
+	for (size_t i = 0; i < lan.sent.size(); i++) {
+		CHECK(lan.sent[i].isQuery());
+		CHECK_EQ(1, lan.sent[i].asks(MDNS_TYPE_SRV, "Box._http._tcp.local"));
+		CHECK_EQ(MDNS_FOLLOW_UP_DELAY + i * MDNS_FOLLOW_UP_INTERVAL,
+				lan.sent[i].at - answered);
+	}
+
+	// The SRV record brings a fresh start for the A record still missing.
+	lan.reset();
+	lan.peer.clear();
+	lan.peer.srv("Box._http._tcp.local", "box.local", 80);
+	lan.peer.deliver(lan.udp, false);
+	lan.loop();
+	const unsigned long srv = millis();
+	lan.run(MDNS_FOLLOW_UP_DELAY);
+	CHECK_EQ(1, lan.sent.size());
+	if (lan.sent.size() == 1) {
+		CHECK_EQ(1, lan.sent[0].asks(MDNS_TYPE_A, "box.local"));
+		CHECK_EQ(0, lan.sent[0].asks(MDNS_TYPE_SRV, "Box._http._tcp.local"));
+		CHECK_EQ(MDNS_FOLLOW_UP_DELAY, lan.sent[0].at - srv);
+	}
+	CHECK_EQ(MDNSClient::STATUS_PENDING, lan.client.getStatus(handle));
+
+	lan.answer("box.local", PEER_IP);
+	lan.loop();
+	CHECK_EQ(MDNSClient::STATUS_RESOLVED, lan.client.getStatus(handle));
+	CHECK_EQ(1, lan.client.getHostCount(handle));
+}
+
+static const uint8_t PEER_IP6[16] = { 0xfe, 0x80, 0, 0, 0, 0, 0, 0,
+		0x02, 0x11, 0x22, 0xff, 0xfe, 0x33, 0x44, 0x55 };
+
+static void testLookupHost6() {
+	Client lan;
+	const MDNSClient::LookupHandle handle = lan.client.startLookupHost6(
+			"peer.local");
+	lan.loop();
+	CHECK_EQ(1, lan.sent.size());
+	if (lan.sent.size() == 1) {
+		CHECK_EQ(1, lan.sent[0].asks(MDNS_TYPE_AAAA, "peer.local"));
+		CHECK_EQ(0, lan.sent[0].asks(MDNS_TYPE_A, "peer.local"));
+	}
+	// An A record doesn't answer it.
+	lan.answer("peer.local", PEER_IP);
+	lan.loop();
+	CHECK_EQ(MDNSClient::STATUS_PENDING, lan.client.getStatus(handle));
+
+	lan.peer.clear();
+	lan.peer.aaaa("peer.local", PEER_IP6);
+	lan.peer.deliver(lan.udp, false);
+	lan.loop();
+	CHECK_EQ(MDNSClient::STATUS_RESOLVED, lan.client.getStatus(handle));
+	uint8_t address[16] = { 0 };
+	CHECK(lan.client.getHostAddress6(handle, address));
+	CHECK(memcmp(address, PEER_IP6, 16) == 0);
+	CHECK(lan.client.getHostAddress(handle) == INADDR_NONE);
+}
+
+static void testLookupHostDual() {
+	Client lan;
+	// Only the AAAA record comes.
+	const MDNSClient::LookupHandle six = lan.client.startLookupHostDual(
+			"six.local");
+	lan.loop();
+	CHECK_EQ(1, lan.sent.size());
+	if (lan.sent.size() == 1) {
+		CHECK_EQ(1, lan.sent[0].asks(MDNS_TYPE_A, "six.local"));
+		CHECK_EQ(1, lan.sent[0].asks(MDNS_TYPE_AAAA, "six.local"));
+	}
+	lan.peer.clear();
+	lan.peer.aaaa("six.local", PEER_IP6);
+	lan.peer.deliver(lan.udp, false);
+	lan.loop();
+	CHECK_EQ(MDNSClient::STATUS_RESOLVED, lan.client.getStatus(six));
+	uint8_t address[16] = { 0 };
+	CHECK(lan.client.getHostAddress6(six, address));
+	CHECK(memcmp(address, PEER_IP6, 16) == 0);
+	CHECK(lan.client.getHostAddress(six) == INADDR_NONE);
+
+	// Only the A record comes.
+	const MDNSClient::LookupHandle four = lan.client.startLookupHostDual(
+			"four.local");
+	lan.loop();
+	lan.answer("four.local", PEER_IP);
+	lan.loop();
+	CHECK_EQ(MDNSClient::STATUS_RESOLVED, lan.client.getStatus(four));
+	CHECK(lan.client.getHostAddress(four) == PEER_IP);
+	CHECK(!lan.client.getHostAddress6(four, address));
+
+	// Both, in one response.
+	const MDNSClient::LookupHandle both = lan.client.startLookupHostDual(
+			"both.local");
+	lan.loop();
+	lan.peer.clear();
+	lan.peer.a("both.local", PEER_IP);
+	lan.peer.aaaa("both.local", PEER_IP6);
+	lan.peer.deliver(lan.udp, false);
+	lan.loop();
+	CHECK_EQ(MDNSClient::STATUS_RESOLVED, lan.client.getStatus(both));
+	CHECK(lan.client.getHostAddress(both) == PEER_IP);
+	memset(address, 0, sizeof(address));
+	CHECK(lan.client.getHostAddress6(both, address));
+	CHECK(memcmp(address, PEER_IP6, 16) == 0);
+
+	// Neither.
+	const MDNSClient::LookupHandle none = lan.client.startLookupHostDual(
+			"none.local", 100);
+	lan.run(100);
+	CHECK_EQ(MDNSClient::STATUS_TIMEOUT, lan.client.getStatus(none));
+	CHECK(lan.client.getHostAddress(none) == INADDR_NONE);
+	CHECK(!lan.client.getHostAddress6(none, address));
+}
+
+// The peer answers a service lookup with count instances, "Box0", "Box1"...
+// of service, all on box.local.
+static void answerService(Client &lan, const char *service, int count) {
+	lan.peer.clear();
+	for (int i = 0; i < count; i++) {
+		char name[64];
+		sprintf(name, "Box%d.%s", i, service);
+		lan.peer.ptr(service, name);
+		lan.peer.srv(name, "box.local", 80);
+	}
+	lan.peer.a("box.local", PEER_IP);
+	lan.peer.deliver(lan.udp, false);
+}
+
+static void testHostNameTooLong() {
+	Client lan;
+	const MDNSClient::LookupHandle handle = lan.client.startLookupService(
+			"_http._tcp.local");
+	lan.loop();
+	char name[MDNS_HOST_NAME_LEN + 32];
+	memset(name, 'x', MDNS_HOST_NAME_LEN - 1);
+	strcpy(name + MDNS_HOST_NAME_LEN - 1, "._http._tcp.local");
+	lan.peer.clear();
+	lan.peer.ptr("_http._tcp.local", name);
+	lan.peer.srv(name, "box.local", 80);
+	lan.peer.ptr("_http._tcp.local", "Box._http._tcp.local");
+	lan.peer.srv("Box._http._tcp.local", "box.local", 8080);
+	lan.peer.a("box.local", PEER_IP);
+	lan.peer.deliver(lan.udp, false);
+	lan.loop();
+	CHECK_EQ(MDNSClient::STATUS_RESOLVED, lan.client.getStatus(handle));
+	CHECK_EQ(1, lan.client.getHostCount(handle));
+	const HostInfo *host = lan.client.getHost(handle, 0);
+	CHECK(host != NULL);
+	if (host) {
+		CHECK(strcmp(host->service, "Box._http._tcp.local") == 0);
+		CHECK_EQ(8080, host->port);
+	}
+}
+
+static void testHostTableFull() {
+	Client lan;
+	const MDNSClient::LookupHandle handle = lan.client.startLookupService(
+			"_http._tcp.local");
+	lan.loop();
+	answerService(lan, "_http._tcp.local", MAX_HOSTS + 2);
+	lan.loop();
+	CHECK_EQ(MDNSClient::STATUS_RESOLVED, lan.client.getStatus(handle));
+	CHECK_EQ(MAX_HOSTS, lan.client.getHostCount(handle));
+	for (int i = 0; i < MAX_HOSTS; i++) {
+		const HostInfo *host = lan.client.getHost(handle, i);
+		CHECK(host != NULL);
+		if (host) {
+			CHECK(host->ip == PEER_IP);
+			CHECK_EQ(80, host->port);
+		}
+	}
+	CHECK(lan.client.getHost(handle, MAX_HOSTS) == NULL);
+}
+
+static void testHostSlotReuse() {
+	Client lan;
+	const MDNSClient::LookupHandle http = lan.client.startLookupService(
+			"_http._tcp.local");
+	lan.loop();
+	answerService(lan, "_http._tcp.local", MAX_HOSTS);
+	lan.loop();
+	CHECK_EQ(MAX_HOSTS, lan.client.getHostCount(http));
+
+	// Taking the other slots leaves the results alone.
+	for (int i = 1; i < MAX_LOOKUPS; i++) {
+		char name[16];
+		sprintf(name, "host%d.local", i);
+		lan.client.startLookupHost(name);
+	}
+	CHECK_EQ(MAX_HOSTS, lan.client.getHostCount(http));
+
+	// Reusing the slot frees the hosts for the new lookup.
+	const MDNSClient::LookupHandle ipp = lan.client.startLookupService(
+			"_ipp._tcp.local");
+	CHECK(ipp != MDNSClient::INVALID_LOOKUP);
+	CHECK_EQ(MDNSClient::STATUS_UNKNOWN, lan.client.getStatus(http));
+	CHECK_EQ(0, lan.client.getHostCount(http));
+	CHECK_EQ(0, lan.client.getHostCount(ipp));
+	lan.loop();
+	answerService(lan, "_ipp._tcp.local", 2);
+	lan.loop();
+	CHECK_EQ(MDNSClient::STATUS_RESOLVED, lan.client.getStatus(ipp));
+	CHECK_EQ(2, lan.client.getHostCount(ipp));
+	for (int i = 0; i < 2; i++) {
+		const HostInfo *host = lan.client.getHost(ipp, i);
+		CHECK(host != NULL);
+		if (host) {
+			CHECK(strstr(host->service, "._ipp._tcp.local") != NULL);
+		}
+	}
+}
+
+int main() {
+	RUN_TEST(testCallback);
+	RUN_TEST(testTimeout);
+	RUN_TEST(testStaleHandle);
+	RUN_TEST(testConcurrentLookups);
+	RUN_TEST(testLookupHostsSplit);
+	RUN_TEST(testKnownAnswerTtl);
+	RUN_TEST(testKnownAnswerSpill);
+	RUN_TEST(testBrowseBackoff);
+	RUN_TEST(testBrowseGoodbye);
+	RUN_TEST(testFollowUps);
+	RUN_TEST(testLookupHost6);
+	RUN_TEST(testLookupHostDual);
+	RUN_TEST(testHostNameTooLong);
+	RUN_TEST(testHostTableFull);
+	RUN_TEST(testHostSlotReuse);
+	return testResult();
+}
@@ -0,0 +1,1036 @@
+/*
+ * mdns_test.cpp
+ *
+ * MDns itself: reading names, the record cache, and which callbacks and
+ * listeners get which packets.
+ */
+
+#include "test.h"
+
+// Counts what it is handed.
+class Counter : public Callback {
+public:
+	uint8_t interest;
+	int packets = 0;
+	int questions = 0;
+	int records = 0;
+
+	explicit Counter(uint8_t interest_ = INTEREST_ALL) : interest(interest_) {}
+
+	virtual uint8_t getInterest() const {
+		return interest;
+	}
+	virtual void onPacket(const MDns* packet) {
+		packets++;
+	}
+	virtual void onQuestion(const QuestionView& question) {
+		questions++;
+	}
+	virtual void onRecord(const RecordView& record) {
+		records++;
+	}
+};
+
+static void sendQuery(Lan &lan) {
+	Peer peer;
+	peer.question("sim.local", MDNS_TYPE_A);
+	peer.deliver(lan.udp, true);
+}
+
+static void sendResponse(Lan &lan) {
+	Peer peer;
+	peer.a("sim.local", PEER_IP);
+	peer.deliver(lan.udp, false);
+}
+
+// One object registered both as the callback and as a listener.
+static void testCallbackAlsoListener() {
+	Lan lan;
+	Counter counter(INTEREST_RESPONSES);
+	Counter other(INTEREST_RESPONSES);
+	lan.mdns.addListener(&counter);
+	lan.mdns.addListener(&other);
+	lan.mdns.setCallback(&counter);
+	sendResponse(lan);
+	CHECK(lan.mdns.loop());
+	CHECK(counter.records > 0);
+	CHECK_EQ(1, other.records);
+
+	// The interest walk used to go round in circles on this.
+	sendQuery(lan);
+	CHECK(lan.mdns.loop());
+	CHECK_EQ(0, counter.questions);
+	lan.mdns.setCallback(NULL);
+	lan.mdns.removeListener(&counter);
+	lan.mdns.removeListener(&other);
+}
+
+static void testInterest() {
+	Lan lan;
+	Counter responses(INTEREST_RESPONSES);
+	lan.mdns.addListener(&responses);
+	sendQuery(lan);
+	lan.loop();
+	// Dropped on its header.
+	CHECK_EQ(0, responses.packets);
+	sendResponse(lan);
+	lan.loop();
+	CHECK_EQ(1, responses.packets);
+	CHECK_EQ(1, responses.records);
+
+	Counter queries(INTEREST_QUERIES);
+	lan.mdns.addListener(&queries);
+	sendQuery(lan);
+	lan.loop();
+	CHECK_EQ(1, queries.questions);
+	lan.mdns.removeListener(&queries);
+	lan.mdns.removeListener(&responses);
+}
+
+// The TXT rdata of an Answer as it went out, or -1 if it wasn't added.
+static int sendTxt(const byte *rdata, unsigned int rdlength, byte *sent) {
+	LoopbackUDP udp;
+	MDns mdns(udp, NULL, MAX_PACKET_SIZE, NULL);
+	mdns.Clear();
+	Answer answer;
+	strcpy(answer.name_buffer, "Box._http._tcp.local");
+	memcpy(answer.rdata_buffer, rdata, rdlength);
+	answer.rdlength = rdlength;
+	answer.rrtype = MDNS_TYPE_TXT;
+	answer.rrclass = 1;
+	answer.rrttl = 4500;
+	answer.rrset = true;
+	if (!mdns.AddAnswer(answer)) {
+		return -1;
+	}
+	mdns.Send();
+	const std::vector<uint8_t> packet = udp.lastSent();
+	RecordIterator records(&packet[0], packet.size());
+	RecordView record;
+	if (!records.nextRecord(record) || record.rrtype != MDNS_TYPE_TXT) {
+		return -1;
+	}
+	memcpy(sent, &packet[record.rdata_offset], record.rdlength);
+	return record.rdlength;
+}
+
+static void testAnswerTxt() {
+	// An empty string in the middle: its 0 length must not end the rdata.
+	const byte txt[] = { 3, 'a', '=', '1', 0, 4, 'b', '=', 'x', 'y' };
+	byte sent[MAX_MDNS_NAME_LEN];
+	CHECK_EQ(sizeof(txt), sendTxt(txt, sizeof(txt), sent));
+	CHECK(memcmp(txt, sent, sizeof(txt)) == 0);
+
+	// No strings still sends one empty string.
+	CHECK_EQ(1, sendTxt(txt, 0, sent));
+	CHECK_EQ(0, sent[0]);
+
+	// Cut short when it was received: not sent as it is.
+	Answer answer;
+	strcpy(answer.name_buffer, "Box._http._tcp.local");
+	answer.rdlength = MAX_MDNS_NAME_LEN;
+	answer.rrtype = MDNS_TYPE_TXT;
+	answer.rrclass = 1;
+	answer.rrttl = 4500;
+	answer.rrset = true;
+	LoopbackUDP udp;
+	MDns mdns(udp, NULL, MAX_PACKET_SIZE, NULL);
+	mdns.Clear();
+	CHECK(!mdns.AddAnswer(answer));
+}
+
+// TXT records too long for the cache keep the strings which fit.
+static void testCacheLongTxt() {
+	Lan lan;
+	Counter responses(INTEREST_RESPONSES);
+	lan.mdns.addListener(&responses);
+	// Five strings of "key=" and 16 more bytes: 105 bytes of rdata.
+	byte txt[5 * 21];
+	for (int i = 0; i < 5; i++) {
+		txt[21 * i] = 20;
+		memcpy(txt + 21 * i + 1, "key=0123456789abcdef", 20);
+		txt[21 * i + 3] = 'a' + i;
+	}
+	Peer peer;
+	peer.record("Box._http._tcp.local", MDNS_TYPE_TXT, 4500, txt, sizeof(txt),
+			sizeof(txt));
+	peer.record("Cam._http._tcp.local", MDNS_TYPE_TXT, 4500, txt, 21, 21);
+	peer.deliver(lan.udp, false);
+	lan.loop();
+
+	const CacheEntry * entry = lan.mdns.getCache().find(
+			DnsName("Box._http._tcp.local"), MDNS_TYPE_TXT, millis());
+	CHECK(entry != NULL);
+	if (entry) {
+		CHECK(entry->truncated);
+		CHECK_EQ(MDNS_CACHE_TXT_LEN / 21 * 21, entry->rdlength);
+		TxtIterator strings = entry->getTxt();
+		TxtEntry string;
+		int count = 0;
+		while (strings.next(string)) {
+			count++;
+		}
+		CHECK_EQ(MDNS_CACHE_TXT_LEN / 21, count);
+		CHECK(entry->getTxt().find("kea", string));
+		CHECK(!entry->getTxt().find("kee", string));
+	}
+	entry = lan.mdns.getCache().find(DnsName("Cam._http._tcp.local"),
+			MDNS_TYPE_TXT, millis());
+	CHECK(entry != NULL);
+	if (entry) {
+		CHECK(!entry->truncated);
+		CHECK_EQ(21, entry->rdlength);
+	}
+	lan.mdns.removeListener(&responses);
+}
+
+// The rdata of an A or AAAA Answer as it went out, or -1 if it wasn't
+// added.
+static int sendAddress(const Answer &answer, byte *sent) {
+	LoopbackUDP udp;
+	MDns mdns(udp, NULL, MAX_PACKET_SIZE, NULL);
+	mdns.Clear();
+	if (!mdns.AddAnswer(answer)) {
+		return -1;
+	}
+	mdns.Send();
+	const std::vector<uint8_t> packet = udp.lastSent();
+	RecordIterator records(&packet[0], packet.size());
+	RecordView record;
+	if (!records.nextRecord(record) || record.rrtype != answer.rrtype) {
+		return -1;
+	}
+	memcpy(sent, &packet[record.rdata_offset], record.rdlength);
+	return record.rdlength;
+}
+
+static void testAnswerAddress() {
+	Answer answer;
+	strcpy(answer.name_buffer, "box.local");
+	answer.rrtype = MDNS_TYPE_A;
+	answer.rrclass = 1;
+	answer.rrttl = 120;
+	answer.rrset = true;
+	answer.ipAddress = PEER_IP;
+	byte sent[16];
+	CHECK_EQ(4, sendAddress(answer, sent));
+	CHECK(IPAddress(sent[0], sent[1], sent[2], sent[3]) == PEER_IP);
+	// Without ipAddress, the bytes of rdata_buffer.
+	answer.ipAddress = INADDR_NONE;
+	memcpy(answer.rdata_buffer, "\x0a\x00\x00\x05", 4);
+	CHECK_EQ(4, sendAddress(answer, sent));
+	CHECK(IPAddress(sent[0], sent[1], sent[2], sent[3]) == DEVICE_IP);
+
+	const byte address6[16] = { 0xfe, 0x80, 0, 0, 0, 0, 0, 0, 1, 2, 3, 4, 5,
+			6, 7, 8 };
+	answer.rrtype = MDNS_TYPE_AAAA;
+	memcpy(answer.ipv6, address6, 16);
+	CHECK_EQ(16, sendAddress(answer, sent));
+	CHECK(memcmp(sent, address6, 16) == 0);
+	// Without ipv6, the bytes of rdata_buffer.
+	memset(answer.ipv6, 0, 16);
+	memcpy(answer.rdata_buffer, address6, 16);
+	answer.rdata_buffer[15] = 9;
+	CHECK_EQ(16, sendAddress(answer, sent));
+	CHECK(memcmp(sent, address6, 15) == 0);
+	CHECK_EQ(9, sent[15]);
+
+	// A new Answer falls back to rdata_buffer for both.
+	Answer fresh;
+	CHECK(fresh.ipAddress == INADDR_NONE);
+	for (int i = 0; i < 16; i++) {
+		CHECK_EQ(0, fresh.ipv6[i]);
+	}
+}
+
+// Records decoded into an Answer, one after the other.
+static void testToAnswer() {
+	LoopbackUDP udp;
+	MDns mdns(udp, NULL, MAX_PACKET_SIZE, NULL);
+	mdns.Clear();
+	const DnsName box("box.local");
+	const DnsName instance("Box._http._tcp.local");
+	const byte address[4] = { 10, 0, 0, 9 };
+	const byte address6[16] = { 0xfe, 0x80, 0, 0, 0, 0, 0, 0, 1, 2, 3, 4, 5,
+			6, 7, 8 };
+	byte srv[6 + MAX_MDNS_NAME_LEN] = { 0, 10, 0, 20, 0x1F, 0x90 };
+	memcpy(srv + 6, box.getWire(), box.getLength());
+	mdns.AddRawAnswer(box.getWire(), box.getLength(), MDNS_TYPE_A, 0x8001, 120,
+			address, 4, 4);
+	mdns.AddRawAnswer(box.getWire(), box.getLength(), MDNS_TYPE_AAAA, 0x8001,
+			120, address6, 16, 16);
+	mdns.AddRawAnswer(instance.getWire(), instance.getLength(), MDNS_TYPE_SRV,
+			0x8001, 120, srv, 6 + box.getLength(), 6);
+	// Too short for what they should carry.
+	mdns.AddRawAnswer(box.getWire(), box.getLength(), MDNS_TYPE_AAAA, 1, 120,
+			address, 4, 4);
+	mdns.AddRawAnswer(instance.getWire(), instance.getLength(), MDNS_TYPE_SRV,
+			1, 120, srv, 4, 4);
+	mdns.AddRawAnswer(box.getWire(), box.getLength(), MDNS_TYPE_A, 1, 120,
+			address, 3, 3);
+	mdns.Send();
+	const std::vector<uint8_t> data = udp.lastSent();
+
+	RecordIterator records(&data[0], data.size());
+	RecordView record;
+	Answer answer;
+	CHECK(records.nextRecord(record));
+	record.toAnswer(answer);
+	CHECK(answer.valid);
+	CHECK_EQ(MDNS_TYPE_A, answer.rrtype);
+	CHECK(answer.rrset);
+	CHECK(strcmp(answer.name_buffer, "box.local") == 0);
+	CHECK(answer.ipAddress == PEER_IP);
+
+	CHECK(records.nextRecord(record));
+	record.toAnswer(answer);
+	CHECK_EQ(MDNS_TYPE_AAAA, answer.rrtype);
+	CHECK_EQ(16, answer.rdlength);
+	CHECK(memcmp(answer.ipv6, address6, 16) == 0);
+
+	CHECK(records.nextRecord(record));
+	record.toAnswer(answer);
+	CHECK(answer.valid);
+	CHECK_EQ(MDNS_TYPE_SRV, answer.rrtype);
+	CHECK(strcmp(answer.name_buffer, "Box._http._tcp.local") == 0);
+	CHECK_EQ(10, answer.priority);
+	CHECK_EQ(20, answer.weight);
+	CHECK_EQ(8080, answer.port);
+	// The target was compressed against the name of the A record.
+	CHECK(strcmp(answer.rdata_buffer, "box.local") == 0);
+	CHECK_EQ(record.rdata_offset + 6, answer.target_offset);
+	CHECK(box.matches(&data[0], data.size(), answer.target_offset));
+
+	// Nothing of the previous record is left in the fields.
+	CHECK(records.nextRecord(record));
+	record.toAnswer(answer);
+	CHECK_EQ(MDNS_TYPE_AAAA, answer.rrtype);
+	const byte zero[16] = { 0 };
+	CHECK(memcmp(answer.ipv6, zero, 16) == 0);
+	CHECK(records.nextRecord(record));
+	record.toAnswer(answer);
+	CHECK_EQ(MDNS_TYPE_SRV, answer.rrtype);
+	CHECK_EQ(0, answer.priority);
+	CHECK_EQ(0, answer.weight);
+	CHECK_EQ(0, answer.port);
+	CHECK(answer.rdata_buffer[0] == '\0');
+	CHECK(records.nextRecord(record));
+	record.toAnswer(answer);
+	CHECK_EQ(MDNS_TYPE_A, answer.rrtype);
+	CHECK(answer.ipAddress == INADDR_NONE);
+	CHECK(!records.nextRecord(record));
+}
+
+// TxtIterator stops at a string whose length runs past the rdata, never
+// reading beyond it.
+static void testTxtMalformed() {
+	// The rdata is the first 8 bytes; "b=2" seems to go on past them.
+	const byte rdata[] = { 3, 'a', '=', '1', 9, 'b', '=', '2', 'x', 'x', 'x',
+			'x', 'x', 'x' };
+	TxtIterator txt(rdata, 8);
+	TxtEntry entry;
+	char value[16];
+	CHECK(txt.next(entry));
+	CHECK(entry.keyEquals("a"));
+	CHECK(entry.getValue(value, sizeof(value)));
+	CHECK(strcmp(value, "1") == 0);
+	CHECK(!txt.next(entry));
+	// And stays at the end.
+	CHECK(!txt.next(entry));
+	CHECK(TxtIterator(rdata, 8).find("a", entry));
+	CHECK(!TxtIterator(rdata, 8).find("b", entry));
+
+	// Running past by a single byte.
+	const byte one[] = { 3, 'a', '=', '1', 4, 'b', '=', '2', 0 };
+	TxtIterator short_by_one(one, 8);
+	CHECK(short_by_one.next(entry));
+	CHECK(!short_by_one.next(entry));
+	// Ending exactly at the end is fine.
+	TxtIterator exact(one, 4);
+	CHECK(exact.next(entry));
+	CHECK(!exact.next(entry));
+
+	// A bad first string hides everything after it.
+	const byte first[] = { 200, 'a', '=', '1' };
+	TxtIterator bad(first, sizeof(first));
+	CHECK(!bad.next(entry));
+	bad.rewind();
+	CHECK(!bad.next(entry));
+}
+
+// Number of A records of name in the cache, and the address of the last one.
+static int cachedA(Lan &lan, const char *name, IPAddress *address = NULL) {
+	const RecordCache &cache = lan.mdns.getCache();
+	const DnsName wire(name);
+	const CacheEntry *entry = NULL;
+	int n = 0;
+	while ((entry = cache.find(wire, MDNS_TYPE_A, millis(), entry))) {
+		n++;
+		if (address) {
+			*address = entry->getIPv4();
+		}
+	}
+	return n;
+}
+
+// Deliver an A record, with the cache-flush bit unless shared.
+static void sendA(Lan &lan, const char *name, IPAddress address,
+		unsigned long rrttl, bool shared = false) {
+	Peer peer;
+	const byte rdata[4] = { address[0], address[1], address[2], address[3] };
+	peer.record(name, MDNS_TYPE_A, rrttl, rdata, 4, 4, shared ? 1 : 0x8001);
+	peer.deliver(lan.udp, false);
+	lan.loop();
+}
+
+static void testCacheExpiry() {
+	Lan lan;
+	Counter responses(INTEREST_RESPONSES);
+	lan.mdns.addListener(&responses);
+	sendA(lan, "box.local", PEER_IP, 2);
+	lan.run(1999);
+	CHECK_EQ(1, cachedA(lan, "box.local"));
+	const CacheEntry *entry = lan.mdns.getCache().find(DnsName("box.local"),
+			MDNS_TYPE_A, millis());
+	CHECK(entry != NULL);
+	if (entry) {
+		CHECK_EQ(1, entry->remaining(millis()));
+	}
+	lan.run(1);
+	CHECK_EQ(0, cachedA(lan, "box.local"));
+
+	// Heard again, it lives on.
+	sendA(lan, "cam.local", PEER_IP, 2);
+	lan.run(1500);
+	sendA(lan, "cam.local", PEER_IP, 2);
+	lan.run(1500);
+	CHECK_EQ(1, cachedA(lan, "cam.local"));
+	lan.mdns.removeListener(&responses);
+}
+
+static void testCacheGoodbye() {
+	Lan lan;
+	Counter responses(INTEREST_RESPONSES);
+	lan.mdns.addListener(&responses);
+	const IPAddress other(10, 0, 0, 10);
+	sendA(lan, "box.local", PEER_IP, 120, true);
+	sendA(lan, "box.local", other, 120, true);
+	CHECK_EQ(2, cachedA(lan, "box.local"));
+
+	// A TTL of 0 removes that record only.
+	sendA(lan, "box.local", PEER_IP, 0, true);
+	IPAddress address;
+	CHECK_EQ(1, cachedA(lan, "box.local", &address));
+	CHECK(address == other);
+	// A goodbye for a record never cached adds nothing.
+	sendA(lan, "cam.local", PEER_IP, 0);
+	CHECK_EQ(0, cachedA(lan, "cam.local"));
+	lan.mdns.removeListener(&responses);
+}
+
+static void testCacheFlush() {
+	Lan lan;
+	Counter responses(INTEREST_RESPONSES);
+	lan.mdns.addListener(&responses);
+	const IPAddress first(10, 0, 0, 11);
+	const IPAddress second(10, 0, 0, 12);
+	const IPAddress third(10, 0, 0, 13);
+	sendA(lan, "box.local", first, 120);
+	// Within a second of each other, records of one RRset add up.
+	lan.run(1000);
+	sendA(lan, "box.local", second, 120);
+	CHECK_EQ(2, cachedA(lan, "box.local"));
+
+	// After that the cache-flush bit replaces those older than a second.
+	lan.run(1);
+	sendA(lan, "box.local", third, 120);
+	IPAddress address;
+	CHECK_EQ(2, cachedA(lan, "box.local", &address));
+	const RecordCache &cache = lan.mdns.getCache();
+	const DnsName box("box.local");
+	const CacheEntry *entry = NULL;
+	while ((entry = cache.find(box, MDNS_TYPE_A, millis(), entry))) {
+		CHECK(entry->getIPv4() != first);
+	}
+	lan.run(1001);
+	sendA(lan, "box.local", third, 120);
+	CHECK_EQ(1, cachedA(lan, "box.local", &address));
+	CHECK(address == third);
+
+	// A shared record flushes nothing.
+	lan.run(2000);
+	sendA(lan, "box.local", first, 120, true);
+	CHECK_EQ(2, cachedA(lan, "box.local"));
+	lan.mdns.removeListener(&responses);
+}
+
+static void testCacheEviction() {
+	Lan lan;
+	Counter responses(INTEREST_RESPONSES);
+	lan.mdns.addListener(&responses);
+	const unsigned int capacity = lan.mdns.getCache().getCapacity();
+	char name[32];
+	for (unsigned int i = 0; i < capacity; i++) {
+		sprintf(name, "host%u.local", i);
+		// host3 expires first.
+		sendA(lan, name, PEER_IP, i == 3 ? 100 : 200 + i);
+	}
+	for (unsigned int i = 0; i < capacity; i++) {
+		sprintf(name, "host%u.local", i);
+		CHECK_EQ(1, cachedA(lan, name));
+	}
+	sendA(lan, "more.local", PEER_IP, 120);
+	CHECK_EQ(1, cachedA(lan, "more.local"));
+	for (unsigned int i = 0; i < capacity; i++) {
+		sprintf(name, "host%u.local", i);
+		CHECK_EQ(i == 3 ? 0 : 1, cachedA(lan, name));
+	}
+	lan.mdns.removeListener(&responses);
+}
+
+// Names spelt in other cases and compressed in several ways.
+static const byte NAMES[] = {
+	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+	// 12: Box._http._tcp.local
+	3, 'B', 'o', 'x', 5, '_', 'h', 't', 't', 'p', 4, '_', 't', 'c', 'p',
+	5, 'l', 'o', 'c', 'a', 'l', 0,
+	// 34: bOX, then a pointer to _http._tcp.local
+	3, 'b', 'O', 'X', 0xC0, 16,
+	// 40: _HTTP, then a pointer to _tcp.local
+	5, '_', 'H', 'T', 'T', 'P', 0xC0, 22,
+	// 48: a pointer to the name at 34
+	0xC0, 34
+};
+
+static void testNameEquals() {
+	const int size = sizeof(NAMES);
+	CHECK(dnsNameEquals(NAMES, size, 12, "box._HTTP._tcp.LOCAL"));
+	CHECK(dnsNameEquals(NAMES, size, 34, "Box._http._tcp.local"));
+	CHECK(dnsNameEquals(NAMES, size, 48, "BOX._http._TCP.local"));
+	CHECK(dnsNameEquals(NAMES, size, 40, "_http._tcp.local"));
+	CHECK(dnsNameEquals(NAMES, size, 48,
+			DnsName("box._http._tcp.local").getWire()));
+	CHECK(dnsNameEquals(NAMES, size, 40, DnsName("_Http._tcp.local").getWire()));
+
+	// Only whole names match.
+	CHECK(!dnsNameEquals(NAMES, size, 48, "Bo._http._tcp.local"));
+	CHECK(!dnsNameEquals(NAMES, size, 48, "Box._http._tcp"));
+	CHECK(!dnsNameEquals(NAMES, size, 48, "Box._http._tcp.local.x"));
+	CHECK(!dnsNameEquals(NAMES, size, 40, DnsName("Box._http._tcp.local")
+			.getWire()));
+	CHECK(!dnsNameEquals(NAMES, size, 40, DnsName("_http._udp.local")
+			.getWire()));
+
+	// DnsName compares the same way.
+	const DnsName box("BOX._Http._tcp.local");
+	CHECK(box.matches(NAMES, size, 12));
+	CHECK(box.matches(NAMES, size, 34));
+	CHECK(box.matches(NAMES, size, 48));
+	CHECK(!box.matches(NAMES, size, 40));
+}
+
+static void testNameHash() {
+	const int size = sizeof(NAMES);
+	const uint32_t box = DnsName("box._HTTP._tcp.local").getHash();
+	CHECK(box != 0);
+	CHECK_EQ(box, hashDnsName(NAMES, size, 12));
+	CHECK_EQ(box, hashDnsName(NAMES, size, 34));
+	CHECK_EQ(box, hashDnsName(NAMES, size, 48));
+	CHECK_EQ(box, DnsName("Box._http._tcp.local").getHash());
+
+	const uint32_t http = DnsName("_http._tcp.local").getHash();
+	CHECK_EQ(http, hashDnsName(NAMES, size, 16));
+	CHECK_EQ(http, hashDnsName(NAMES, size, 40));
+	CHECK(http != box);
+	CHECK(hashDnsName(NAMES, size, 22) != http);
+}
+
+// A packet of questions questions and records records, with body following
+// the header.
+static std::vector<byte> packet(int questions, int records,
+		const std::vector<byte> &body) {
+	std::vector<byte> data(body);
+	const byte header[12] = { 0, 0, (byte) (records ? 0x84 : 0), 0,
+			0, (byte) questions, 0, (byte) records, 0, 0, 0, 0 };
+	data.insert(data.begin(), header, header + 12);
+	return data;
+}
+
+// Whether decodeDnsName() and the other readers of names all reject the
+// name at offset.
+static bool nameRejected(const std::vector<byte> &data, int offset) {
+	char name[MAX_MDNS_NAME_LEN];
+	byte wire[MAX_MDNS_NAME_LEN];
+	return decodeDnsName(name, 0, sizeof(name), &data[0], data.size(),
+			offset) < 0
+			&& copyDnsName(wire, sizeof(wire), &data[0], data.size(), offset) < 0
+			&& hashDnsName(&data[0], data.size(), offset) == 0
+			&& !dnsNameEquals(&data[0], data.size(), offset, "a.local");
+}
+
+static void testMalformedNames() {
+	// A label running past the end.
+	const byte past[] = { 1, 'a', 5, 'l', 'o', 'c' };
+	CHECK(nameRejected(packet(0, 0, std::vector<byte>(past, past + 6)), 12));
+	// A pointer past the end, and one cut short.
+	const byte outside[] = { 1, 'a', 0xC0, 0xF0 };
+	CHECK(nameRejected(packet(0, 0, std::vector<byte>(outside, outside + 4)),
+			12));
+	const byte half[] = { 1, 'a', 0xC0 };
+	CHECK(nameRejected(packet(0, 0, std::vector<byte>(half, half + 3)), 12));
+	// Pointers going round in circles, to itself or through another.
+	const byte self[] = { 1, 'a', 0xC0, 14 };
+	CHECK(nameRejected(packet(0, 0, std::vector<byte>(self, self + 4)), 12));
+	const byte loop[] = { 1, 'a', 0xC0, 16, 1, 'b', 0xC0, 12 };
+	CHECK(nameRejected(packet(0, 0, std::vector<byte>(loop, loop + 8)), 12));
+	// A reserved label type.
+	const byte reserved[] = { 0x41, 'a', 0 };
+	CHECK(nameRejected(packet(0, 0, std::vector<byte>(reserved,
+			reserved + 3)), 12));
+
+	// Longer than a name may be: four labels of 63 and "local".
+	std::vector<byte> body;
+	for (int i = 0; i < 4; i++) {
+		body.push_back(63);
+		body.insert(body.end(), 63, 'a' + i);
+	}
+	const byte local[] = { 5, 'l', 'o', 'c', 'a', 'l', 0 };
+	body.insert(body.end(), local, local + 7);
+	CHECK(nameRejected(packet(0, 0, body), 12));
+	// Likewise when the pointers make it so.
+	body.assign(local, local + 7);
+	for (int i = 0; i < 4; i++) {
+		const int previous = body.size() - (i ? 66 : 7);
+		body.push_back(63);
+		body.insert(body.end(), 63, 'a' + i);
+		body.push_back(0xC0);
+		body.push_back(12 + previous);
+	}
+	const std::vector<byte> chained = packet(0, 0, body);
+	CHECK(!nameRejected(chained, chained.size() - 66 * 2));
+	CHECK(nameRejected(chained, chained.size() - 66));
+}
+
+static void testMalformedRecords() {
+	const byte name[] = { 1, 'a', 5, 'l', 'o', 'c', 'a', 'l', 0 };
+	std::vector<byte> body(name, name + 9);
+	const byte a[] = { 0, 1, 0x80, 1, 0, 0, 0, 120, 0, 4, 10, 0, 0, 9 };
+	body.insert(body.end(), a, a + 14);
+	const std::vector<byte> good = packet(0, 1, body);
+	RecordView record;
+	RecordIterator records(&good[0], good.size());
+	CHECK(records.nextRecord(record));
+	CHECK(record.getIPv4() == PEER_IP);
+	CHECK(!records.nextRecord(record));
+	CHECK(!records.malformed());
+
+	// rdlength running past the end.
+	std::vector<byte> bad = good;
+	bad[12 + 9 + 9] = 5;
+	RecordIterator long_rdata(&bad[0], bad.size());
+	CHECK(!long_rdata.nextRecord(record));
+	CHECK(long_rdata.malformed());
+
+	// Cut short in the fixed fields.
+	bad.assign(good.begin(), good.end() - 8);
+	RecordIterator short_fields(&bad[0], bad.size());
+	CHECK(!short_fields.nextRecord(record));
+	CHECK(short_fields.malformed());
+
+	// More records than there are.
+	bad = good;
+	bad[7] = 2;
+	RecordIterator missing(&bad[0], bad.size());
+	CHECK(missing.nextRecord(record));
+	CHECK(!missing.nextRecord(record));
+	CHECK(missing.malformed());
+
+	// A question whose name runs past the end, before the record.
+	const byte question[] = { 9, 'a' };
+	bad = packet(1, 1, std::vector<byte>(question, question + 2));
+	RecordIterator past(&bad[0], bad.size());
+	QuestionView asked;
+	CHECK(!past.nextQuestion(asked));
+	CHECK(past.malformed());
+	CHECK(!past.nextRecord(record));
+
+	// A question name longer than a name may be.
+	std::vector<byte> longer;
+	for (int i = 0; i < 4; i++) {
+		longer.push_back(63);
+		longer.insert(longer.end(), 63, 'a' + i);
+	}
+	longer.insert(longer.end(), name + 2, name + 9);
+	longer.insert(longer.end(), a, a + 4);
+	bad = packet(1, 0, longer);
+	RecordIterator too_long(&bad[0], bad.size());
+	CHECK(!too_long.nextQuestion(asked));
+	CHECK(too_long.malformed());
+
+	// A record name made of a pointer loop is read past, but its name
+	// never matches and the cache doesn't keep it.
+	const byte loop[] = { 0xC0, 12, 0, 1, 0x80, 1, 0, 0, 0, 120, 0, 4,
+			10, 0, 0, 9 };
+	bad = packet(0, 1, std::vector<byte>(loop, loop + 16));
+	RecordIterator looped(&bad[0], bad.size());
+	CHECK(looped.nextRecord(record));
+	char text[MAX_MDNS_NAME_LEN];
+	CHECK(!record.getName(text, sizeof(text)));
+	CHECK_EQ(0, hashDnsName(record.packet, record.packet_size,
+			record.name_offset));
+	CacheEntry entries[2];
+	RecordCache cache(entries, 2);
+	cache.insert(record, 0);
+	CHECK(entries[0].rrttl == 0 && entries[1].rrttl == 0);
+}
+
+// A question and the records answering it, sharing suffixes.
+static void testCompression() {
+	LoopbackUDP udp;
+	MDns mdns(udp, NULL, MAX_PACKET_SIZE, NULL);
+	mdns.Clear();
+	const DnsName service("_http._tcp.local");
+	const DnsName instance("Box._http._tcp.local");
+	const DnsName host("box.local");
+	CHECK(mdns.AddRawQuery(service.getWire(), service.getLength(),
+			MDNS_TYPE_PTR, 1));
+	CHECK(mdns.AddRawAnswer(service.getWire(), service.getLength(),
+			MDNS_TYPE_PTR, 1, 4500, instance.getWire(), instance.getLength(), 0));
+	byte srv[6 + MAX_MDNS_NAME_LEN] = { 0, 1, 0, 2, 0x1F, 0x90 };
+	memcpy(srv + 6, host.getWire(), host.getLength());
+	CHECK(mdns.AddRawAnswer(instance.getWire(), instance.getLength(),
+			MDNS_TYPE_SRV, 0x8001, 120, srv, 6 + host.getLength(), 6));
+	const byte address[4] = { 10, 0, 0, 9 };
+	CHECK(mdns.AddRawAnswer(host.getWire(), host.getLength(), MDNS_TYPE_A,
+			0x8001, 120, address, 4, 4));
+	mdns.Send();
+	const std::vector<uint8_t> data = udp.lastSent();
+
+	// Only the question name is written out in full.
+	const byte question[] = { 5, '_', 'h', 't', 't', 'p', 4, '_', 't', 'c',
+			'p', 5, 'l', 'o', 'c', 'a', 'l', 0 };
+	CHECK(memcmp(&data[12], question, sizeof(question)) == 0);
+	// PTR: its name points at the question, its rdata is "Box" and a
+	// pointer to it too.
+	const byte ptr[] = { 0xC0, 12, 0, 12, 0, 1, 0, 0, 0x11, 0x94, 0, 6,
+			3, 'B', 'o', 'x', 0xC0, 12 };
+	CHECK(memcmp(&data[12 + 22], ptr, sizeof(ptr)) == 0);
+	// SRV: its name points at the PTR rdata, its target at "local".
+	const byte srvName[] = { 0xC0, 12 + 22 + 12 };
+	CHECK(memcmp(&data[12 + 22 + 18], srvName, 2) == 0);
+	const byte target[] = { 3, 'b', 'o', 'x', 0xC0, 12 + 11 };
+	CHECK(memcmp(&data[12 + 22 + 18 + 12 + 6], target, sizeof(target)) == 0);
+	// A: its name points at the SRV target.
+	const byte aName[] = { 0xC0, 12 + 22 + 18 + 12 + 6 };
+	CHECK(memcmp(&data[12 + 22 + 18 + 24], aName, 2) == 0);
+	CHECK_EQ(12 + 22 + 18 + 24 + 16, data.size());
+
+	// And it reads back as it was built.
+	RecordIterator records(&data[0], data.size());
+	QuestionView asked;
+	CHECK(records.nextQuestion(asked));
+	CHECK(service.matches(&data[0], data.size(), asked.name_offset));
+	CHECK_EQ(MDNS_TYPE_PTR, asked.qtype);
+	RecordView record;
+	char name[MAX_MDNS_NAME_LEN];
+	CHECK(records.nextRecord(record));
+	CHECK_EQ(MDNS_TYPE_PTR, record.rrtype);
+	CHECK(service.matches(&data[0], data.size(), record.name_offset));
+	CHECK(record.getRdataName(name, sizeof(name)));
+	CHECK(strcmp(name, "Box._http._tcp.local") == 0);
+	CHECK(records.nextRecord(record));
+	CHECK_EQ(MDNS_TYPE_SRV, record.rrtype);
+	CHECK(record.rrset);
+	CHECK(record.getName(name, sizeof(name)));
+	CHECK(strcmp(name, "Box._http._tcp.local") == 0);
+	CHECK_EQ(8080, record.getSrvPort());
+	CHECK(record.getRdataName(name, sizeof(name), 6));
+	CHECK(strcmp(name, "box.local") == 0);
+	CHECK(records.nextRecord(record));
+	CHECK_EQ(MDNS_TYPE_A, record.rrtype);
+	CHECK(host.matches(&data[0], data.size(), record.name_offset));
+	CHECK(record.getIPv4() == PEER_IP);
+	CHECK(!records.nextRecord(record));
+	CHECK(!records.malformed());
+
+	// The cache keeps the names expanded.
+	CacheEntry entries[4];
+	RecordCache cache(entries, 4);
+	RecordIterator again(&data[0], data.size());
+	while (again.nextRecord(record)) {
+		cache.insert(record, 0);
+	}
+	const CacheEntry *entry = cache.find(instance, MDNS_TYPE_SRV, 0);
+	CHECK(entry != NULL);
+	if (entry) {
+		CHECK_EQ(6 + host.getLength(), entry->rdlength);
+		CHECK(memcmp(entry->rdata, srv, 6 + host.getLength()) == 0);
+	}
+}
+
+// Records what it is handed, and can remove a listener, itself or another,
+// from within onRecord().
+class Recorder : public Counter {
+public:
+	MDns *mdns = NULL;
+	Callback *removes = NULL;
+	std::vector<unsigned int> types;
+
+	explicit Recorder(uint8_t interest_ = INTEREST_ALL) : Counter(interest_) {}
+
+	virtual void onRecord(const RecordView& record) {
+		Counter::onRecord(record);
+		types.push_back(record.rrtype);
+		if (removes) {
+			mdns->removeListener(removes);
+			removes = NULL;
+		}
+	}
+};
+
+// A response with PTR records of two services, an SRV and an A record.
+static void sendService(Lan &lan) {
+	Peer peer;
+	peer.ptr("_http._tcp.local", "Box._http._tcp.local");
+	peer.ptr("_ipp._tcp.local", "Box._ipp._tcp.local");
+	peer.srv("Box._http._tcp.local", "box.local", 80);
+	peer.a("box.local", PEER_IP);
+	peer.deliver(lan.udp, false);
+}
+
+static void testSubscribe() {
+	Lan lan;
+	Recorder all;
+	Recorder some;
+	lan.mdns.addListener(&all);
+	CHECK(lan.mdns.subscribe(&some, MDNS_TYPE_PTR, "_HTTP._tcp.local"));
+	CHECK(lan.mdns.subscribe(&some, MDNS_TYPE_A));
+	// Already had by the subscription to any A record: still once.
+	CHECK(lan.mdns.subscribe(&some, MDNS_TYPE_A, "box.local"));
+	CHECK(!lan.mdns.subscribe(&some, MDNS_TYPE_A, "bad..name"));
+
+	sendService(lan);
+	lan.loop();
+	CHECK_EQ(4, all.records);
+	CHECK_EQ(2, some.records);
+	CHECK_EQ(2, some.types.size());
+	if (some.types.size() == 2) {
+		CHECK_EQ(MDNS_TYPE_PTR, some.types[0]);
+		CHECK_EQ(MDNS_TYPE_A, some.types[1]);
+	}
+	sendQuery(lan);
+	lan.loop();
+	CHECK_EQ(1, all.questions);
+	CHECK_EQ(1, some.questions);
+
+	// addListener() makes it get everything again.
+	lan.mdns.addListener(&some);
+	some.records = 0;
+	sendService(lan);
+	lan.loop();
+	CHECK_EQ(4, some.records);
+
+	// All subscriptions taken.
+	Recorder more;
+	int taken = 0;
+	while (lan.mdns.subscribe(&more, MDNS_TYPE_TXT)) {
+		taken++;
+	}
+	CHECK_EQ(MDNS_SUBSCRIPTIONS, taken);
+	lan.mdns.removeListener(&more);
+	CHECK(lan.mdns.subscribe(&more, MDNS_TYPE_TXT));
+	lan.mdns.removeListener(&more);
+	lan.mdns.removeListener(&some);
+	lan.mdns.removeListener(&all);
+}
+
+static void testUnsubscribeInDispatch() {
+	Lan lan;
+	Recorder plain[3];
+	Recorder subscribed[3];
+	for (int i = 0; i < 3; i++) {
+		plain[i].mdns = &lan.mdns;
+		subscribed[i].mdns = &lan.mdns;
+		lan.mdns.addListener(&plain[i]);
+		CHECK(lan.mdns.subscribe(&subscribed[i], MDNS_TYPE_PTR));
+		CHECK(lan.mdns.subscribe(&subscribed[i], MDNS_TYPE_A));
+	}
+	// Listeners are called newest first, subscribers in the order they
+	// subscribed. Each removes itself, or the one called after it.
+	plain[2].removes = &plain[2];
+	plain[1].removes = &plain[0];
+	subscribed[0].removes = &subscribed[0];
+	subscribed[1].removes = &subscribed[2];
+	sendService(lan);
+	lan.loop();
+	CHECK_EQ(1, plain[2].records);
+	CHECK_EQ(4, plain[1].records);
+	CHECK_EQ(0, plain[0].records);
+	CHECK_EQ(1, subscribed[0].records);
+	CHECK_EQ(3, subscribed[1].records);
+	CHECK_EQ(0, subscribed[2].records);
+
+	// Those left still get what they asked for.
+	sendService(lan);
+	lan.loop();
+	CHECK_EQ(1, plain[2].records);
+	CHECK_EQ(8, plain[1].records);
+	CHECK_EQ(1, subscribed[0].records);
+	CHECK_EQ(6, subscribed[1].records);
+	CHECK_EQ(0, subscribed[2].records);
+	lan.mdns.removeListener(&plain[1]);
+	lan.mdns.removeListener(&subscribed[1]);
+}
+
+// Listeners' interest decides which packets MDns reads at all.
+static void testInterestFilter() {
+	Lan lan;
+	Recorder responses(INTEREST_RESPONSES);
+	CHECK(lan.mdns.subscribe(&responses, MDNS_TYPE_A));
+	sendQuery(lan);
+	lan.loop();
+	CHECK_EQ(0, responses.packets);
+	sendResponse(lan);
+	lan.loop();
+	CHECK_EQ(1, responses.packets);
+
+	// Queries only for the questions this one finds of interest.
+	class Filter : public Recorder {
+	public:
+		uint32_t hash = DnsName("sim.local").getHash();
+		Filter() : Recorder(INTEREST_QUERIES | INTEREST_QUESTION_FILTER) {}
+		virtual bool isInterestingQuestion(uint32_t name_hash,
+				unsigned int qtype) const {
+			return name_hash == hash && qtype == MDNS_TYPE_A;
+		}
+	} filter;
+	lan.mdns.addListener(&filter);
+	Peer peer;
+	peer.question("other.local", MDNS_TYPE_A);
+	peer.question("sim.local", MDNS_TYPE_AAAA);
+	peer.deliver(lan.udp, true);
+	lan.loop();
+	CHECK_EQ(0, filter.packets);
+	peer.clear();
+	peer.question("other.local", MDNS_TYPE_A);
+	peer.question("SIM.local", MDNS_TYPE_A);
+	peer.deliver(lan.udp, true);
+	lan.loop();
+	CHECK_EQ(1, filter.packets);
+	CHECK_EQ(2, filter.questions);
+	// A listener taking all queries lets every one through.
+	Recorder queries(INTEREST_QUERIES);
+	lan.mdns.addListener(&queries);
+	peer.clear();
+	peer.question("other.local", MDNS_TYPE_A);
+	peer.deliver(lan.udp, true);
+	lan.loop();
+	CHECK_EQ(1, queries.packets);
+	CHECK_EQ(2, filter.packets);
+	lan.mdns.removeListener(&queries);
+	lan.mdns.removeListener(&filter);
+	lan.mdns.removeListener(&responses);
+}
+
+// An MDns with storage of its own, smaller than the defaults.
+static void testBasicMDns() {
+	LoopbackSegment segment;
+	LoopbackUDP udp(&segment, DEVICE_IP);
+	LoopbackUDP sniffer(&segment, PEER_IP);
+	BasicMDns<256, 4> mdns(udp, NULL);
+	CHECK_EQ(4, mdns.getCache().getCapacity());
+	Counter counter;
+	mdns.addListener(&counter);
+
+	Peer peer;
+	peer.question("box.local", MDNS_TYPE_A);
+	peer.deliver(udp, true);
+	CHECK(mdns.loop());
+	CHECK_EQ(1, counter.questions);
+
+	// Six answers: the cache keeps four of them.
+	peer.clear();
+	char name[16];
+	for (int i = 0; i < 6; i++) {
+		sprintf(name, "host%d.local", i);
+		peer.a(name, IPAddress(10, 0, 1, i), 100 + i);
+	}
+	peer.deliver(udp, false);
+	CHECK(mdns.loop());
+	CHECK_EQ(6, counter.records);
+	int cached = 0;
+	for (int i = 0; i < 6; i++) {
+		sprintf(name, "host%d.local", i);
+		const CacheEntry *entry = mdns.getCache().find(DnsName(name),
+				MDNS_TYPE_A, millis());
+		if (entry) {
+			CHECK(entry->getIPv4() == IPAddress(10, 0, 1, i));
+			cached++;
+		}
+	}
+	CHECK_EQ(4, cached);
+
+	// Only the records within the first 256 bytes of a longer packet are read.
+	peer.clear();
+	for (int i = 0; i < 20; i++) {
+		sprintf(name, "host%d.local", i);
+		peer.a(name, PEER_IP);
+	}
+	peer.deliver(udp, false);
+	counter.records = 0;
+	mdns.loop();
+	CHECK(counter.records > 0);
+	CHECK(counter.records < 20);
+
+	// Questions going out fill 256 bytes, no more.
+	mdns.Clear();
+	int questions = 0;
+	for (int i = 0; i < 40; i++) {
+		sprintf(name, "host%d.local", i);
+		const DnsName wire(name);
+		if (mdns.AddRawQuery(wire.getWire(), wire.getLength(), MDNS_TYPE_A, 1)) {
+			questions++;
+		}
+	}
+	CHECK(questions > 0);
+	CHECK(questions < 40);
+	mdns.Send();
+	byte sent[512];
+	const int size = sniffer.parsePacket();
+	CHECK(size > 256 - 12);
+	CHECK(size <= 256);
+	CHECK_EQ(size, sniffer.read(sent, sizeof(sent)));
+	RecordIterator records(sent, size);
+	QuestionView question;
+	int read = 0;
+	while (records.nextQuestion(question)) {
+		read++;
+	}
+	CHECK_EQ(questions, read);
+	CHECK(!records.malformed());
+	mdns.removeListener(&counter);
+}
+
+int main() {
+	RUN_TEST(testNameEquals);
+	RUN_TEST(testNameHash);
+	RUN_TEST(testMalformedNames);
+	RUN_TEST(testMalformedRecords);
+	RUN_TEST(testCompression);
+	RUN_TEST(testCallbackAlsoListener);
+	RUN_TEST(testInterest);
+	RUN_TEST(testAnswerTxt);
+	RUN_TEST(testAnswerAddress);
+	RUN_TEST(testCacheLongTxt);
+	RUN_TEST(testTxtMalformed);
+	RUN_TEST(testToAnswer);
+	RUN_TEST(testCacheExpiry);
+	RUN_TEST(testCacheGoodbye);
+	RUN_TEST(testCacheFlush);
+	RUN_TEST(testCacheEviction);
+	RUN_TEST(testBasicMDns);
+	RUN_TEST(testSubscribe);
+	RUN_TEST(testUnsubscribeInDispatch);
+	RUN_TEST(testInterestFilter);
+	return testResult();
+}
@@ -0,0 +1,597 @@
+/*
+ * responder_test.cpp
+ *
+ * MDNSResponder on a loopback LAN: which queries it answers, how, and when.
+ */
+
+#include <string>
+
+#include "test.h"
+#include "MDNSResponder.h"
+
+// A device which has claimed "sim.local" and the "Box" instance of
+// _http._tcp.local, and gone quiet.
+class Device : public Lan {
+public:
+	MDNSResponder responder;
+	Peer peer;
+	int box;
+
+	Device() : responder(&mdns, NULL) {
+		responder.setHostname("sim.local", DEVICE_IP);
+		box = responder.addService("Box", "_http._tcp.local", 80);
+		responder.addServiceText(box, "path=/");
+		run(3000);
+		reset();
+		responder.resetStatistics();
+	}
+
+	void query(const char *name, unsigned int qtype, unsigned int qclass = 1) {
+		peer.clear();
+		peer.question(name, qtype, qclass);
+		peer.deliver(udp, true);
+	}
+};
+
+static void testAnswersHost() {
+	Device device;
+	CHECK(device.responder.isClaimed());
+	device.query("sim.local", MDNS_TYPE_A);
+	device.loop();
+	// Only we hold the A record, so it goes out at once.
+	CHECK_EQ(1, device.sent.size());
+	RecordView record;
+	CHECK_EQ(1, device.sent[0].answers(MDNS_TYPE_A, "sim.local", &record));
+	CHECK(record.getIPv4() == DEVICE_IP);
+	CHECK(record.rrset);
+	CHECK_EQ(MDNS_HOST_TTL, record.rrttl);
+
+	device.reset();
+	device.query("other.local", MDNS_TYPE_A);
+	device.run(200);
+	CHECK_EQ(0, device.sent.size());
+}
+
+static void testUnicastResponse() {
+	Device device;
+	device.query("sim.local", MDNS_TYPE_A, 0x8001);
+	device.loop();
+	CHECK_EQ(1, device.sent.size());
+	CHECK(device.udp.lastSentIP() == PEER_IP);
+	CHECK_EQ(MDNS_TARGET_PORT, device.udp.lastSentPort());
+}
+
+static void testServiceAdditionals() {
+	Device device;
+	const unsigned long asked = millis();
+	device.query("_http._tcp.local", MDNS_TYPE_PTR);
+	device.run(200);
+	CHECK_EQ(1, device.sent.size());
+	if (device.sent.size() != 1) {
+		return;
+	}
+	const Sent &reply = device.sent[0];
+	// A shared record waits 20-120 ms.
+	CHECK(reply.at - asked >= MDNS_RESPONSE_DELAY_MIN);
+	CHECK(reply.at - asked <= MDNS_RESPONSE_DELAY_MAX);
+	CHECK_EQ(1, reply.answers(MDNS_TYPE_PTR, "_http._tcp.local"));
+	CHECK_EQ(1, reply.count(SECTION_ADDITIONAL, MDNS_TYPE_SRV,
+			"Box._http._tcp.local"));
+	CHECK_EQ(1, reply.count(SECTION_ADDITIONAL, MDNS_TYPE_TXT,
+			"Box._http._tcp.local"));
+	CHECK_EQ(1, reply.count(SECTION_ADDITIONAL, MDNS_TYPE_A, "sim.local"));
+}
+
+static void testAggregation() {
+	Device device;
+	device.responder.addService("Cam", "_rtsp._tcp.local", 554);
+	device.run(3000);
+	device.reset();
+	device.query("_http._tcp.local", MDNS_TYPE_PTR);
+	device.run(5);
+	device.query("_rtsp._tcp.local", MDNS_TYPE_PTR);
+	device.run(300);
+	// Both answers share the first one's packet.
+	CHECK_EQ(1, device.sent.size());
+	if (device.sent.size() == 1) {
+		CHECK_EQ(1, device.sent[0].answers(MDNS_TYPE_PTR, "_http._tcp.local"));
+		CHECK_EQ(1, device.sent[0].answers(MDNS_TYPE_PTR, "_rtsp._tcp.local"));
+	}
+}
+
+static void testKnownAnswerSuppression() {
+	Device device;
+	device.peer.clear();
+	device.peer.question("_http._tcp.local", MDNS_TYPE_PTR);
+	device.peer.ptr("_http._tcp.local", "Box._http._tcp.local");
+	device.peer.deliver(device.udp, true);
+	device.run(200);
+	CHECK_EQ(0, device.sent.size());
+	CHECK_EQ(1, device.responder.getStatistics().known_answers);
+
+	// Less than half the TTL left: it's due for a refresh.
+	device.peer.clear();
+	device.peer.question("_http._tcp.local", MDNS_TYPE_PTR);
+	device.peer.ptr("_http._tcp.local", "Box._http._tcp.local",
+			MDNS_SERVICE_TTL / 2 - 1);
+	device.peer.deliver(device.udp, true);
+	device.run(200);
+	CHECK_EQ(1, device.sent.size());
+}
+
+// A query too big for one packet: Known Answers follow in packets of their
+// own, with no questions.
+static void testTruncatedQuery() {
+	Device device;
+	device.peer.clear();
+	device.peer.question("_http._tcp.local", MDNS_TYPE_PTR);
+	device.peer.deliver(device.udp, true, true);
+	device.run(10);
+	device.peer.clear();
+	device.peer.ptr("_http._tcp.local", "Box._http._tcp.local");
+	device.peer.deliver(device.udp, true);
+	device.run(600);
+	CHECK_EQ(0, device.sent.size());
+	CHECK_EQ(1, device.responder.getStatistics().known_answers);
+
+	// Known Answers from another host don't count, and the answer waits
+	// 400-500 ms for more of them.
+	device.responder.resetStatistics();
+	const unsigned long asked = millis();
+	device.peer.clear();
+	device.peer.question("_http._tcp.local", MDNS_TYPE_PTR);
+	device.peer.deliver(device.udp, true, true);
+	device.run(10);
+	device.peer.clear();
+	device.peer.ptr("_http._tcp.local", "Box._http._tcp.local");
+	device.peer.deliver(device.udp, true, false, 5353, 0, IPAddress(10, 0, 0, 7));
+	device.run(600);
+	CHECK_EQ(1, device.sent.size());
+	CHECK_EQ(0, device.responder.getStatistics().known_answers);
+	if (device.sent.size() == 1) {
+		CHECK(device.sent[0].at - asked >= MDNS_TRUNCATED_DELAY_MIN);
+		CHECK(device.sent[0].at - asked <= MDNS_TRUNCATED_DELAY_MAX);
+		CHECK_EQ(1, device.sent[0].answers(MDNS_TYPE_PTR, "_http._tcp.local"));
+	}
+}
+
+// A query for a record only we hold doesn't bring the shared answers to an
+// earlier query forward.
+static void testUniqueAnswerAlone() {
+	Device device;
+	const unsigned long asked = millis();
+	device.query("_http._tcp.local", MDNS_TYPE_PTR);
+	device.run(1);
+	device.query("sim.local", MDNS_TYPE_A);
+	device.loop();
+	CHECK_EQ(1, device.sent.size());
+	if (device.sent.size() == 1) {
+		CHECK_EQ(1, device.sent[0].answers(MDNS_TYPE_A, "sim.local"));
+		CHECK_EQ(0, device.sent[0].answers(MDNS_TYPE_PTR, "_http._tcp.local"));
+	}
+	device.run(200);
+	CHECK_EQ(2, device.sent.size());
+	if (device.sent.size() == 2) {
+		CHECK(device.sent[1].at - asked >= MDNS_RESPONSE_DELAY_MIN);
+		CHECK_EQ(1, device.sent[1].answers(MDNS_TYPE_PTR, "_http._tcp.local"));
+	}
+
+	// Nor those held for the Known Answers of a truncated query.
+	device.run(MDNS_MULTICAST_INTERVAL);
+	device.reset();
+	device.peer.clear();
+	device.peer.question("_http._tcp.local", MDNS_TYPE_PTR);
+	device.peer.deliver(device.udp, true, true);
+	device.run(1);
+	device.query("sim.local", MDNS_TYPE_A);
+	device.run(200);
+	CHECK_EQ(1, device.sent.size());
+	if (device.sent.size() == 1) {
+		CHECK_EQ(0, device.sent[0].answers(MDNS_TYPE_PTR, "_http._tcp.local"));
+	}
+	device.peer.clear();
+	device.peer.ptr("_http._tcp.local", "Box._http._tcp.local");
+	device.peer.deliver(device.udp, true);
+	device.run(600);
+	CHECK_EQ(1, device.sent.size());
+	CHECK_EQ(1, device.responder.getStatistics().known_answers);
+}
+
+static void testDuplicateSuppression() {
+	Device device;
+	device.query("_http._tcp.local", MDNS_TYPE_PTR);
+	device.loop();
+	// Another host answers first, during our delay.
+	device.peer.clear();
+	device.peer.ptr("_http._tcp.local", "Box._http._tcp.local");
+	device.peer.deliver(device.udp, false);
+	device.run(200);
+	CHECK_EQ(0, device.sent.size());
+	CHECK_EQ(1, device.responder.getStatistics().duplicates);
+}
+
+static void testRateLimit() {
+	Device device;
+	device.query("sim.local", MDNS_TYPE_A);
+	device.loop();
+	CHECK_EQ(1, device.sent.size());
+	device.run(500);
+	device.query("sim.local", MDNS_TYPE_A);
+	device.loop();
+	// Multicast less than a second ago.
+	CHECK_EQ(1, device.sent.size());
+	CHECK_EQ(1, device.responder.getStatistics().rate_limited);
+	device.run(MDNS_MULTICAST_INTERVAL - 500);
+	device.query("sim.local", MDNS_TYPE_A);
+	device.loop();
+	CHECK_EQ(2, device.sent.size());
+}
+
+static void testLegacyUnicast() {
+	Device device;
+	device.peer.clear();
+	device.peer.question("sim.local", MDNS_TYPE_A);
+	device.peer.deliver(device.udp, true, false, 40000, 0x1234);
+	device.loop();
+	CHECK_EQ(1, device.sent.size());
+	CHECK(device.udp.lastSentIP() == PEER_IP);
+	CHECK_EQ(40000, device.udp.lastSentPort());
+	if (device.sent.size() != 1) {
+		return;
+	}
+	const Sent &reply = device.sent[0];
+	CHECK_EQ(0x12, reply.data[0]);
+	CHECK_EQ(0x34, reply.data[1]);
+	CHECK_EQ(1, reply.questions("sim.local"));
+	RecordView record;
+	CHECK_EQ(1, reply.answers(MDNS_TYPE_A, "sim.local", &record));
+	CHECK(!record.rrset);
+	CHECK(record.rrttl <= MDNS_LEGACY_TTL);
+}
+
+static void testRemoveSendsGoodbye() {
+	Device device;
+	device.responder.removeService(device.box);
+	device.loop();
+	CHECK_EQ(1, device.sent.size());
+	if (device.sent.size() != 1) {
+		return;
+	}
+	const Sent &goodbye = device.sent[0];
+	RecordView record;
+	CHECK_EQ(1, goodbye.answers(MDNS_TYPE_PTR, "_http._tcp.local", &record));
+	CHECK_EQ(0, record.rrttl);
+	CHECK_EQ(1, goodbye.answers(MDNS_TYPE_SRV, "Box._http._tcp.local", &record));
+	CHECK_EQ(0, record.rrttl);
+	CHECK_EQ(1, goodbye.answers(MDNS_TYPE_TXT, "Box._http._tcp.local", &record));
+	CHECK_EQ(0, record.rrttl);
+	// No instance of the type is left, so the type goes too.
+	CHECK_EQ(1, goodbye.answers(MDNS_TYPE_PTR,
+			"_services._dns-sd._udp.local", &record));
+	CHECK_EQ(0, record.rrttl);
+
+	// Nothing answers for it any more.
+	device.reset();
+	device.query("Box._http._tcp.local", MDNS_TYPE_SRV);
+	device.run(200);
+	CHECK_EQ(0, device.sent.size());
+}
+
+static void testRemoveWhileScheduled() {
+	Device device;
+	const int other = device.responder.addService("Other", "_http._tcp.local",
+			1883);
+	device.run(3000);
+	device.reset();
+	// Both instances answer, after the delay of shared records.
+	device.query("_http._tcp.local", MDNS_TYPE_PTR);
+	device.loop();
+	device.responder.removeService(device.box);
+	device.run(200);
+	CHECK_EQ(2, device.sent.size());
+	if (device.sent.size() != 2) {
+		return;
+	}
+	// The goodbye of Box, which leaves the type listed for Other.
+	RecordView record;
+	CHECK_EQ(1, device.sent[0].answers(MDNS_TYPE_SRV, "Box._http._tcp.local",
+			&record));
+	CHECK_EQ(0, record.rrttl);
+	CHECK_EQ(0, device.sent[0].answers(MDNS_TYPE_PTR,
+			"_services._dns-sd._udp.local"));
+	// Then the answer, for Other alone and with its own port.
+	const Sent &reply = device.sent[1];
+	CHECK_EQ(1, reply.answers(MDNS_TYPE_PTR, "_http._tcp.local", &record));
+	CHECK(record.rrttl > 0);
+	CHECK(dnsNameEquals(&reply.data[0], reply.data.size(), record.rdata_offset,
+			"Other._http._tcp.local"));
+	CHECK_EQ(0, reply.count(SECTION_ADDITIONAL, MDNS_TYPE_SRV,
+			"Box._http._tcp.local"));
+	CHECK_EQ(1, reply.count(SECTION_ADDITIONAL, MDNS_TYPE_SRV,
+			"Other._http._tcp.local", &record));
+	CHECK_EQ(1883, record.getSrvPort());
+	for (size_t i = 0; i < device.sent.size(); i++) {
+		CHECK_EQ(0, device.sent[i].count(SECTION_ADDITIONAL, MDNS_TYPE_SRV,
+				"Box._http._tcp.local"));
+	}
+	CHECK(other >= 0);
+}
+
+// A hostname as long as a name can be, so "-2" won't fit on it.
+static void testRenameFails() {
+	Lan lan;
+	MDNSResponder responder(&lan.mdns, NULL);
+	const std::string label(63, 'x');
+	const std::string name = std::string(55, 'h') + "." + label + "." + label
+			+ "." + label + ".local";
+	CHECK(responder.setHostname(name.c_str(), DEVICE_IP));
+	lan.run(3000);
+	CHECK(responder.isClaimed());
+	Peer peer;
+	peer.a(name.c_str(), PEER_IP);
+	peer.deliver(lan.udp, false);
+	// Probed for again, and answered: it is in use.
+	lan.reset();
+	for (int i = 0; i < MDNS_PROBE_INTERVAL and lan.sent.empty(); i++) {
+		lan.run(1);
+	}
+	CHECK_EQ(1, lan.sent.size());
+	peer.deliver(lan.udp, false);
+	lan.reset();
+	lan.run(3000);
+	// Given up on: no probes, and no answers under the old name.
+	CHECK(!responder.isClaimed());
+	CHECK_EQ(0, lan.sent.size());
+	char buffer[MAX_MDNS_NAME_LEN];
+	CHECK(responder.getHostname(buffer, sizeof(buffer)));
+	CHECK(name == buffer);
+	peer.clear();
+	peer.question(name.c_str(), MDNS_TYPE_A);
+	peer.deliver(lan.udp, true);
+	lan.run(200);
+	CHECK_EQ(0, lan.sent.size());
+
+	// Until a name is set again.
+	CHECK(responder.setHostname("sim.local", DEVICE_IP));
+	lan.run(3000);
+	CHECK(responder.isClaimed());
+}
+
+static const IPAddress MULTICAST_IP(224, 0, 0, 251);
+
+// A device setting its hostname, while it probes for it.
+class Claiming : public Lan {
+public:
+	MDNSResponder responder;
+	Peer peer;
+	unsigned long started;
+
+	Claiming() : responder(&mdns, NULL), started(millis()) {
+		responder.setHostname("sim.local", DEVICE_IP);
+	}
+
+	// Run until count packets have been sent, for at most ms.
+	void runUntilSent(size_t count, unsigned long ms) {
+		for (unsigned long i = 0; i < ms and sent.size() < count; i++) {
+			run(1);
+		}
+	}
+
+	// Another host probing for "sim.local" with its own address.
+	void probeFrom(IPAddress address) {
+		peer.clear();
+		peer.question("sim.local", 255);
+		peer.a("sim.local", address, 120, SECTION_AUTHORITY);
+		peer.deliver(udp, true);
+	}
+};
+
+// Three probes 250 ms apart, the first asking for a unicast reply, then two
+// announcements a second apart (RFC 6762 sections 8.1 and 8.3).
+static void testProbing() {
+	Claiming device;
+	device.run(3000);
+	CHECK(device.responder.isClaimed());
+	CHECK_EQ(MDNS_PROBE_COUNT + MDNS_ANNOUNCE_COUNT, device.sent.size());
+	if (device.sent.size() != MDNS_PROBE_COUNT + MDNS_ANNOUNCE_COUNT) {
+		return;
+	}
+	CHECK(device.sent[0].at - device.started <= MDNS_PROBE_INTERVAL);
+	for (int i = 0; i < MDNS_PROBE_COUNT; i++) {
+		const Sent &probe = device.sent[i];
+		CHECK(probe.isQuery());
+		unsigned int qclass = 0;
+		CHECK_EQ(1, probe.questions("sim.local", &qclass));
+		CHECK_EQ(i == 0 ? 0x8001 : 1, qclass);
+		RecordView record;
+		CHECK_EQ(1, probe.count(SECTION_AUTHORITY, MDNS_TYPE_A, "sim.local",
+				&record));
+		CHECK(record.getIPv4() == DEVICE_IP);
+		if (i > 0) {
+			CHECK_EQ(MDNS_PROBE_INTERVAL, probe.at - device.sent[i - 1].at);
+		}
+	}
+	for (int i = MDNS_PROBE_COUNT; i < MDNS_PROBE_COUNT + MDNS_ANNOUNCE_COUNT;
+			i++) {
+		const Sent &announcement = device.sent[i];
+		CHECK(!announcement.isQuery());
+		RecordView record;
+		CHECK_EQ(1, announcement.answers(MDNS_TYPE_A, "sim.local", &record));
+		CHECK(record.rrset);
+		CHECK_EQ(i == MDNS_PROBE_COUNT ?
+				MDNS_PROBE_INTERVAL : MDNS_ANNOUNCE_INTERVAL,
+				announcement.at - device.sent[i - 1].at);
+	}
+}
+
+// Both probe at once and our address comes first, so we lose: wait a
+// second, then probe for the same name again (section 8.2).
+static void testTiebreakLost() {
+	Claiming device;
+	device.runUntilSent(1, MDNS_PROBE_INTERVAL + 1);
+	const unsigned long lost = millis();
+	device.probeFrom(PEER_IP);
+	device.reset();
+	device.runUntilSent(1, 3000);
+	CHECK_EQ(1, device.sent.size());
+	if (device.sent.size() == 1) {
+		CHECK(device.sent[0].at - lost >= MDNS_PROBE_DEFER);
+		unsigned int qclass = 0;
+		CHECK_EQ(1, device.sent[0].questions("sim.local", &qclass));
+		CHECK_EQ(0x8001, qclass);
+	}
+	device.run(3000);
+	CHECK(device.responder.isClaimed());
+	char name[32];
+	CHECK(device.responder.getHostname(name, sizeof(name)));
+	CHECK(strcmp(name, "sim.local") == 0);
+}
+
+// Our address comes last: carry on probing as if nothing happened.
+static void testTiebreakWon() {
+	Claiming device;
+	device.runUntilSent(1, MDNS_PROBE_INTERVAL + 1);
+	const unsigned long first = device.sent[0].at;
+	device.probeFrom(IPAddress(10, 0, 0, 1));
+	device.runUntilSent(2, 3000);
+	CHECK_EQ(2, device.sent.size());
+	if (device.sent.size() == 2) {
+		CHECK_EQ(MDNS_PROBE_INTERVAL, device.sent[1].at - first);
+	}
+	device.run(MDNS_PROBE_INTERVAL * MDNS_PROBE_COUNT);
+	CHECK(device.responder.isClaimed());
+}
+
+// Another host answers for the name while we probe: it's theirs, so probe
+// for "sim-2.local" instead (section 9).
+static void testConflictRename() {
+	Claiming device;
+	device.runUntilSent(1, MDNS_PROBE_INTERVAL + 1);
+	device.peer.clear();
+	device.peer.a("sim.local", PEER_IP);
+	device.peer.deliver(device.udp, false);
+	device.reset();
+	device.run(3000);
+	CHECK(device.responder.isClaimed());
+	char name[32];
+	CHECK(device.responder.getHostname(name, sizeof(name)));
+	CHECK(strcmp(name, "sim-2.local") == 0);
+	CHECK(device.sent.size() > 0);
+	for (size_t i = 0; i < device.sent.size(); i++) {
+		CHECK_EQ(0, device.sent[i].count(SECTION_AUTHORITY, 0, "sim.local"));
+		CHECK_EQ(0, device.sent[i].answers(0, "sim.local"));
+	}
+	CHECK_EQ(MDNS_PROBE_COUNT, device.sent[0].isQuery()
+			+ device.sent[1].isQuery() + device.sent[2].isQuery());
+	CHECK_EQ(1, device.sent[0].questions("sim-2.local"));
+}
+
+// Another host answers for the name once we hold it: probe for it again
+// straight away, and keep it as no one answers, the answer having been
+// stale (section 9).
+static void testConflictReprobe() {
+	Claiming device;
+	device.run(3000);
+	device.reset();
+	const unsigned long challenged = millis();
+	device.peer.clear();
+	device.peer.a("sim.local", PEER_IP);
+	device.peer.deliver(device.udp, false);
+	device.loop();
+	CHECK(!device.responder.isClaimed());
+	device.run(3000);
+	CHECK(device.responder.isClaimed());
+	char name[32];
+	CHECK(device.responder.getHostname(name, sizeof(name)));
+	CHECK(strcmp(name, "sim.local") == 0);
+	CHECK_EQ(MDNS_PROBE_COUNT + MDNS_ANNOUNCE_COUNT, device.sent.size());
+	if (device.sent.size() != MDNS_PROBE_COUNT + MDNS_ANNOUNCE_COUNT) {
+		return;
+	}
+	CHECK(device.sent[0].at - challenged <= MDNS_PROBE_INTERVAL);
+	for (int i = 0; i < MDNS_PROBE_COUNT; i++) {
+		CHECK(device.sent[i].isQuery());
+		CHECK_EQ(1, device.sent[i].questions("sim.local"));
+	}
+	RecordView record;
+	CHECK_EQ(1, device.sent[MDNS_PROBE_COUNT].answers(MDNS_TYPE_A,
+			"sim.local", &record));
+	CHECK(record.getIPv4() == DEVICE_IP);
+}
+
+// The other host answers our probe again: the name is theirs, so take
+// "sim-2.local".
+static void testConflictConfirmed() {
+	Claiming device;
+	device.run(3000);
+	device.peer.clear();
+	device.peer.a("sim.local", PEER_IP);
+	device.peer.deliver(device.udp, false);
+	device.reset();
+	device.runUntilSent(1, MDNS_PROBE_INTERVAL + 1);
+	CHECK_EQ(1, device.sent.size());
+	if (device.sent.size() == 1) {
+		CHECK_EQ(1, device.sent[0].questions("sim.local"));
+	}
+	device.peer.deliver(device.udp, false);
+	device.reset();
+	device.run(3000);
+	CHECK(device.responder.isClaimed());
+	char name[32];
+	CHECK(device.responder.getHostname(name, sizeof(name)));
+	CHECK(strcmp(name, "sim-2.local") == 0);
+	CHECK(device.sent.size() > 0);
+	if (device.sent.size() > 0) {
+		CHECK_EQ(1, device.sent[0].questions("sim-2.local"));
+	}
+}
+
+// A probe for a name we have claimed is answered at once, by multicast and
+// at most every 250 ms rather than every second.
+static void testDefence() {
+	Claiming device;
+	device.run(3000);
+	device.reset();
+	device.probeFrom(PEER_IP);
+	device.loop();
+	CHECK_EQ(1, device.sent.size());
+	CHECK(device.udp.lastSentIP() == MULTICAST_IP);
+	device.run(MDNS_DEFENSE_INTERVAL);
+	device.probeFrom(PEER_IP);
+	device.loop();
+	CHECK_EQ(2, device.sent.size());
+	for (size_t i = 0; i < device.sent.size(); i++) {
+		RecordView record;
+		CHECK_EQ(1, device.sent[i].answers(MDNS_TYPE_A, "sim.local", &record));
+		CHECK(record.getIPv4() == DEVICE_IP);
+	}
+	CHECK(device.responder.isClaimed());
+	char name[32];
+	CHECK(device.responder.getHostname(name, sizeof(name)));
+	CHECK(strcmp(name, "sim.local") == 0);
+}
+
+int main() {
+	randomSeed(1);
+	RUN_TEST(testAnswersHost);
+	RUN_TEST(testUnicastResponse);
+	RUN_TEST(testServiceAdditionals);
+	RUN_TEST(testAggregation);
+	RUN_TEST(testKnownAnswerSuppression);
+	RUN_TEST(testTruncatedQuery);
+	RUN_TEST(testUniqueAnswerAlone);
+	RUN_TEST(testDuplicateSuppression);
+	RUN_TEST(testRateLimit);
+	RUN_TEST(testLegacyUnicast);
+	RUN_TEST(testRemoveSendsGoodbye);
+	RUN_TEST(testRemoveWhileScheduled);
+	RUN_TEST(testProbing);
+	RUN_TEST(testTiebreakLost);
+	RUN_TEST(testTiebreakWon);
+	RUN_TEST(testConflictRename);
+	RUN_TEST(testConflictReprobe);
+	RUN_TEST(testConflictConfirmed);
+	RUN_TEST(testDefence);
+	RUN_TEST(testRenameFails);
+	return testResult();
+}
@@ -0,0 +1,264 @@
+/*
+ * test.h
+ *
+ * Minimal test support for the host build: CHECK() assertions, and a
+ * device on a loopback LAN whose traffic can be injected and captured.
+ *
+ * Each test program runs its tests from main() with RUN_TEST() and returns
+ * testResult(), so ctest sees a failure as a non-zero exit status.
+ */
+
+#ifndef HOST_TESTS_TEST_H_
+#define HOST_TESTS_TEST_H_
+
+#include <stdio.h>
+#include <string.h>
+#include <vector>
+
+#include "mdns.h"
+#include "LoopbackUDP.h"
+
+using namespace mdns;
+
+static int test_failures = 0;
+
+#define CHECK(condition) do { \
+		if (!(condition)) { \
+			printf("%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, \
+					#condition); \
+			test_failures++; \
+		} \
+	} while (0)
+
+#define CHECK_EQ(expected, actual) do { \
+		const long long e_ = (long long) (expected); \
+		const long long a_ = (long long) (actual); \
+		if (e_ != a_) { \
+			printf("%s:%d: CHECK_EQ(%s, %s) failed: %lld != %lld\n", \
+					__FILE__, __LINE__, #expected, #actual, e_, a_); \
+			test_failures++; \
+		} \
+	} while (0)
+
+#define RUN_TEST(test) do { \
+		printf("%s\n", #test); \
+		test(); \
+	} while (0)
+
+static inline int testResult() {
+	printf(test_failures ? "%d check(s) failed\n" : "all passed\n",
+			test_failures);
+	return test_failures ? 1 : 0;
+}
+
+// The address of the device under test, and of the other host on the LAN.
+static const IPAddress DEVICE_IP(10, 0, 0, 5);
+static const IPAddress PEER_IP(10, 0, 0, 9);
+
+// A packet sent by the device, and millis() when it went.
+struct Sent {
+	unsigned long at;
+	std::vector<uint8_t> data;
+
+	bool isQuery() const {
+		return !(data[2] & 0x80);
+	}
+
+	// Number of records of the given section, type and name; any type if
+	// rrtype is 0. Stores the last one found in found.
+	int count(Section section, unsigned int rrtype, const char *name,
+			RecordView *found = NULL) const {
+		RecordIterator records(&data[0], data.size());
+		RecordView record;
+		int n = 0;
+		while (records.nextRecord(record)) {
+			if (record.section == section
+					&& (rrtype == 0 || record.rrtype == rrtype)
+					&& dnsNameEquals(&data[0], data.size(), record.name_offset,
+							name)) {
+				n++;
+				if (found) {
+					*found = record;
+				}
+			}
+		}
+		return n;
+	}
+
+	int answers(unsigned int rrtype, const char *name,
+			RecordView *found = NULL) const {
+		return count(SECTION_ANSWER, rrtype, name, found);
+	}
+
+	// Number of questions for name, and the class of the last one with its
+	// unicast-response bit.
+	int questions(const char *name, unsigned int *qclass = NULL) const {
+		RecordIterator records(&data[0], data.size());
+		QuestionView question;
+		int n = 0;
+		while (records.nextQuestion(question)) {
+			if (dnsNameEquals(&data[0], data.size(), question.name_offset,
+					name)) {
+				n++;
+				if (qclass) {
+					*qclass = question.qclass
+							| (question.unicast_response ? 0x8000 : 0);
+				}
+			}
+		}
+		return n;
+	}
+
+	// Number of questions of the given type for name, any type if qtype
+	// is 0.
+	int asks(unsigned int qtype, const char *name) const {
+		RecordIterator records(&data[0], data.size());
+		QuestionView question;
+		int n = 0;
+		while (records.nextQuestion(question)) {
+			if ((qtype == 0 || question.qtype == qtype)
+					&& dnsNameEquals(&data[0], data.size(), question.name_offset,
+							name)) {
+				n++;
+			}
+		}
+		return n;
+	}
+
+	bool isTruncated() const {
+		return data[2] & 0x02;
+	}
+};
+
+// Packets from another host, built with an MDns of their own.
+class Peer {
+public:
+	Peer() : mdns(udp, NULL, MAX_PACKET_SIZE, NULL) {
+		mdns.Clear();
+	}
+
+	void clear() {
+		mdns.Clear();
+	}
+
+	void question(const char *name, unsigned int qtype,
+			unsigned int qclass = 1) {
+		const DnsName wire(name);
+		mdns.AddRawQuery(wire.getWire(), wire.getLength(), qtype, qclass);
+	}
+
+	// A record in the Answer section, or the Authority section of a probe.
+	// The header flags are set by deliver().
+	void record(const char *name, unsigned int rrtype, unsigned long rrttl,
+			const byte *rdata, unsigned int rdlength,
+			unsigned int rdata_name_offset, unsigned int rrclass = 1,
+			Section section = SECTION_ANSWER) {
+		const DnsName wire(name);
+		if (section == SECTION_AUTHORITY) {
+			mdns.AddRawAuthority(wire.getWire(), wire.getLength(), rrtype,
+					rrclass, rrttl, rdata, rdlength, rdata_name_offset);
+		} else {
+			mdns.AddRawAnswer(wire.getWire(), wire.getLength(), rrtype,
+					rrclass, rrttl, rdata, rdlength, rdata_name_offset);
+		}
+	}
+
+	void a(const char *name, IPAddress address, unsigned long rrttl = 120,
+			Section section = SECTION_ANSWER) {
+		const byte rdata[4] = { address[0], address[1], address[2], address[3] };
+		record(name, MDNS_TYPE_A, rrttl, rdata, 4, 4, 0x8001, section);
+	}
+
+	void aaaa(const char *name, const uint8_t address[16],
+			unsigned long rrttl = 120) {
+		record(name, MDNS_TYPE_AAAA, rrttl, address, 16, 16, 0x8001);
+	}
+
+	void ptr(const char *name, const char *target, unsigned long rrttl = 4500) {
+		const DnsName wire(target);
+		record(name, MDNS_TYPE_PTR, rrttl, wire.getWire(), wire.getLength(), 0);
+	}
+
+	void srv(const char *name, const char *target, uint16_t port,
+			unsigned long rrttl = 120) {
+		const DnsName wire(target);
+		byte rdata[6 + MAX_MDNS_NAME_LEN] = { 0, 0, 0, 0,
+				(byte) (port >> 8), (byte) port };
+		memcpy(rdata + 6, wire.getWire(), wire.getLength());
+		record(name, MDNS_TYPE_SRV, rrttl, rdata, 6 + wire.getLength(), 6,
+				0x8001);
+	}
+
+	// Send what was built to the device as a query, optionally truncated, or
+	// as a response, from the peer's address and port.
+	void deliver(LoopbackUDP &to, bool query, bool truncated = false,
+			uint16_t port = 5353, uint16_t id = 0, IPAddress from = PEER_IP) {
+		mdns.setQueryId(id);
+		mdns.Send();
+		std::vector<uint8_t> packet = udp.lastSent();
+		packet[2] = query ? (truncated ? 0x02 : 0x00) : 0x84;
+		to.inject(&packet[0], packet.size(), from, port);
+	}
+
+private:
+	LoopbackUDP udp;
+	MDns mdns;
+};
+
+// The device: an MDns on a LoopbackSegment, with a second endpoint capturing
+// everything it sends.
+class Lan {
+public:
+	LoopbackSegment segment;
+	LoopbackUDP udp;
+	LoopbackUDP sniffer;
+	MDns mdns;
+	std::vector<Sent> sent;
+
+	Lan() : udp(&segment, DEVICE_IP), sniffer(&segment, PEER_IP),
+			mdns(udp, NULL, MAX_PACKET_SIZE, NULL) {
+		hostClockSetManual(true);
+	}
+
+	virtual ~Lan() {
+	}
+
+	// Let ms milliseconds pass, calling step() every millisecond.
+	void run(unsigned long ms) {
+		for (unsigned long i = 0; i < ms; i++) {
+			hostClockAdvance(1);
+			step();
+			capture();
+		}
+	}
+
+	// Handle what was injected, without letting time pass.
+	void loop() {
+		step();
+		capture();
+	}
+
+	// Forget the packets captured so far.
+	void reset() {
+		sent.clear();
+	}
+
+protected:
+	// What the device does every millisecond.
+	virtual void step() {
+		mdns.loop();
+	}
+
+	void capture() {
+		uint8_t buffer[WIFI_UDP_BUFFER_SIZE];
+		while (sniffer.parsePacket() > 0) {
+			Sent packet;
+			packet.at = millis();
+			const int size = sniffer.read(buffer, sizeof(buffer));
+			packet.data.assign(buffer, buffer + size);
+			sent.push_back(packet);
+		}
+	}
+};
+
+#endif /* HOST_TESTS_TEST_H_ */
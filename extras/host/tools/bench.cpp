@@ -0,0 +1,420 @@
+/*
+ * bench.cpp
+ *
+ * Host benchmark for the packet parser, run over the packets in captures.h.
+ *
+ *   mdns_bench [iterations]
+ *
+ * names:   expands every name in each packet with decodeDnsName() and with the
+ *          recursive decoder it replaced, and checks both agree.
+ * records: decodes every record in each packet with RecordView::toAnswer()
+ *          and with the text formatting it replaced.
+ * txt:     looks a key up in every TXT record with TxtIterator::find(), and
+ *          by copying the rdata out with parseText() and scanning it.
+ * dispatch: replays each packet through MDns::loop() to a listener which
+ *          decodes every record, and to one subscribed to the PTR records of
+ *          _mqtt._tcp.local only.
+ * reject:  replays each packet to a listener which wants every packet, and
+ *          to one which wants responses only, so queries are dropped on
+ *          their header.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "mdns.h"
+#include "LoopbackUDP.h"
+#include "captures.h"
+
+using namespace mdns;
+
+// The recursive nameFromDnsPointer() which decodeDnsName() replaced, kept as
+// the baseline. Only safe on well formed packets.
+static int legacyNameFromDnsPointer(char *p_name_buffer, int name_buffer_pos,
+		const int name_buffer_len, const byte *p_packet_buffer,
+		int packet_buffer_pos, const bool recurse) {
+	if (recurse) {
+		name_buffer_pos--;
+		writeToBuffer('.', p_name_buffer, &name_buffer_pos, name_buffer_len);
+	}
+
+	if (p_packet_buffer[packet_buffer_pos] < 0xC0) {
+		const int word_len = p_packet_buffer[packet_buffer_pos++];
+		for (int l = 0; l < word_len; l++) {
+			writeToBuffer(*(p_packet_buffer + packet_buffer_pos++),
+					p_name_buffer, &name_buffer_pos, name_buffer_len);
+		}
+
+		writeToBuffer('\0', p_name_buffer, &name_buffer_pos, name_buffer_len);
+
+		if (p_packet_buffer[packet_buffer_pos] > 0) {
+			packet_buffer_pos = legacyNameFromDnsPointer(p_name_buffer,
+					name_buffer_pos, name_buffer_len, p_packet_buffer,
+					packet_buffer_pos, true);
+		} else {
+			packet_buffer_pos++;
+		}
+	} else {
+		int pointer = (p_packet_buffer[packet_buffer_pos++] - 0xC0) << 8;
+		pointer += p_packet_buffer[packet_buffer_pos++];
+		legacyNameFromDnsPointer(p_name_buffer, name_buffer_pos,
+				name_buffer_len, p_packet_buffer, pointer, false);
+	}
+	return packet_buffer_pos;
+}
+
+// The toAnswer() which formatted the rdata as text, kept as the baseline.
+static void legacyToAnswer(const RecordView &record, Answer &answer) {
+	const byte *packet = record.packet;
+	answer.valid = decodeDnsName(answer.name_buffer, 0, MAX_MDNS_NAME_LEN,
+			packet, record.packet_size, record.name_offset) >= 0;
+	answer.rrtype = record.rrtype;
+	answer.rrclass = record.rrclass;
+	answer.rrttl = record.rrttl;
+	answer.rrset = record.rrset;
+	answer.rdata_buffer[0] = '\0';
+
+	unsigned int buffer_pointer = record.rdata_offset;
+	switch (record.rrtype) {
+	case MDNS_TYPE_A:
+		answer.ipAddress = record.getIPv4();
+		strcpy(answer.rdata_buffer, answer.ipAddress.get_address());
+		break;
+	case MDNS_TYPE_PTR:
+		decodeDnsName(answer.rdata_buffer, 0, MAX_MDNS_NAME_LEN, packet,
+				record.packet_size, buffer_pointer);
+		break;
+	case MDNS_TYPE_HINFO:
+	case MDNS_TYPE_TXT:
+		parseText(answer.rdata_buffer, MAX_MDNS_NAME_LEN, record.rdlength,
+				packet, buffer_pointer);
+		break;
+	case MDNS_TYPE_SRV:
+		if (record.rdlength >= 6) {
+			const unsigned int port = (packet[buffer_pointer + 4] << 8)
+					+ packet[buffer_pointer + 5];
+			sprintf(answer.rdata_buffer, "p=%d;w=%d;port=%d;host=",
+					(packet[buffer_pointer] << 8) + packet[buffer_pointer + 1],
+					(packet[buffer_pointer + 2] << 8) + packet[buffer_pointer + 3],
+					port);
+			answer.port = port;
+			decodeDnsName(answer.rdata_buffer, strlen(answer.rdata_buffer),
+					MAX_MDNS_NAME_LEN, packet, record.packet_size,
+					buffer_pointer + 6);
+		}
+		break;
+	default: {
+		// AAAA came out as "%02X:" per byte, other types as "%02X ".
+		int buffer_pos = 0;
+		for (unsigned int i = 0; i < record.rdlength; i++) {
+			if (buffer_pos < MAX_MDNS_NAME_LEN - 3) {
+				sprintf(answer.rdata_buffer + buffer_pos, "%02X ",
+						packet[buffer_pointer]);
+			}
+			buffer_pointer++;
+			buffer_pos += 3;
+		}
+	}
+		break;
+	}
+}
+
+#define MAX_NAMES 128
+
+// Offsets of every name in the packet: questions, record names and the names
+// inside PTR and SRV rdata.
+static unsigned int collectNames(const Capture &capture,
+		unsigned int *offsets) {
+	unsigned int count = 0;
+	RecordIterator records(capture.data, capture.size);
+	QuestionView question;
+	while (records.nextQuestion(question) && count < MAX_NAMES) {
+		offsets[count++] = question.name_offset;
+	}
+	RecordView record;
+	while (records.nextRecord(record) && count < MAX_NAMES - 1) {
+		offsets[count++] = record.name_offset;
+		if (record.rrtype == MDNS_TYPE_PTR) {
+			offsets[count++] = record.rdata_offset;
+		} else if (record.rrtype == MDNS_TYPE_SRV) {
+			offsets[count++] = record.rdata_offset + 6;
+		}
+	}
+	return count;
+}
+
+static bool benchNames(unsigned long iterations) {
+	bool ok = true;
+	char legacy[MAX_MDNS_NAME_LEN];
+	char iterative[MAX_MDNS_NAME_LEN];
+	unsigned int offsets[MAX_NAMES];
+	unsigned long sink = 0;
+
+	printf("names: %lu iterations\n", iterations);
+	printf("  %-22s %6s %14s %14s %8s\n", "capture", "names",
+			"recursive ns", "iterative ns", "ratio");
+
+	for (unsigned int c = 0; c < CAPTURE_COUNT; c++) {
+		const Capture &capture = captures[c];
+		const unsigned int count = collectNames(capture, offsets);
+
+		for (unsigned int n = 0; n < count; n++) {
+			legacyNameFromDnsPointer(legacy, 0, MAX_MDNS_NAME_LEN,
+					capture.data, offsets[n], false);
+			decodeDnsName(iterative, 0, MAX_MDNS_NAME_LEN, capture.data,
+					capture.size, offsets[n]);
+			if (strcmp(legacy, iterative) != 0) {
+				printf("  MISMATCH in %s at 0x%X: \"%s\" != \"%s\"\n",
+						capture.name, offsets[n], legacy, iterative);
+				ok = false;
+			}
+		}
+
+		unsigned long started = micros();
+		for (unsigned long i = 0; i < iterations; i++) {
+			for (unsigned int n = 0; n < count; n++) {
+				sink += legacyNameFromDnsPointer(legacy, 0, MAX_MDNS_NAME_LEN,
+						capture.data, offsets[n], false);
+			}
+		}
+		const double legacy_ns = (micros() - started) * 1000.0
+				/ (iterations * count);
+
+		started = micros();
+		for (unsigned long i = 0; i < iterations; i++) {
+			for (unsigned int n = 0; n < count; n++) {
+				sink += decodeDnsName(iterative, 0, MAX_MDNS_NAME_LEN,
+						capture.data, capture.size, offsets[n]);
+			}
+		}
+		const double iterative_ns = (micros() - started) * 1000.0
+				/ (iterations * count);
+
+		printf("  %-22s %6u %14.1f %14.1f %8.2f\n", capture.name, count,
+				legacy_ns, iterative_ns, legacy_ns / iterative_ns);
+	}
+	if (sink == 0) {
+		printf("  (nothing decoded)\n");
+	}
+	return ok;
+}
+
+static void benchRecords(unsigned long iterations) {
+	Answer answer;
+	unsigned long sink = 0;
+
+	printf("records: %lu iterations\n", iterations);
+	printf("  %-22s %6s %14s %14s %8s\n", "capture", "records",
+			"text ns", "typed ns", "ratio");
+
+	for (unsigned int c = 0; c < CAPTURE_COUNT; c++) {
+		const Capture &capture = captures[c];
+		unsigned int count = 0;
+		RecordIterator counter(capture.data, capture.size);
+		RecordView record;
+		while (counter.nextRecord(record)) {
+			count++;
+		}
+		if (count == 0) {
+			continue;
+		}
+
+		unsigned long started = micros();
+		for (unsigned long i = 0; i < iterations; i++) {
+			RecordIterator records(capture.data, capture.size);
+			while (records.nextRecord(record)) {
+				legacyToAnswer(record, answer);
+				sink += answer.rdata_buffer[0];
+			}
+		}
+		const double text_ns = (micros() - started) * 1000.0
+				/ (iterations * count);
+
+		started = micros();
+		for (unsigned long i = 0; i < iterations; i++) {
+			RecordIterator records(capture.data, capture.size);
+			while (records.nextRecord(record)) {
+				record.toAnswer(answer);
+				sink += answer.rdata_buffer[0];
+			}
+		}
+		const double typed_ns = (micros() - started) * 1000.0
+				/ (iterations * count);
+
+		printf("  %-22s %6u %14.1f %14.1f %8.2f\n", capture.name, count,
+				text_ns, typed_ns, text_ns / typed_ns);
+	}
+	if (sink == 0) {
+		printf("  (nothing decoded)\n");
+	}
+}
+
+// Key looked up by the txt section. Absent, so every string is looked at.
+#define TXT_KEY "fwversion"
+
+static void benchTxt(unsigned long iterations) {
+	Answer answer;
+	TxtEntry entry;
+	unsigned long sink = 0;
+
+	printf("txt: %lu iterations\n", iterations);
+	printf("  %-22s %6s %14s %14s %8s\n", "capture", "txt",
+			"scan ns", "find ns", "ratio");
+
+	for (unsigned int c = 0; c < CAPTURE_COUNT; c++) {
+		const Capture &capture = captures[c];
+		unsigned int count = 0;
+		RecordIterator counter(capture.data, capture.size);
+		RecordView record;
+		while (counter.nextRecord(record)) {
+			count += record.rrtype == MDNS_TYPE_TXT;
+		}
+		if (count == 0) {
+			continue;
+		}
+
+		unsigned long started = micros();
+		for (unsigned long i = 0; i < iterations; i++) {
+			RecordIterator records(capture.data, capture.size);
+			while (records.nextRecord(record)) {
+				if (record.rrtype != MDNS_TYPE_TXT) {
+					continue;
+				}
+				parseText(answer.rdata_buffer, MAX_MDNS_NAME_LEN, record.rdlength,
+						record.packet, record.rdata_offset);
+				sink += strstr(answer.rdata_buffer, TXT_KEY "=") == NULL;
+			}
+		}
+		const double scan_ns = (micros() - started) * 1000.0
+				/ (iterations * count);
+
+		started = micros();
+		for (unsigned long i = 0; i < iterations; i++) {
+			RecordIterator records(capture.data, capture.size);
+			while (records.nextRecord(record)) {
+				if (record.rrtype != MDNS_TYPE_TXT) {
+					continue;
+				}
+				sink += !record.getTxt().find(TXT_KEY, entry);
+			}
+		}
+		const double find_ns = (micros() - started) * 1000.0
+				/ (iterations * count);
+
+		printf("  %-22s %6u %14.1f %14.1f %8.2f\n", capture.name, count,
+				scan_ns, find_ns, scan_ns / find_ns);
+	}
+	if (sink == 0) {
+		printf("  (nothing looked up)\n");
+	}
+}
+
+// Listener counting what gets decoded for it.
+class CountingListener : public Callback {
+public:
+	unsigned long count = 0;
+	virtual void onQuery(const Query* query) {
+		count += query->valid;
+	}
+	virtual void onAnswer(const Answer* answer) {
+		count += answer->valid;
+	}
+};
+
+static void benchDispatch(unsigned long iterations) {
+	LoopbackUDP udp;
+	// Without a cache, only the dispatch to the listener is timed.
+	BasicMDns<MAX_PACKET_SIZE, 0> my_mdns(udp, NULL);
+	CountingListener everything;
+	CountingListener mqtt;
+	my_mdns.subscribe(&mqtt, MDNS_TYPE_PTR, "_mqtt._tcp.local");
+
+	printf("dispatch: %lu iterations\n", iterations);
+	printf("  %-22s %6s %14s %14s %8s\n", "capture", "calls",
+			"all ns", "subscribed ns", "ratio");
+
+	for (unsigned int c = 0; c < CAPTURE_COUNT; c++) {
+		const Capture &capture = captures[c];
+		my_mdns.addListener(&everything);
+		unsigned long started = micros();
+		for (unsigned long i = 0; i < iterations; i++) {
+			udp.inject(capture.data, capture.size);
+			my_mdns.loop();
+		}
+		const double all_ns = (micros() - started) * 1000.0 / iterations;
+		my_mdns.removeListener(&everything);
+
+		mqtt.count = 0;
+		started = micros();
+		for (unsigned long i = 0; i < iterations; i++) {
+			udp.inject(capture.data, capture.size);
+			my_mdns.loop();
+		}
+		const double subscribed_ns = (micros() - started) * 1000.0 / iterations;
+
+		printf("  %-22s %6lu %14.1f %14.1f %8.2f\n", capture.name,
+				mqtt.count / iterations, all_ns, subscribed_ns,
+				all_ns / subscribed_ns);
+	}
+	if (everything.count == 0) {
+		printf("  (nothing decoded)\n");
+	}
+}
+
+// Listener which only wants answers, like MDNSClient.
+class ResponseListener : public CountingListener {
+public:
+	virtual uint8_t getInterest() const {
+		return INTEREST_RESPONSES;
+	}
+};
+
+static void benchReject(unsigned long iterations) {
+	LoopbackUDP udp;
+	BasicMDns<MAX_PACKET_SIZE, 0> my_mdns(udp, NULL);
+	CountingListener everything;
+	ResponseListener responses;
+
+	printf("reject: %lu iterations\n", iterations);
+	printf("  %-22s %6s %14s %14s %8s\n", "capture", "query",
+			"all ns", "responses ns", "ratio");
+
+	for (unsigned int c = 0; c < CAPTURE_COUNT; c++) {
+		const Capture &capture = captures[c];
+		my_mdns.addListener(&everything);
+		unsigned long started = micros();
+		for (unsigned long i = 0; i < iterations; i++) {
+			udp.inject(capture.data, capture.size);
+			my_mdns.loop();
+		}
+		const double all_ns = (micros() - started) * 1000.0 / iterations;
+		my_mdns.removeListener(&everything);
+
+		my_mdns.addListener(&responses);
+		started = micros();
+		for (unsigned long i = 0; i < iterations; i++) {
+			udp.inject(capture.data, capture.size);
+			my_mdns.loop();
+		}
+		const double responses_ns = (micros() - started) * 1000.0 / iterations;
+		my_mdns.removeListener(&responses);
+
+		printf("  %-22s %6s %14.1f %14.1f %8.2f\n", capture.name,
+				(capture.data[2] & 0x80) ? "no" : "yes", all_ns, responses_ns,
+				all_ns / responses_ns);
+	}
+	if (everything.count == 0) {
+		printf("  (nothing decoded)\n");
+	}
+}
+
+int main(int argc, char **argv) {
+	const unsigned long iterations = argc > 1 ? atol(argv[1]) : 20000;
+	bool ok = benchNames(iterations);
+	benchRecords(iterations);
+	benchTxt(iterations);
+	benchDispatch(iterations);
+	benchReject(iterations);
+	return ok ? 0 : 1;
+}
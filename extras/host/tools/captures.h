@@ -0,0 +1,212 @@
+/*
+ * captures.h
+ *
+ * mDNS packets for the host benchmark and fuzzer, modelled on the traffic of
+ * a busy home LAN: a Chromecast and a network printer announcing themselves,
+ * an Apple device browsing with known answers, an Avahi MQTT broker and a
+ * hostname probe. Name compression is applied the way those responders do.
+ */
+
+#ifndef HOST_TOOLS_CAPTURES_H_
+#define HOST_TOOLS_CAPTURES_H_
+
+#include "Arduino.h"
+
+struct Capture {
+	const char *name;
+	const byte *data;
+	unsigned int size;
+};
+
+// googlecast_response: 362 bytes.
+static const byte capture_googlecast_response[] = {
+	0x00, 0x00, 0x84, 0x00, 0x00, 0x00, 0x00, 0x01, 0x00, 0x00, 0x00, 0x03,
+	0x0B, 0x5F, 0x67, 0x6F, 0x6F, 0x67, 0x6C, 0x65, 0x63, 0x61, 0x73, 0x74,
+	0x04, 0x5F, 0x74, 0x63, 0x70, 0x05, 0x6C, 0x6F, 0x63, 0x61, 0x6C, 0x00,
+	0x00, 0x0C, 0x00, 0x01, 0x00, 0x00, 0x00, 0x78, 0x00, 0x34, 0x31, 0x43,
+	0x68, 0x72, 0x6F, 0x6D, 0x65, 0x63, 0x61, 0x73, 0x74, 0x2D, 0x55, 0x6C,
+	0x74, 0x72, 0x61, 0x2D, 0x34, 0x66, 0x31, 0x63, 0x32, 0x61, 0x39, 0x62,
+	0x65, 0x30, 0x37, 0x64, 0x33, 0x61, 0x36, 0x63, 0x38, 0x31, 0x65, 0x35,
+	0x66, 0x30, 0x62, 0x32, 0x64, 0x39, 0x63, 0x37, 0x61, 0x34, 0x31, 0x33,
+	0xC0, 0x0C, 0xC0, 0x2E, 0x00, 0x10, 0x80, 0x01, 0x00, 0x00, 0x11, 0x94,
+	0x00, 0xB3, 0x23, 0x69, 0x64, 0x3D, 0x34, 0x66, 0x31, 0x63, 0x32, 0x61,
+	0x39, 0x62, 0x65, 0x30, 0x37, 0x64, 0x33, 0x61, 0x36, 0x63, 0x38, 0x31,
+	0x65, 0x35, 0x66, 0x30, 0x62, 0x32, 0x64, 0x39, 0x63, 0x37, 0x61, 0x34,
+	0x31, 0x33, 0x23, 0x63, 0x64, 0x3D, 0x38, 0x45, 0x31, 0x46, 0x36, 0x34,
+	0x42, 0x30, 0x32, 0x43, 0x37, 0x41, 0x39, 0x44, 0x33, 0x35, 0x45, 0x30,
+	0x46, 0x31, 0x42, 0x36, 0x43, 0x32, 0x41, 0x34, 0x44, 0x38, 0x45, 0x39,
+	0x37, 0x33, 0x03, 0x72, 0x6D, 0x3D, 0x05, 0x76, 0x65, 0x3D, 0x30, 0x35,
+	0x13, 0x6D, 0x64, 0x3D, 0x43, 0x68, 0x72, 0x6F, 0x6D, 0x65, 0x63, 0x61,
+	0x73, 0x74, 0x20, 0x55, 0x6C, 0x74, 0x72, 0x61, 0x12, 0x69, 0x63, 0x3D,
+	0x2F, 0x73, 0x65, 0x74, 0x75, 0x70, 0x2F, 0x69, 0x63, 0x6F, 0x6E, 0x2E,
+	0x70, 0x6E, 0x67, 0x11, 0x66, 0x6E, 0x3D, 0x4C, 0x69, 0x76, 0x69, 0x6E,
+	0x67, 0x20, 0x52, 0x6F, 0x6F, 0x6D, 0x20, 0x54, 0x56, 0x09, 0x63, 0x61,
+	0x3D, 0x32, 0x30, 0x31, 0x32, 0x32, 0x31, 0x04, 0x73, 0x74, 0x3D, 0x30,
+	0x0F, 0x62, 0x73, 0x3D, 0x46, 0x41, 0x38, 0x46, 0x43, 0x41, 0x37, 0x42,
+	0x39, 0x43, 0x32, 0x45, 0x04, 0x6E, 0x66, 0x3D, 0x31, 0x03, 0x72, 0x73,
+	0x3D, 0xC0, 0x2E, 0x00, 0x21, 0x80, 0x01, 0x00, 0x00, 0x00, 0x78, 0x00,
+	0x2D, 0x00, 0x00, 0x00, 0x00, 0x1F, 0x49, 0x24, 0x34, 0x66, 0x31, 0x63,
+	0x32, 0x61, 0x39, 0x62, 0x2D, 0x65, 0x30, 0x37, 0x64, 0x2D, 0x33, 0x61,
+	0x36, 0x63, 0x2D, 0x38, 0x31, 0x65, 0x35, 0x2D, 0x66, 0x30, 0x62, 0x32,
+	0x64, 0x39, 0x63, 0x37, 0x61, 0x34, 0x31, 0x33, 0xC0, 0x1D, 0xC1, 0x33,
+	0x00, 0x01, 0x80, 0x01, 0x00, 0x00, 0x00, 0x78, 0x00, 0x04, 0xC0, 0xA8,
+	0x01, 0x17,
+};
+
+// printer_response: 1043 bytes.
+static const byte capture_printer_response[] = {
+	0x00, 0x00, 0x84, 0x00, 0x00, 0x00, 0x00, 0x10, 0x00, 0x00, 0x00, 0x03,
+	0x04, 0x5F, 0x69, 0x70, 0x70, 0x04, 0x5F, 0x74, 0x63, 0x70, 0x05, 0x6C,
+	0x6F, 0x63, 0x61, 0x6C, 0x00, 0x00, 0x0C, 0x00, 0x01, 0x00, 0x00, 0x11,
+	0x94, 0x00, 0x20, 0x1D, 0x48, 0x50, 0x20, 0x4C, 0x61, 0x73, 0x65, 0x72,
+	0x4A, 0x65, 0x74, 0x20, 0x50, 0x72, 0x6F, 0x20, 0x4D, 0x34, 0x30, 0x34,
+	0x20, 0x5B, 0x41, 0x31, 0x42, 0x32, 0x43, 0x33, 0x5D, 0xC0, 0x0C, 0x08,
+	0x5F, 0x70, 0x72, 0x69, 0x6E, 0x74, 0x65, 0x72, 0xC0, 0x11, 0x00, 0x0C,
+	0x00, 0x01, 0x00, 0x00, 0x11, 0x94, 0x00, 0x20, 0x1D, 0x48, 0x50, 0x20,
+	0x4C, 0x61, 0x73, 0x65, 0x72, 0x4A, 0x65, 0x74, 0x20, 0x50, 0x72, 0x6F,
+	0x20, 0x4D, 0x34, 0x30, 0x34, 0x20, 0x5B, 0x41, 0x31, 0x42, 0x32, 0x43,
+	0x33, 0x5D, 0xC0, 0x47, 0x0F, 0x5F, 0x70, 0x64, 0x6C, 0x2D, 0x64, 0x61,
+	0x74, 0x61, 0x73, 0x74, 0x72, 0x65, 0x61, 0x6D, 0xC0, 0x11, 0x00, 0x0C,
+	0x00, 0x01, 0x00, 0x00, 0x11, 0x94, 0x00, 0x20, 0x1D, 0x48, 0x50, 0x20,
+	0x4C, 0x61, 0x73, 0x65, 0x72, 0x4A, 0x65, 0x74, 0x20, 0x50, 0x72, 0x6F,
+	0x20, 0x4D, 0x34, 0x30, 0x34, 0x20, 0x5B, 0x41, 0x31, 0x42, 0x32, 0x43,
+	0x33, 0x5D, 0xC0, 0x7C, 0x05, 0x5F, 0x68, 0x74, 0x74, 0x70, 0xC0, 0x11,
+	0x00, 0x0C, 0x00, 0x01, 0x00, 0x00, 0x11, 0x94, 0x00, 0x20, 0x1D, 0x48,
+	0x50, 0x20, 0x4C, 0x61, 0x73, 0x65, 0x72, 0x4A, 0x65, 0x74, 0x20, 0x50,
+	0x72, 0x6F, 0x20, 0x4D, 0x34, 0x30, 0x34, 0x20, 0x5B, 0x41, 0x31, 0x42,
+	0x32, 0x43, 0x33, 0x5D, 0xC0, 0xB8, 0x06, 0x5F, 0x75, 0x73, 0x63, 0x61,
+	0x6E, 0xC0, 0x11, 0x00, 0x0C, 0x00, 0x01, 0x00, 0x00, 0x11, 0x94, 0x00,
+	0x20, 0x1D, 0x48, 0x50, 0x20, 0x4C, 0x61, 0x73, 0x65, 0x72, 0x4A, 0x65,
+	0x74, 0x20, 0x50, 0x72, 0x6F, 0x20, 0x4D, 0x34, 0x30, 0x34, 0x20, 0x5B,
+	0x41, 0x31, 0x42, 0x32, 0x43, 0x33, 0x5D, 0xC0, 0xEA, 0x0A, 0x5F, 0x75,
+	0x6E, 0x69, 0x76, 0x65, 0x72, 0x73, 0x61, 0x6C, 0x04, 0x5F, 0x73, 0x75,
+	0x62, 0xC0, 0x0C, 0x00, 0x0C, 0x00, 0x01, 0x00, 0x00, 0x11, 0x94, 0x00,
+	0x02, 0xC0, 0x27, 0xC0, 0x27, 0x00, 0x21, 0x80, 0x01, 0x00, 0x00, 0x00,
+	0x78, 0x00, 0x11, 0x00, 0x00, 0x00, 0x00, 0x02, 0x77, 0x08, 0x48, 0x50,
+	0x41, 0x31, 0x42, 0x32, 0x43, 0x33, 0xC0, 0x16, 0xC0, 0x27, 0x00, 0x10,
+	0x80, 0x01, 0x00, 0x00, 0x11, 0x94, 0x01, 0xC7, 0x09, 0x74, 0x78, 0x74,
+	0x76, 0x65, 0x72, 0x73, 0x3D, 0x31, 0x08, 0x71, 0x74, 0x6F, 0x74, 0x61,
+	0x6C, 0x3D, 0x31, 0x0C, 0x72, 0x70, 0x3D, 0x69, 0x70, 0x70, 0x2F, 0x70,
+	0x72, 0x69, 0x6E, 0x74, 0x19, 0x74, 0x79, 0x3D, 0x48, 0x50, 0x20, 0x4C,
+	0x61, 0x73, 0x65, 0x72, 0x4A, 0x65, 0x74, 0x20, 0x50, 0x72, 0x6F, 0x20,
+	0x4D, 0x34, 0x30, 0x34, 0x64, 0x6E, 0x20, 0x70, 0x72, 0x6F, 0x64, 0x75,
+	0x63, 0x74, 0x3D, 0x28, 0x48, 0x50, 0x20, 0x4C, 0x61, 0x73, 0x65, 0x72,
+	0x4A, 0x65, 0x74, 0x20, 0x50, 0x72, 0x6F, 0x20, 0x4D, 0x34, 0x30, 0x34,
+	0x64, 0x6E, 0x29, 0x0A, 0x75, 0x73, 0x62, 0x5F, 0x4D, 0x46, 0x47, 0x3D,
+	0x48, 0x50, 0x1B, 0x75, 0x73, 0x62, 0x5F, 0x4D, 0x44, 0x4C, 0x3D, 0x4C,
+	0x61, 0x73, 0x65, 0x72, 0x4A, 0x65, 0x74, 0x20, 0x50, 0x72, 0x6F, 0x20,
+	0x4D, 0x34, 0x30, 0x34, 0x64, 0x6E, 0x0B, 0x6E, 0x6F, 0x74, 0x65, 0x3D,
+	0x4F, 0x66, 0x66, 0x69, 0x63, 0x65, 0x2F, 0x61, 0x64, 0x6D, 0x69, 0x6E,
+	0x75, 0x72, 0x6C, 0x3D, 0x68, 0x74, 0x74, 0x70, 0x3A, 0x2F, 0x2F, 0x48,
+	0x50, 0x41, 0x31, 0x42, 0x32, 0x43, 0x33, 0x2E, 0x6C, 0x6F, 0x63, 0x61,
+	0x6C, 0x2E, 0x2F, 0x23, 0x68, 0x49, 0x64, 0x2D, 0x70, 0x67, 0x41, 0x69,
+	0x72, 0x50, 0x72, 0x69, 0x6E, 0x74, 0x52, 0x70, 0x64, 0x6C, 0x3D, 0x61,
+	0x70, 0x70, 0x6C, 0x69, 0x63, 0x61, 0x74, 0x69, 0x6F, 0x6E, 0x2F, 0x6F,
+	0x63, 0x74, 0x65, 0x74, 0x2D, 0x73, 0x74, 0x72, 0x65, 0x61, 0x6D, 0x2C,
+	0x69, 0x6D, 0x61, 0x67, 0x65, 0x2F, 0x75, 0x72, 0x66, 0x2C, 0x69, 0x6D,
+	0x61, 0x67, 0x65, 0x2F, 0x6A, 0x70, 0x65, 0x67, 0x2C, 0x69, 0x6D, 0x61,
+	0x67, 0x65, 0x2F, 0x70, 0x77, 0x67, 0x2D, 0x72, 0x61, 0x73, 0x74, 0x65,
+	0x72, 0x2C, 0x61, 0x70, 0x70, 0x6C, 0x69, 0x63, 0x61, 0x74, 0x69, 0x6F,
+	0x6E, 0x2F, 0x70, 0x64, 0x66, 0x07, 0x43, 0x6F, 0x6C, 0x6F, 0x72, 0x3D,
+	0x46, 0x08, 0x44, 0x75, 0x70, 0x6C, 0x65, 0x78, 0x3D, 0x54, 0x29, 0x55,
+	0x55, 0x49, 0x44, 0x3D, 0x35, 0x36, 0x34, 0x65, 0x34, 0x33, 0x33, 0x33,
+	0x2D, 0x34, 0x65, 0x33, 0x30, 0x2D, 0x33, 0x34, 0x33, 0x31, 0x2D, 0x33,
+	0x37, 0x33, 0x32, 0x2D, 0x61, 0x30, 0x64, 0x33, 0x63, 0x31, 0x61, 0x31,
+	0x62, 0x32, 0x63, 0x33, 0x2E, 0x55, 0x52, 0x46, 0x3D, 0x43, 0x50, 0x31,
+	0x2C, 0x49, 0x53, 0x31, 0x2D, 0x34, 0x2C, 0x4D, 0x54, 0x31, 0x2D, 0x33,
+	0x2D, 0x35, 0x2C, 0x52, 0x53, 0x36, 0x30, 0x30, 0x2C, 0x53, 0x52, 0x47,
+	0x42, 0x32, 0x34, 0x2C, 0x56, 0x31, 0x2E, 0x34, 0x2C, 0x57, 0x38, 0x2C,
+	0x44, 0x4D, 0x31, 0x07, 0x54, 0x4C, 0x53, 0x3D, 0x31, 0x2E, 0x32, 0x14,
+	0x6D, 0x6F, 0x70, 0x72, 0x69, 0x61, 0x2D, 0x63, 0x65, 0x72, 0x74, 0x69,
+	0x66, 0x69, 0x65, 0x64, 0x3D, 0x31, 0x2E, 0x33, 0x1C, 0x6B, 0x69, 0x6E,
+	0x64, 0x3D, 0x64, 0x6F, 0x63, 0x75, 0x6D, 0x65, 0x6E, 0x74, 0x2C, 0x65,
+	0x6E, 0x76, 0x65, 0x6C, 0x6F, 0x70, 0x65, 0x2C, 0x6C, 0x61, 0x62, 0x65,
+	0x6C, 0x11, 0x50, 0x61, 0x70, 0x65, 0x72, 0x4D, 0x61, 0x78, 0x3D, 0x6C,
+	0x65, 0x67, 0x61, 0x6C, 0x2D, 0x41, 0x34, 0xC0, 0x5C, 0x00, 0x21, 0x80,
+	0x01, 0x00, 0x00, 0x00, 0x78, 0x00, 0x08, 0x00, 0x00, 0x00, 0x00, 0x02,
+	0x03, 0xC1, 0x4D, 0xC0, 0x5C, 0x00, 0x10, 0x80, 0x01, 0x00, 0x00, 0x11,
+	0x94, 0x00, 0x0A, 0x09, 0x74, 0x78, 0x74, 0x76, 0x65, 0x72, 0x73, 0x3D,
+	0x31, 0xC0, 0x98, 0x00, 0x21, 0x80, 0x01, 0x00, 0x00, 0x00, 0x78, 0x00,
+	0x08, 0x00, 0x00, 0x00, 0x00, 0x23, 0x8C, 0xC1, 0x4D, 0xC0, 0x98, 0x00,
+	0x10, 0x80, 0x01, 0x00, 0x00, 0x11, 0x94, 0x00, 0x0A, 0x09, 0x74, 0x78,
+	0x74, 0x76, 0x65, 0x72, 0x73, 0x3D, 0x31, 0xC0, 0xCA, 0x00, 0x21, 0x80,
+	0x01, 0x00, 0x00, 0x00, 0x78, 0x00, 0x08, 0x00, 0x00, 0x00, 0x00, 0x00,
+	0x50, 0xC1, 0x4D, 0xC0, 0xCA, 0x00, 0x10, 0x80, 0x01, 0x00, 0x00, 0x11,
+	0x94, 0x00, 0x0A, 0x09, 0x74, 0x78, 0x74, 0x76, 0x65, 0x72, 0x73, 0x3D,
+	0x31, 0xC0, 0xFD, 0x00, 0x21, 0x80, 0x01, 0x00, 0x00, 0x00, 0x78, 0x00,
+	0x08, 0x00, 0x00, 0x00, 0x00, 0x1F, 0x90, 0xC1, 0x4D, 0xC0, 0xFD, 0x00,
+	0x10, 0x80, 0x01, 0x00, 0x00, 0x11, 0x94, 0x00, 0x0A, 0x09, 0x74, 0x78,
+	0x74, 0x76, 0x65, 0x72, 0x73, 0x3D, 0x31, 0xC1, 0x4D, 0x00, 0x01, 0x80,
+	0x01, 0x00, 0x00, 0x00, 0x78, 0x00, 0x04, 0xC0, 0xA8, 0x01, 0x29, 0xC1,
+	0x4D, 0x00, 0x1C, 0x80, 0x01, 0x00, 0x00, 0x00, 0x78, 0x00, 0x10, 0xFE,
+	0x80, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0xA2, 0xD3, 0xC1, 0xFF, 0xFE,
+	0xA1, 0xB2, 0xC3, 0xC1, 0x4D, 0x00, 0x2F, 0x80, 0x01, 0x00, 0x00, 0x00,
+	0x78, 0x00, 0x08, 0xC1, 0x4D, 0x00, 0x04, 0x40, 0x00, 0x00, 0x08,
+};
+
+// apple_browse_query: 280 bytes.
+static const byte capture_apple_browse_query[] = {
+	0x00, 0x00, 0x00, 0x00, 0x00, 0x06, 0x00, 0x05, 0x00, 0x00, 0x00, 0x00,
+	0x08, 0x5F, 0x61, 0x69, 0x72, 0x70, 0x6C, 0x61, 0x79, 0x04, 0x5F, 0x74,
+	0x63, 0x70, 0x05, 0x6C, 0x6F, 0x63, 0x61, 0x6C, 0x00, 0x00, 0x0C, 0x80,
+	0x01, 0x05, 0x5F, 0x72, 0x61, 0x6F, 0x70, 0xC0, 0x15, 0x00, 0x0C, 0x80,
+	0x01, 0x0F, 0x5F, 0x63, 0x6F, 0x6D, 0x70, 0x61, 0x6E, 0x69, 0x6F, 0x6E,
+	0x2D, 0x6C, 0x69, 0x6E, 0x6B, 0xC0, 0x15, 0x00, 0x0C, 0x80, 0x01, 0x0C,
+	0x5F, 0x73, 0x6C, 0x65, 0x65, 0x70, 0x2D, 0x70, 0x72, 0x6F, 0x78, 0x79,
+	0x04, 0x5F, 0x75, 0x64, 0x70, 0xC0, 0x1A, 0x00, 0x0C, 0x80, 0x01, 0x08,
+	0x5F, 0x68, 0x6F, 0x6D, 0x65, 0x6B, 0x69, 0x74, 0xC0, 0x15, 0x00, 0x0C,
+	0x80, 0x01, 0x0B, 0x5F, 0x67, 0x6F, 0x6F, 0x67, 0x6C, 0x65, 0x63, 0x61,
+	0x73, 0x74, 0xC0, 0x15, 0x00, 0x0C, 0x80, 0x01, 0xC0, 0x0C, 0x00, 0x0C,
+	0x00, 0x01, 0x00, 0x00, 0x11, 0x76, 0x00, 0x0A, 0x07, 0x42, 0x65, 0x64,
+	0x72, 0x6F, 0x6F, 0x6D, 0xC0, 0x0C, 0xC0, 0x25, 0x00, 0x0C, 0x00, 0x01,
+	0x00, 0x00, 0x11, 0x76, 0x00, 0x17, 0x14, 0x41, 0x30, 0x44, 0x33, 0x43,
+	0x31, 0x31, 0x31, 0x32, 0x32, 0x33, 0x33, 0x40, 0x42, 0x65, 0x64, 0x72,
+	0x6F, 0x6F, 0x6D, 0xC0, 0x25, 0xC0, 0x31, 0x00, 0x0C, 0x00, 0x01, 0x00,
+	0x00, 0x11, 0x76, 0x00, 0x11, 0x0E, 0x41, 0x6C, 0x69, 0x63, 0x65, 0x27,
+	0x73, 0x20, 0x69, 0x50, 0x68, 0x6F, 0x6E, 0x65, 0xC0, 0x31, 0xC0, 0x31,
+	0x00, 0x0C, 0x00, 0x01, 0x00, 0x00, 0x11, 0x76, 0x00, 0x0E, 0x0B, 0x4C,
+	0x69, 0x76, 0x69, 0x6E, 0x67, 0x20, 0x52, 0x6F, 0x6F, 0x6D, 0xC0, 0x31,
+	0xC0, 0x47, 0x00, 0x0C, 0x00, 0x01, 0x00, 0x00, 0x11, 0x76, 0x00, 0x1C,
+	0x0B, 0x37, 0x30, 0x2D, 0x33, 0x35, 0x2D, 0x36, 0x30, 0x2D, 0x36, 0x33,
+	0x0D, 0x31, 0x20, 0x4C, 0x69, 0x76, 0x69, 0x6E, 0x67, 0x20, 0x52, 0x6F,
+	0x6F, 0x6D, 0xC0, 0x47,
+};
+
+// avahi_mqtt_response: 160 bytes.
+static const byte capture_avahi_mqtt_response[] = {
+	0x00, 0x00, 0x84, 0x00, 0x00, 0x00, 0x00, 0x01, 0x00, 0x00, 0x00, 0x04,
+	0x05, 0x5F, 0x6D, 0x71, 0x74, 0x74, 0x04, 0x5F, 0x74, 0x63, 0x70, 0x05,
+	0x6C, 0x6F, 0x63, 0x61, 0x6C, 0x00, 0x00, 0x0C, 0x00, 0x01, 0x00, 0x00,
+	0x11, 0x94, 0x00, 0x23, 0x20, 0x4D, 0x6F, 0x73, 0x71, 0x75, 0x69, 0x74,
+	0x74, 0x6F, 0x20, 0x4D, 0x51, 0x54, 0x54, 0x20, 0x73, 0x65, 0x72, 0x76,
+	0x65, 0x72, 0x20, 0x6F, 0x6E, 0x20, 0x74, 0x77, 0x69, 0x6E, 0x6B, 0x6C,
+	0x65, 0xC0, 0x0C, 0xC0, 0x28, 0x00, 0x10, 0x80, 0x01, 0x00, 0x00, 0x11,
+	0x94, 0x00, 0x01, 0x00, 0xC0, 0x28, 0x00, 0x21, 0x80, 0x01, 0x00, 0x00,
+	0x00, 0x78, 0x00, 0x10, 0x00, 0x00, 0x00, 0x00, 0x07, 0x5B, 0x07, 0x74,
+	0x77, 0x69, 0x6E, 0x6B, 0x6C, 0x65, 0xC0, 0x17, 0xC0, 0x6A, 0x00, 0x1C,
+	0x80, 0x01, 0x00, 0x00, 0x00, 0x78, 0x00, 0x10, 0xFE, 0x80, 0x00, 0x00,
+	0x00, 0x00, 0x00, 0x00, 0x02, 0x11, 0x32, 0x7F, 0xFF, 0xE4, 0x1C, 0x2D,
+	0xC0, 0x6A, 0x00, 0x01, 0x80, 0x01, 0x00, 0x00, 0x00, 0x78, 0x00, 0x04,
+	0xC0, 0xA8, 0xC0, 0x09,
+};
+
+// hostname_probe: 50 bytes.
+static const byte capture_hostname_probe[] = {
+	0x00, 0x00, 0x00, 0x00, 0x00, 0x01, 0x00, 0x00, 0x00, 0x01, 0x00, 0x00,
+	0x0A, 0x65, 0x73, 0x70, 0x2D, 0x61, 0x31, 0x62, 0x32, 0x63, 0x33, 0x05,
+	0x6C, 0x6F, 0x63, 0x61, 0x6C, 0x00, 0x00, 0xFF, 0x80, 0x01, 0xC0, 0x0C,
+	0x00, 0x01, 0x00, 0x01, 0x00, 0x00, 0x00, 0x78, 0x00, 0x04, 0xC0, 0xA8,
+	0x01, 0x4D,
+};
+
+static const Capture captures[] = {
+	{ "googlecast_response", capture_googlecast_response, sizeof(capture_googlecast_response) },
+	{ "printer_response", capture_printer_response, sizeof(capture_printer_response) },
+	{ "apple_browse_query", capture_apple_browse_query, sizeof(capture_apple_browse_query) },
+	{ "avahi_mqtt_response", capture_avahi_mqtt_response, sizeof(capture_avahi_mqtt_response) },
+	{ "hostname_probe", capture_hostname_probe, sizeof(capture_hostname_probe) },
+};
+
+#define CAPTURE_COUNT (sizeof(captures) / sizeof(captures[0]))
+
+#endif /* HOST_TOOLS_CAPTURES_H_ */
@@ -0,0 +1,150 @@
+/*
+ * fuzz.cpp
+ *
+ * Fuzz target for the packet parser.
+ *
+ * Every input is walked with RecordIterator, every question and record is
+ * fully decoded, every offset is tried as the start of a name, and the input
+ * is fed through MDns::loop() with an MDNSResponder listening. None of this
+ * may read outside the input or recurse without bound; build with
+ * -DMDNS_SANITIZE=ON to have ASan and UBSan check that.
+ *
+ * With clang and -DMDNS_LIBFUZZER=ON this is a libFuzzer target. Otherwise a
+ * simple driver mutates the packets in captures.h:
+ *
+ *   mdns_fuzz [iterations] [seed]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "mdns.h"
+#include "MDNSResponder.h"
+#include "LoopbackUDP.h"
+#include "captures.h"
+
+using namespace mdns;
+
+static void parsePacket(const byte *data, unsigned int size) {
+	char name[MAX_MDNS_NAME_LEN];
+
+	RecordIterator records(data, size);
+	QuestionView question;
+	while (records.nextQuestion(question)) {
+		Query query;
+		question.toQuery(query);
+		question.getName(name, sizeof(name));
+	}
+	RecordView record;
+	while (records.nextRecord(record)) {
+		Answer answer;
+		record.toAnswer(answer);
+		record.getRdataName(name, sizeof(name));
+		record.getRdataName(name, sizeof(name), 6);
+		hashDnsName(data, size, record.name_offset);
+		// Any rdata, not only TXT, must be safe to walk as strings.
+		TxtIterator txt = record.getTxt();
+		TxtEntry entry;
+		while (txt.next(entry)) {
+			entry.getValue(name, sizeof(name));
+		}
+		txt.find("txtvers", entry);
+	}
+
+	const DnsName target("twinkle.local");
+	for (unsigned int offset = 0; offset < size; offset++) {
+		decodeDnsName(name, 0, sizeof(name), data, size, offset);
+		decodeDnsName(name, 0, 8, data, size, offset);
+		target.matches(data, size, offset);
+		dnsNameEquals(data, size, offset, "twinkle.local");
+		skipDnsName(data, size, offset);
+	}
+}
+
+static void loopPacket(const byte *data, unsigned int size) {
+	static LoopbackUDP udp;
+	static byte buffer[MAX_PACKET_SIZE];
+	static MDns my_mdns(udp, buffer, MAX_PACKET_SIZE, NULL);
+	static Callback decodeAll;
+	static Callback decodeMqtt;
+	static MDNSResponder responder(&my_mdns, NULL);
+	static bool registered = false;
+
+	if (!registered) {
+		// Names which appear in captures.h, so mutated questions hit them.
+		responder.setHostname("twinkle.local", IPAddress(192, 168, 1, 9));
+		const int mqtt = responder.addService("Mosquitto", "_mqtt._tcp.local",
+				1883);
+		responder.addServiceText(mqtt, "path=/");
+		responder.addService("Printer", "_ipp._tcp.local", 631);
+		my_mdns.subscribe(&decodeMqtt, MDNS_TYPE_PTR, "_mqtt._tcp.local");
+		my_mdns.subscribe(&decodeMqtt, MDNS_TYPE_A);
+		registered = true;
+	}
+	my_mdns.setCallback(&decodeAll);
+	udp.inject(data, size);
+	my_mdns.loop();
+}
+
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size) {
+	parsePacket(data, size);
+	loopPacket(data, size);
+	return 0;
+}
+
+#ifndef MDNS_LIBFUZZER
+
+// Mutations aimed at the name decoder: random bytes, compression pointers to
+// random (often self-referencing) offsets, label lengths and truncation.
+static unsigned int mutate(byte *packet, unsigned int size,
+		unsigned int max_size) {
+	const int mutations = 1 + rand() % 4;
+	for (int m = 0; m < mutations && size > 0; m++) {
+		const unsigned int at = rand() % size;
+		switch (rand() % 6) {
+		case 0:
+			packet[at] ^= 1 << (rand() % 8);
+			break;
+		case 1:
+			packet[at] = rand();
+			break;
+		case 2:
+			if (at + 1 < size) {
+				const unsigned int target = rand() % (at + 2);
+				packet[at] = 0xC0 | (target >> 8);
+				packet[at + 1] = target;
+			}
+			break;
+		case 3:
+			packet[at] = rand() % 64;
+			break;
+		case 4:
+			size = at;
+			break;
+		case 5:
+			if (size < max_size) {
+				packet[size++] = rand();
+			}
+			break;
+		}
+	}
+	return size;
+}
+
+int main(int argc, char **argv) {
+	const unsigned long iterations = argc > 1 ? atol(argv[1]) : 200000;
+	srand(argc > 2 ? atoi(argv[2]) : 1);
+
+	byte packet[WIFI_UDP_BUFFER_SIZE];
+	for (unsigned long i = 0; i < iterations; i++) {
+		const Capture &capture = captures[i % CAPTURE_COUNT];
+		memcpy(packet, capture.data, capture.size);
+		const unsigned int size = mutate(packet, capture.size, sizeof(packet));
+		LLVMFuzzerTestOneInput(packet, size);
+	}
+	printf("%lu inputs survived\n", iterations);
+	return 0;
+}
+
+#endif  // MDNS_LIBFUZZER
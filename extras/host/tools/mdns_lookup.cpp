@@ -0,0 +1,86 @@
+/*
+ * mdns_lookup.cpp
+ *
+ * Host build counterpart of examples/blocking_mdns_lookup: resolves a host
+ * or browses for a service on the local network using MDNSClient.
+ *
+ *   mdns_lookup twinkle.local
+ *   mdns_lookup -s _mqtt._tcp.local
+ *   mdns_lookup -6 twinkle.local     (A and AAAA, whichever answers first)
+ *
+ * Set MDNS_HOST_IP to pick the interface when the machine has several.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "MDNSClient.h"
+
+static void usage(const char *argv0) {
+	fprintf(stderr, "usage: %s [-s | -6] name [timeout_ms]\n", argv0);
+}
+
+int main(int argc, char **argv) {
+	bool service = false;
+	bool dual = false;
+	int arg = 1;
+	if (arg < argc && strcmp(argv[arg], "-s") == 0) {
+		service = true;
+		arg++;
+	} else if (arg < argc && strcmp(argv[arg], "-6") == 0) {
+		dual = true;
+		arg++;
+	}
+	if (arg >= argc) {
+		usage(argv[0]);
+		return 2;
+	}
+	const char *name = argv[arg++];
+	uint16_t timeout = arg < argc ? atoi(argv[arg]) : 5000;
+
+	WiFiUDP udp;
+	mdns::MDns my_mdns(udp);
+	MDNSClient mdnsClient(my_mdns);
+
+	Serial.print("Local address: ");
+	Serial.println(WiFi.localIP());
+	my_mdns.begin();
+
+	unsigned long startedAt = micros();
+	if (service) {
+		int hostCount = mdnsClient.lookupService(name, timeout);
+		Serial.print(name);
+		Serial.print(" =====> resolved to ");
+		Serial.print(hostCount);
+		Serial.print(" hosts");
+	} else if (dual) {
+		MDNSClient::LookupHandle handle = mdnsClient.startLookupHostDual(name,
+				timeout);
+		while (mdnsClient.getStatus(handle) == MDNSClient::STATUS_PENDING) {
+			mdnsClient.poll();
+		}
+		Serial.print(name);
+		Serial.print(" =====> resolved to: ");
+		Serial.print(mdnsClient.getHostAddress(handle));
+		uint8_t ip6[16];
+		if (mdnsClient.getHostAddress6(handle, ip6)) {
+			char text[8];
+			Serial.print(" ");
+			for (int i = 0; i < 16; i += 2) {
+				snprintf(text, sizeof(text), i < 14 ? "%x:" : "%x",
+						(ip6[i] << 8) | ip6[i + 1]);
+				Serial.print(text);
+			}
+		}
+	} else {
+		IPAddress host = mdnsClient.lookupHost(name, timeout);
+		Serial.print(name);
+		Serial.print(" =====> resolved to: ");
+		Serial.print(host);
+	}
+	Serial.print(" in ");
+	Serial.print(micros() - startedAt);
+	Serial.println(" us");
+	return 0;
+}
@@ -3,6 +3,9 @@
 
 #include "lwip/igmp.h"
 #include <lwip/netif.h>
+#if LWIP_IPV6 && LWIP_IPV6_MLD
+#include "lwip/mld6.h"
+#endif
 extern struct netif xnetif[];
 
 namespace mdns {
@@ -10,7 +13,7 @@ namespace mdns {
 // Helper function to display formatted data.
 void MDns::PrintHex(const unsigned char data) const {
 	if (debug) {
-		char tmp[2];
+		char tmp[3];
 		sprintf(tmp, "%02X", data);
 		debug->print(tmp);
 		debug->print(" ");
@@ -31,6 +34,16 @@ uint8_t MDns::startUdpMulticast() {
 	}
 	xnetif[0].flags |= NETIF_FLAG_IGMP;
 
+#if LWIP_IPV6 && LWIP_IPV6_MLD
+	// Let the interface take the IPv6 mDNS traffic as well.
+	ip6_addr_t g6;
+	IP6_ADDR(&g6, PP_HTONL(0xFF020000UL), 0, 0, PP_HTONL(0x000000FBUL));
+	if (mld6_joingroup(IP6_ADDR_ANY6, &g6) != ERR_OK) {
+		debug->println("mld6_joingroup error");
+	}
+	xnetif[0].flags |= NETIF_FLAG_MLD6;
+#endif
+
     return udp->begin(MDNS_TARGET_PORT);
 }
 
@@ -43,6 +56,20 @@ void MDns::begin() {
 }
 
 bool MDns::loop() {
+	const bool result = receive();
+
+	// The packet has been handled: listeners may now use the buffer to send.
+	if (_callback) {
+		_callback->onLoop(this);
+	}
+	for (Callback * l = _listeners; l; l = dispatch_next) {
+		dispatch_next = l->_next_listener;
+		l->onLoop(this);
+	}
+	return result;
+}
+
+bool MDns::receive() {
 	data_size = udp->parsePacket();
 	if ( data_size > 0)
 	{
@@ -50,6 +77,7 @@ bool MDns::loop() {
 		// read the data from it.
 		// but first save the source and destination IP
 		srcIP = udp->remoteIP();
+		srcPort = udp->remotePort();
 		data_size = udp->read(data_buffer, max_packet_size);
 
 #ifdef DEBUG_STATISTICS
@@ -64,7 +92,9 @@ bool MDns::loop() {
 		packet_count++;
 #endif
 
-		// data_buffer[0] and data_buffer[1] contain the Query ID field which is unused in mDNS.
+		// data_buffer[0] and data_buffer[1] contain the Query ID field, which
+		// is unused in mDNS except by legacy resolvers.
+		query_id = (data_buffer[0] << 8) + data_buffer[1];
 
 		// data_buffer[2] and data_buffer[3] are DNS flags which are mostly unused in mDNS.
 		type = !(data_buffer[2] & 0b10000000); // If it's not a query, it's an answer.
@@ -86,60 +116,117 @@ bool MDns::loop() {
 		// Number of incoming Additional resource records.
 		ar_count = (data_buffer[10] << 8) + data_buffer[11];
 
+		if (!isInteresting()) {
+#ifdef DEBUG_STATISTICS
+			dropped_count++;
+#endif
+			return true;
+		}
+
 		if (_callback) {
 			// Since a callback function has been registered, execute it.
 			_callback->onPacket(this);
 		}
+		for (Callback * l = _listeners; l; l = dispatch_next) {
+			dispatch_next = l->_next_listener;
+			l->onPacket(this);
+		}
 
 #ifdef DEBUG_OUTPUT
 		if (debug)
 			Display();
 #endif  // DEBUG_OUTPUT
 
-		// Start of Data section.
-		buffer_pointer = 12;
-
-		for (unsigned int i_question = 0; i_question < query_count;
-				i_question++) {
-			Query query;
-			Parse_Query(query);
-			if (query.valid) {
-				if (_callback) {
-					// Since a callback function has been registered, execute it.
-					_callback->onQuery(&query);
+		// Walk the Data section in place. Names and rdata are only expanded if
+		// the callback asks for them.
+		RecordIterator records(data_buffer, data_size);
+
+		QuestionView question;
+		while (records.nextQuestion(question)) {
+			if (_callback) {
+				// Since a callback function has been registered, execute it.
+				_callback->onQuestion(question);
+			}
+			for (Callback * l = _listeners; l; l = dispatch_next) {
+				dispatch_next = l->_next_listener;
+				if (!l->_subscribed) {
+					l->onQuestion(question);
 				}
 			}
-			if (buffer_pointer > data_size) {
-				return false;
+			if (subscribed_types & (1UL << (question.qtype & 31))) {
+				uint32_t hash = 0;
+				for (dispatch_at = 0; dispatch_at < (int)subscription_count;
+						dispatch_at++) {
+					Callback * const listener = subscriptions[dispatch_at].listener;
+					if (wants(subscriptions[dispatch_at], question.qtype,
+							question.name_offset, hash)) {
+						listener->onQuestion(question);
+						// Once is enough: skip its other subscriptions.
+						while (dispatch_at + 1 < (int)subscription_count
+								&& subscriptions[dispatch_at + 1].listener == listener) {
+							dispatch_at++;
+						}
+					}
+				}
+				dispatch_at = -1;
 			}
 #ifdef DEBUG_OUTPUT
 			if (debug)
 			{
+				Query query;
+				question.toQuery(query);
 				query.Display(debug);
 			}
 #endif  // DEBUG_OUTPUT
 		}
 
-		for (unsigned int i_answer = 0;
-				i_answer < (answer_count + ns_count + ar_count); i_answer++) {
-			Answer answer;
-			Parse_Answer(answer);
-			if (answer.valid) {
-		    	  if (_callback) {
-		    		  _callback->onAnswer(&answer);
-		    	  }
+		const unsigned long now = millis();
+		RecordView record;
+		while (records.nextRecord(record)) {
+			if (!type) {
+				// Only responses are cached. The records in a query are the
+				// asker's known answers.
+				cache.insert(record, now);
 			}
-			if (buffer_pointer > data_size) {
-				return false;
+			if (_callback) {
+				_callback->onRecord(record);
+			}
+			for (Callback * l = _listeners; l; l = dispatch_next) {
+				dispatch_next = l->_next_listener;
+				if (!l->_subscribed) {
+					l->onRecord(record);
+				}
+			}
+			if (subscribed_types & (1UL << (record.rrtype & 31))) {
+				uint32_t hash = 0;
+				for (dispatch_at = 0; dispatch_at < (int)subscription_count;
+						dispatch_at++) {
+					Callback * const listener = subscriptions[dispatch_at].listener;
+					if (wants(subscriptions[dispatch_at], record.rrtype,
+							record.name_offset, hash)) {
+						listener->onRecord(record);
+						while (dispatch_at + 1 < (int)subscription_count
+								&& subscriptions[dispatch_at + 1].listener == listener) {
+							dispatch_at++;
+						}
+					}
+				}
+				dispatch_at = -1;
 			}
 #ifdef DEBUG_OUTPUT
 			if (debug)
 			{
+				Answer answer;
+				record.toAnswer(answer);
 				answer.Display(debug);
 			}
 #endif  // DEBUG_OUTPUT
 		}
 
+		if (records.malformed()) {
+			return false;
+		}
+
 #ifdef DEBUG_RAW
 		if (debug)
 			DisplayRawPacket();
@@ -150,6 +237,156 @@ bool MDns::loop() {
 	return true;  // Not enough data for a full packet to be waiting.
 }
 
+// Whether any callback or listener wants the packet just received, judging
+// by its header and, for a query all of them filter, its questions and
+// sender.
+bool MDns::isInteresting() const {
+	if (!_callback && !_listeners) {
+		// Only the cache: it takes everything.
+		return true;
+	}
+	const uint8_t kind = type ? INTEREST_QUERIES : INTEREST_RESPONSES;
+	bool filtered = true;
+	bool wanted = false;
+	for (const Callback * l = nextCallback(NULL); l; l = nextCallback(l)) {
+		const uint8_t interest = l->getInterest();
+		if (interest & kind) {
+			wanted = true;
+			filtered &= type && (interest & INTEREST_QUESTION_FILTER);
+		}
+	}
+	if (!wanted || !filtered) {
+		return wanted;
+	}
+
+	RecordIterator records(data_buffer, data_size);
+	QuestionView question;
+	while (records.nextQuestion(question)) {
+		const uint32_t hash = hashDnsName(data_buffer, data_size,
+				question.name_offset);
+		for (const Callback * l = nextCallback(NULL); l; l = nextCallback(l)) {
+			if ((l->getInterest() & INTEREST_QUERIES)
+					&& l->isInterestingQuestion(hash, question.qtype)) {
+				return true;
+			}
+		}
+	}
+	for (const Callback * l = nextCallback(NULL); l; l = nextCallback(l)) {
+		if ((l->getInterest() & INTEREST_QUERIES)
+				&& l->isInterestingAsker(srcIP)) {
+			return true;
+		}
+	}
+	return false;
+}
+
+// The callback, then each listener: NULL starts the walk and ends it. The
+// callback may be a listener as well, so it is skipped among them.
+const Callback * MDns::nextCallback(const Callback * l) const {
+	const Callback * next = l == NULL ? (_callback ? _callback : _listeners)
+			: l == _callback ? _listeners : l->_next_listener;
+	if (l != NULL && next != NULL && next == _callback) {
+		next = next->_next_listener;
+	}
+	return next;
+}
+
+void MDns::addListener(Callback * listener) {
+	removeListener(listener);
+	listener->_next_listener = _listeners;
+	_listeners = listener;
+}
+
+bool MDns::subscribe(Callback * listener, unsigned int rrtype,
+		const char * name) {
+	uint32_t hash = 0;
+	if (name) {
+		const DnsName wire(name);
+		if (wire.empty()) {
+			return false;
+		}
+		hash = wire.getHash();
+	}
+	if (subscription_count == MDNS_SUBSCRIPTIONS) {
+		return false;
+	}
+	if (!listener->_subscribed) {
+		addListener(listener);
+		listener->_subscribed = true;
+	}
+
+	// Keep the subscriptions of a listener together, after its last one.
+	unsigned int i = 0;
+	while (i < subscription_count && subscriptions[i].listener != listener) {
+		i++;
+	}
+	while (i < subscription_count && subscriptions[i].listener == listener) {
+		i++;
+	}
+	if ((int)i <= dispatch_at) {
+		dispatch_at++;
+	}
+	for (unsigned int j = subscription_count; j > i; j--) {
+		subscriptions[j] = subscriptions[j - 1];
+	}
+	subscriptions[i].listener = listener;
+	subscriptions[i].name = name;
+	subscriptions[i].hash = hash;
+	subscriptions[i].type = rrtype;
+	subscription_count++;
+	subscribed_types |= 1UL << (rrtype & 31);
+	return true;
+}
+
+bool MDns::wants(const Subscription &subscription, unsigned int type,
+		unsigned int name_offset, uint32_t &hash) const {
+	if (subscription.type != type) {
+		return false;
+	}
+	if (!subscription.name) {
+		return true;
+	}
+	if (hash == 0) {
+		hash = hashDnsName(data_buffer, data_size, name_offset);
+	}
+	return subscription.hash == hash
+			&& dnsNameEquals(data_buffer, data_size, name_offset,
+					subscription.name);
+}
+
+void MDns::dropSubscriptions(Callback * listener) {
+	unsigned int kept = 0;
+	subscribed_types = 0;
+	int passed = 0;
+	for (unsigned int i = 0; i < subscription_count; i++) {
+		if (subscriptions[i].listener != listener) {
+			subscribed_types |= 1UL << (subscriptions[i].type & 31);
+			subscriptions[kept++] = subscriptions[i];
+		} else if ((int)i <= dispatch_at) {
+			passed++;
+		}
+	}
+	subscription_count = kept;
+	dispatch_at -= passed;
+	listener->_subscribed = false;
+}
+
+void MDns::removeListener(Callback * listener) {
+	if (listener->_subscribed) {
+		dropSubscriptions(listener);
+	}
+	for (Callback ** link = &_listeners; *link; link = &(*link)->_next_listener) {
+		if (*link == listener) {
+			if (dispatch_next == listener) {
+				dispatch_next = listener->_next_listener;
+			}
+			*link = listener->_next_listener;
+			listener->_next_listener = NULL;
+			return;
+		}
+	}
+}
+
 void MDns::Clear() {
 	data_buffer[0] = 0;     // Query ID field which is unused in mDNS.
 	data_buffer[1] = 0;     // Query ID field which is unused in mDNS.
@@ -171,55 +408,86 @@ void MDns::Clear() {
 	answer_count = 0;
 	ns_count = 0;
 	ar_count = 0;
+	name_offset_count = 0;
 }
 
-unsigned int MDns::PopulateName(const char *name_buffer) {
-	// TODO: This section does not match the full mDNS spec
-	// as it does not re-use strings from previous queries.
+// Size the packet may grow to for `needed` more bytes, capped at the buffer.
+unsigned int MDns::reserve(unsigned int needed) const {
+	if (buffer_pointer >= max_packet_size
+			or needed > max_packet_size - buffer_pointer) {
+		return max_packet_size;
+	}
+	return buffer_pointer + needed;
+}
 
-	unsigned int buffer_pointer_start = buffer_pointer;
-	int word_start = 0, word_end = 0;
-	while (true) {
-		if (name_buffer[word_end] == '.' or name_buffer[word_end] == '\0') {
-			const int word_length = word_end - word_start;
-			if (buffer_pointer >= data_size) {
-				buffer_pointer = buffer_pointer_start;
-#ifdef DEBUG_OUTPUT
-				if (debug)
-					debug->println(" ERROR. MDns::PopulateName overrun buffer.");
-#endif
-				return 0;
-			}
-			data_buffer[buffer_pointer++] = (byte)word_length;
-			for (int i = word_start; i < word_end; ++i) {
-				if (buffer_pointer >= data_size) {
-					buffer_pointer = buffer_pointer_start;
+unsigned int MDns::PopulateName(const char *name_buffer) {
+	DnsName name;
+	if (!name.set(name_buffer)) {
 #ifdef DEBUG_OUTPUT
-					if (debug)
-						debug->println(" ERROR. MDns::PopulateName overrun buffer.");
+		if (debug)
+			debug->println(" ERROR. MDns::PopulateName invalid name.");
 #endif
-					return 0;
-				}
-				data_buffer[buffer_pointer++] = name_buffer[i];
-			}
-			if (name_buffer[word_end] == '\0') {
+		return 0;
+	}
+	return PopulateWireName(name.getWire(), name.getLength());
+}
+
+// Write a name, replacing the longest suffix already written to the packet
+// with a compression pointer (RFC 1035 section 4.1.4).
+unsigned int MDns::PopulateWireName(const byte *wire, unsigned int length) {
+	const unsigned int buffer_pointer_start = buffer_pointer;
+
+	// Entries past buffer_pointer belong to records which didn't fit and
+	// were rolled back.
+	while (name_offset_count > 0
+			&& name_offsets[name_offset_count - 1].offset >= buffer_pointer_start) {
+		name_offset_count--;
+	}
+	const unsigned int previous_count = name_offset_count;
+
+	unsigned int pos = 0;
+	int pointer = -1;
+	while (pos < length && wire[pos] != 0) {
+		const uint32_t hash = hashDnsName(wire, length, pos);
+		for (unsigned int i = 0; i < previous_count; i++) {
+			if (name_offsets[i].hash == hash
+					&& dnsNameEquals(data_buffer, buffer_pointer_start,
+							name_offsets[i].offset, wire + pos)) {
+				pointer = name_offsets[i].offset;
 				break;
 			}
-			word_end++;  // Skip the '.' character.
-			word_start = word_end;
 		}
-		word_end++;
-	};
+		if (pointer >= 0) {
+			break;
+		}
+		// Later names can point at this suffix once it is written.
+		const unsigned int offset = buffer_pointer_start + pos;
+		if (name_offset_count < MDNS_COMPRESSION_ENTRIES && offset < 0x4000) {
+			name_offsets[name_offset_count].hash = hash;
+			name_offsets[name_offset_count].offset = offset;
+			name_offset_count++;
+		}
+		pos += wire[pos] + 1;
+	}
 
-	if (buffer_pointer >= data_size) {
-		buffer_pointer = buffer_pointer_start;
+	// The labels before the suffix, then a pointer or the terminating zero.
+	const unsigned int name_length = pos + (pointer >= 0 ? 2 : 1);
+	if (pos >= length || buffer_pointer + name_length > data_size) {
+		name_offset_count = previous_count;
 #ifdef DEBUG_OUTPUT
 		if (debug)
-			debug->println(" ERROR. MDns::PopulateName overrun buffer while finishing.");
+			debug->println(" ERROR. MDns::PopulateName overrun buffer.");
 #endif
 		return 0;
 	}
-	data_buffer[buffer_pointer++] = '\0';  // End of qname.
+	memcpy(data_buffer + buffer_pointer, wire, pos);
+	buffer_pointer += pos;
+	if (pointer >= 0) {
+		data_buffer[buffer_pointer++] = 0xC0 | (pointer >> 8);
+		data_buffer[buffer_pointer++] = pointer & 0xFF;
+	} else {
+		data_buffer[buffer_pointer++] = '\0';  // End of qname.
+	}
 
 	return buffer_pointer - buffer_pointer_start;
 }
@@ -234,8 +502,9 @@ bool MDns::AddQuery(const Query &query) {
 	}
 
 	// Buffer increased by length of qname_buffer + a preceding length + zero termination
-	// + 4 bits of mDNS flags.
-	data_size += strlen(query.qname_buffer) + 6;
+	// + 4 bits of mDNS flags, as far as max_packet_size allows.
+	const unsigned int start = buffer_pointer;
+	data_size = reserve(strlen(query.qname_buffer) + 6);
 
 	// Create DNS name buffer from qname.
 	if (PopulateName(query.qname_buffer) == 0
@@ -244,6 +513,8 @@ bool MDns::AddQuery(const Query &query) {
 		if (debug)
 			debug->println(" ERROR. MDns::AddQuery overrun expected buffer space.");
 #endif
+		// Leave the packet as it was so it can still be sent.
+		buffer_pointer = data_size = start;
 		return false;
 	}
 	// The rest of the flags.
@@ -268,63 +539,131 @@ bool MDns::AddQuery(const Query &query) {
 	return true;
 }
 
-bool MDns::AddAnswer(const Answer &answer) {
-	if (ns_count || ar_count) {
+bool MDns::AddRawQuery(const byte *name, unsigned int name_length,
+		unsigned int qtype, unsigned int qclass) {
+	if (answer_count || ns_count || ar_count) {
 #ifdef DEBUG_OUTPUT
 		if (debug)
-			debug->println(" ERROR. NS or AR records added before Answer records");
+			debug->println(" ERROR. Resource records included before Queries.");
 #endif
 		return false;
 	}
 
-	data_size += strlen(answer.name_buffer) + 12;
-
-	// Create DNS name buffer from name.
-	if (PopulateName(answer.name_buffer) == 0
-			|| buffer_pointer + 10 > data_size) {
-#ifdef DEBUG_OUTPUT
-		if (debug)
-			debug->println(" ERROR. MDns::AddAnswer over-ran expected buffer space.");
-#endif
+	const unsigned int start = buffer_pointer;
+	data_size = reserve(name_length + 4);
+	if (PopulateWireName(name, name_length) == 0
+			|| buffer_pointer + 4 > data_size) {
+		buffer_pointer = data_size = start;
 		return false;
 	}
+	data_buffer[buffer_pointer++] = (qtype & 0xFF00) >> 8;
+	data_buffer[buffer_pointer++] = qtype & 0xFF;
+	data_buffer[buffer_pointer++] = (qclass & 0xFF00) >> 8;
+	data_buffer[buffer_pointer++] = qclass & 0xFF;
+	data_size = buffer_pointer;
 
-	data_buffer[buffer_pointer++] = (answer.rrtype & 0xFF00) >> 8;
-	data_buffer[buffer_pointer++] = answer.rrtype & 0xFF;
+	data_buffer[2] = 0;     // Query.
+	type = 1;
+	++query_count;
+	data_buffer[4] = (query_count & 0xFF00) >> 8;
+	data_buffer[5] = query_count & 0xFF;
+
+	return true;
+}
 
-	unsigned int rrclass = 0;
-	if (answer.rrset) {
-		rrclass = 0b1000000000000000;
+bool MDns::AddAnswer(const Answer &answer) {
+	if (!AddAnswerRecord(SECTION_ANSWER, answer)) {
+		return false;
 	}
-	rrclass += answer.rrclass;
-	data_buffer[buffer_pointer++] = (rrclass & 0xFF00) >> 8;
-	data_buffer[buffer_pointer++] = rrclass & 0xFF;
+	data_buffer[2] = 0b10000100;     // Answer & IQuery flags
+	return true;
+}
 
-	data_buffer[buffer_pointer++] = (answer.rrttl & 0xFF000000) >> 24;
-	data_buffer[buffer_pointer++] = (answer.rrttl & 0xFF0000) >> 16;
-	data_buffer[buffer_pointer++] = (answer.rrttl & 0xFF00) >> 8;
-	data_buffer[buffer_pointer++] = (answer.rrttl & 0xFF);
+bool MDns::AddAuthority(const Answer &answer) {
+	return AddAnswerRecord(SECTION_AUTHORITY, answer);
+}
+
+bool MDns::AddAdditional(const Answer &answer) {
+	return AddAnswerRecord(SECTION_ADDITIONAL, answer);
+}
 
-	const unsigned int rdata_len_p0 = buffer_pointer++;
-	const unsigned int rdata_len_p1 = buffer_pointer++;
-	unsigned int rdata_len = 0;
+// Encode the name and rdata of answer and add it to section. Only the rdata
+// of PTR and SRV records is built, in a single buffer; the rest is taken
+// from rdata_buffer as it is.
+bool MDns::AddAnswerRecord(Section section, const Answer &answer) {
+	byte name[MAX_MDNS_NAME_LEN];
+	byte buffer[6 + MAX_MDNS_NAME_LEN];
+	const byte * rdata = (const byte *) answer.rdata_buffer;
+	unsigned int rdlength = 0;
+	unsigned int rdata_name_offset = 0;
+	int target_length;
+	const int name_length = encodeDnsName(name, sizeof(name),
+			answer.name_buffer);
+	if (name_length < 0) {
+#ifdef DEBUG_OUTPUT
+		if (debug)
+			debug->println(" ERROR. MDns::AddAnswer invalid name.");
+#endif
+		return false;
+	}
 
 	switch (answer.rrtype) {
 	case MDNS_TYPE_A:  // Returns a 32-bit IPv4 address
-		if (buffer_pointer > data_size) {
-			return false;
+		if (answer.ipAddress != INADDR_NONE) {
+			for (int i = 0; i < 4; i++) {
+				buffer[i] = answer.ipAddress[i];
+			}
+			rdata = buffer;
+		}
+		rdlength = rdata_name_offset = 4;
+		break;
+	case MDNS_TYPE_AAAA:  // Returns a 128-bit IPv6 address.
+		for (int i = 0; i < 16; i++) {
+			if (answer.ipv6[i]) {
+				rdata = answer.ipv6;
+				break;
+			}
 		}
-		rdata_len = 4;
-		data_buffer[buffer_pointer++] = answer.rdata_buffer[0];
-		data_buffer[buffer_pointer++] = answer.rdata_buffer[1];
-		data_buffer[buffer_pointer++] = answer.rdata_buffer[2];
-		data_buffer[buffer_pointer++] = answer.rdata_buffer[3];
+		rdlength = rdata_name_offset = 16;
 		break;
 	case MDNS_TYPE_PTR:  // Pointer to a canonical name.
-		rdata_len = PopulateName(answer.rdata_buffer);
-		if (buffer_pointer >= data_size) {
+		target_length = encodeDnsName(buffer, MAX_MDNS_NAME_LEN,
+				answer.rdata_buffer);
+		if (target_length < 0) {
+			return false;
+		}
+		rdata = buffer;
+		rdlength = target_length;
+		break;
+	case MDNS_TYPE_SRV:  // Server Selection: port and host.
+		target_length = encodeDnsName(buffer + 6, MAX_MDNS_NAME_LEN,
+				answer.rdata_buffer);
+		if (target_length < 0) {
+			return false;
+		}
+		buffer[0] = answer.priority >> 8;
+		buffer[1] = answer.priority & 0xFF;
+		buffer[2] = answer.weight >> 8;
+		buffer[3] = answer.weight & 0xFF;
+		buffer[4] = answer.port >> 8;
+		buffer[5] = answer.port & 0xFF;
+		rdata = buffer;
+		rdlength = 6 + target_length;
+		rdata_name_offset = 6;
+		break;
+	case MDNS_TYPE_TXT:  // Strings, each preceded by its length.
+		// rdlength, as the strings may hold 0 bytes. Longer than rdata_buffer
+		// means it was cut short when received.
+		if (answer.rdlength >= MAX_MDNS_NAME_LEN) {
 			return false;
 		}
+		rdlength = rdata_name_offset = answer.rdlength;
+		if (rdlength == 0) {
+			// Still one empty string (RFC 6763 section 6.1).
+			buffer[0] = 0;
+			rdata = buffer;
+			rdlength = rdata_name_offset = 1;
+		}
 		break;
 	default:
 #ifdef DEBUG_OUTPUT
@@ -335,16 +674,121 @@ bool MDns::AddAnswer(const Answer &answer) {
 		return false;
 	}
 
-	data_buffer[rdata_len_p0] = (rdata_len & 0xFF00) >> 8;
-	data_buffer[rdata_len_p1] = rdata_len & 0xFF;
+	return AddRecord(section, name, name_length, answer.rrtype,
+			answer.rrclass | (answer.rrset ? 0x8000 : 0), answer.rrttl, rdata,
+			rdlength, rdata_name_offset);
+}
 
-	data_size = buffer_pointer;
+bool MDns::AddKnownAnswer(const CacheEntry &entry, unsigned long now) {
+	// Names in PTR and SRV rdata may be compressed too (RFC 6762 section 18.14).
+	unsigned int rdata_name_offset = entry.rdlength;
+	if (entry.rrtype == MDNS_TYPE_PTR) {
+		rdata_name_offset = 0;
+	} else if (entry.rrtype == MDNS_TYPE_SRV && entry.rdlength > 6) {
+		rdata_name_offset = 6;
+	}
+	// Flags are left alone: this is still a query.
+	return AddRecord(SECTION_ANSWER, entry.name, entry.name_length,
+			entry.rrtype, entry.rrclass, entry.remaining(now) / 1000,
+			entry.rdata, entry.rdlength, rdata_name_offset);
+}
 
-	// Since the data fitted in the buffer, it's ok to update the header.
+bool MDns::AddRawAnswer(const byte *name, unsigned int name_length,
+		unsigned int rrtype, unsigned int rrclass, unsigned long rrttl,
+		const byte *rdata, unsigned int rdlength,
+		unsigned int rdata_name_offset) {
+	if (!AddRecord(SECTION_ANSWER, name, name_length, rrtype, rrclass, rrttl,
+			rdata, rdlength, rdata_name_offset)) {
+		return false;
+	}
 	data_buffer[2] = 0b10000100;     // Answer & IQuery flags
-	answer_count++;
-	data_buffer[6] = (answer_count & 0xFF00) >> 8;
-	data_buffer[7] = answer_count & 0xFF;
+	return true;
+}
+
+bool MDns::AddRawAuthority(const byte *name, unsigned int name_length,
+		unsigned int rrtype, unsigned int rrclass, unsigned long rrttl,
+		const byte *rdata, unsigned int rdlength,
+		unsigned int rdata_name_offset) {
+	// Flags are left alone: a probe is a query.
+	return AddRecord(SECTION_AUTHORITY, name, name_length, rrtype, rrclass,
+			rrttl, rdata, rdlength, rdata_name_offset);
+}
+
+bool MDns::AddRawAdditional(const byte *name, unsigned int name_length,
+		unsigned int rrtype, unsigned int rrclass, unsigned long rrttl,
+		const byte *rdata, unsigned int rdlength,
+		unsigned int rdata_name_offset) {
+	return AddRecord(SECTION_ADDITIONAL, name, name_length, rrtype, rrclass,
+			rrttl, rdata, rdlength, rdata_name_offset);
+}
+
+bool MDns::AddRecord(Section section, const byte *name,
+		unsigned int name_length, unsigned int rrtype, unsigned int rrclass,
+		unsigned long rrttl, const byte *rdata, unsigned int rdlength,
+		unsigned int rdata_name_offset) {
+	// Sections follow each other in the packet.
+	if ((section == SECTION_ANSWER && (ns_count || ar_count))
+			|| (section == SECTION_AUTHORITY && ar_count)) {
+#ifdef DEBUG_OUTPUT
+		if (debug)
+			debug->println(" ERROR. Records added after those of a later section");
+#endif
+		return false;
+	}
+
+	// Name, 10 bytes of fixed fields and rdata. Names only get shorter with
+	// compression.
+	const unsigned int start = buffer_pointer;
+	data_size = reserve(name_length + 10 + rdlength);
+
+	if (PopulateWireName(name, name_length) == 0
+			|| buffer_pointer + 10 > data_size) {
+#ifdef DEBUG_OUTPUT
+		if (debug)
+			debug->println(" ERROR. MDns::AddRecord over-ran expected buffer space.");
+#endif
+		buffer_pointer = data_size = start;
+		return false;
+	}
+
+	data_buffer[buffer_pointer++] = (rrtype & 0xFF00) >> 8;
+	data_buffer[buffer_pointer++] = rrtype & 0xFF;
+	data_buffer[buffer_pointer++] = (rrclass & 0xFF00) >> 8;
+	data_buffer[buffer_pointer++] = rrclass & 0xFF;
+
+	data_buffer[buffer_pointer++] = (rrttl & 0xFF000000) >> 24;
+	data_buffer[buffer_pointer++] = (rrttl & 0xFF0000) >> 16;
+	data_buffer[buffer_pointer++] = (rrttl & 0xFF00) >> 8;
+	data_buffer[buffer_pointer++] = (rrttl & 0xFF);
+
+	const unsigned int rdata_len_p = buffer_pointer;
+	buffer_pointer += 2;
+
+	if (rdata_name_offset > rdlength) {
+		rdata_name_offset = rdlength;
+	}
+	memcpy(data_buffer + buffer_pointer, rdata, rdata_name_offset);
+	buffer_pointer += rdata_name_offset;
+	if (rdata_name_offset < rdlength
+			&& PopulateWireName(rdata + rdata_name_offset,
+					rdlength - rdata_name_offset) == 0) {
+		buffer_pointer = data_size = start;
+		return false;
+	}
+	const unsigned int rdata_len = buffer_pointer - rdata_len_p - 2;
+	data_buffer[rdata_len_p] = (rdata_len & 0xFF00) >> 8;
+	data_buffer[rdata_len_p + 1] = rdata_len & 0xFF;
+
+	data_size = buffer_pointer;
+
+	// Counts of the Answer, Authority and Additional sections follow each
+	// other in the header.
+	unsigned int &count = section == SECTION_ANSWER ? answer_count
+			: section == SECTION_AUTHORITY ? ns_count : ar_count;
+	const unsigned int header = 6 + 2 * (section - SECTION_ANSWER);
+	count++;
+	data_buffer[header] = (count & 0xFF00) >> 8;
+	data_buffer[header + 1] = count & 0xFF;
 
 	return true;
 }
@@ -360,12 +804,12 @@ void MDns::Send() const {
 	udp->endPacket();
 }
 
-void MDns::SendUnicast(IPAddress addr) const {
+void MDns::SendUnicast(IPAddress addr, uint16_t port) const {
 #ifdef DEBUG_OUTPUT
 	if (debug)
 		debug->println("Sending UDP unicast packet");
 #endif
-	udp->beginPacket(addr, MDNS_TARGET_PORT);
+	udp->beginPacket(addr, port);
 	udp->write(data_buffer, data_size);
 	udp->endPacket();
 }
@@ -390,92 +834,6 @@ void MDns::Display() const {
 	}
 }
 
-void MDns::Parse_Query(Query &query) {
-#ifdef DEBUG_OUTPUT
-	query.buffer_pointer = buffer_pointer;
-#endif
-
-	buffer_pointer = nameFromDnsPointer(query.qname_buffer, 0,
-			MAX_MDNS_NAME_LEN, data_buffer, buffer_pointer);
-
-	byte qtype_0 = data_buffer[buffer_pointer++];
-	byte qtype_1 = data_buffer[buffer_pointer++];
-	byte qclass_0 = data_buffer[buffer_pointer++];
-	byte qclass_1 = data_buffer[buffer_pointer++];
-
-	query.qtype = (qtype_0 << 8) + qtype_1;
-
-	query.unicast_response = (0b10000000 & qclass_0);
-	query.qclass = ((qclass_0 & 0b01111111) << 8) + qclass_1;
-
-	query.valid = true;
-
-	if (query.qclass != 0xFF && query.qclass != 0x01) {
-		// QCLASS is not ANY (0xFF) or INternet (0x01).
-#ifdef DEBUG_OUTPUT
-		if (debug) {
-			debug->print(" **ERROR QCLASS** ");
-			debug->println(query.qclass, HEX);
-		}
-#endif
-		query.valid = false;
-	}
-
-	if (buffer_pointer > data_size) {
-		// We've over-run the returned data.
-		// Something has gone wrong receiving or parsing the data.
-#ifdef DEBUG_OUTPUT
-		if (debug) {
-			debug->print(" **ERROR size** ");
-			debug->print(buffer_pointer, HEX);
-			debug->print(" ");
-			debug->println(data_size, HEX);
-		}
-#endif
-		query.valid = false;
-	}
-}
-
-void MDns::Parse_Answer(Answer &answer) {
-#ifdef DEBUG_OUTPUT
-	answer.buffer_pointer = buffer_pointer;
-#endif
-
-	buffer_pointer = nameFromDnsPointer(answer.name_buffer, 0,
-			MAX_MDNS_NAME_LEN, data_buffer, buffer_pointer);
-
-	answer.rrtype = (data_buffer[buffer_pointer++] << 8);
-	answer.rrtype += data_buffer[buffer_pointer++];
-
-	byte rrclass_0 = data_buffer[buffer_pointer++];
-	byte rrclass_1 = data_buffer[buffer_pointer++];
-	answer.rrset = (0b10000000 & rrclass_0);
-	answer.rrclass = ((rrclass_0 & 0b01111111) << 8) + rrclass_1;
-
-	answer.rrttl = (data_buffer[buffer_pointer++] << 24);
-	answer.rrttl += (data_buffer[buffer_pointer++] << 16);
-	answer.rrttl += (data_buffer[buffer_pointer++] << 8);
-	answer.rrttl += data_buffer[buffer_pointer++];
-
-	if (buffer_pointer > data_size) {
-		// We've over-run the returned data.
-		// Something has gone wrong receiving or parsing the data.
-#ifdef DEBUG_OUTPUT
-		if (debug) {
-			debug->print(" **ERROR size** ");
-			debug->print(buffer_pointer, HEX);
-			debug->print(" ");
-			debug->println(data_size, HEX);
-		}
-#endif
-		answer.valid = false;
-		return;
-	}
-	PopulateAnswerResult(&answer);
-
-	answer.valid = true;
-}
-
 // Display packet contents in HEX.
 void MDns::DisplayRawPacket() const {
 	// display the packet contents in HEX
@@ -511,92 +869,468 @@ void MDns::DisplayRawPacket() const {
 	}
 }
 
-void MDns::PopulateAnswerResult(Answer *answer) {
-	int rdlength = (data_buffer[buffer_pointer++] << 8);
-	rdlength += data_buffer[buffer_pointer++];
+static inline unsigned int readUint16(const byte *p) {
+	return (p[0] << 8) + p[1];
+}
+
+RecordIterator::RecordIterator(const byte *packet_, unsigned int packet_size_) :
+		packet(packet_), packet_size(packet_size_), position(12),
+		questions_left(0), answers_left(0), authority_left(0),
+		additional_left(0), error(false) {
+	if (packet_size < 12) {
+		error = true;
+		return;
+	}
+	questions_left = readUint16(packet + 4);
+	answers_left = readUint16(packet + 6);
+	authority_left = readUint16(packet + 8);
+	additional_left = readUint16(packet + 10);
+}
+
+bool RecordIterator::nextQuestion(QuestionView &question) {
+	if (error || questions_left == 0) {
+		return false;
+	}
+	questions_left--;
+
+	const int name_end = skipDnsName(packet, packet_size, position);
+	if (name_end < 0 || (unsigned int) name_end + 4 > packet_size) {
+		// We've over-run the returned data.
+		// Something has gone wrong receiving or parsing the data.
+		error = true;
+		return false;
+	}
+
+	question.packet = packet;
+	question.packet_size = packet_size;
+	question.name_offset = position;
+	question.qtype = readUint16(packet + name_end);
+	question.unicast_response = (0b10000000 & packet[name_end + 2]);
+	question.qclass = readUint16(packet + name_end + 2) & 0x7FFF;
+
+	position = name_end + 4;
+	return true;
+}
+
+bool RecordIterator::nextRecord(RecordView &record) {
+	QuestionView question;
+	while (nextQuestion(question)) {
+		// Skip the questions nobody asked for.
+	}
+	if (error) {
+		return false;
+	}
+
+	if (answers_left) {
+		answers_left--;
+		record.section = SECTION_ANSWER;
+	} else if (authority_left) {
+		authority_left--;
+		record.section = SECTION_AUTHORITY;
+	} else if (additional_left) {
+		additional_left--;
+		record.section = SECTION_ADDITIONAL;
+	} else {
+		return false;
+	}
+
+	const int name_end = skipDnsName(packet, packet_size, position);
+	if (name_end < 0 || (unsigned int) name_end + 10 > packet_size) {
+		error = true;
+		return false;
+	}
+	const byte *fields = packet + name_end;
+	const unsigned int rdlength = readUint16(fields + 8);
+	if (name_end + 10 + rdlength > packet_size) {
+		error = true;
+		return false;
+	}
+
+	record.packet = packet;
+	record.packet_size = packet_size;
+	record.name_offset = position;
+	record.rrtype = readUint16(fields);
+	record.rrset = (0b10000000 & fields[2]);
+	record.rrclass = readUint16(fields + 2) & 0x7FFF;
+	record.rrttl = ((unsigned long int) fields[4] << 24)
+			+ ((unsigned long int) fields[5] << 16)
+			+ ((unsigned long int) fields[6] << 8) + fields[7];
+	record.rdata_offset = name_end + 10;
+	record.rdlength = rdlength;
+
+	position = record.rdata_offset + rdlength;
+	return true;
+}
+
+bool QuestionView::getName(char *buffer, int buffer_len) const {
+	return decodeDnsName(buffer, 0, buffer_len, packet, packet_size,
+			name_offset) >= 0 && (int) strlen(buffer) < buffer_len - 1;
+}
+
+void QuestionView::toQuery(Query &query) const {
+#ifdef DEBUG_OUTPUT
+	query.buffer_pointer = name_offset;
+#endif
+	const int name_end = decodeDnsName(query.qname_buffer, 0,
+			MAX_MDNS_NAME_LEN, packet, packet_size, name_offset);
+	query.qtype = qtype;
+	query.qclass = qclass;
+	query.unicast_response = unicast_response;
+
+	// QCLASS must be ANY (0xFF) or INternet (0x01).
+	query.valid = name_end >= 0 && (qclass == 0xFF || qclass == 0x01);
+}
+
+bool RecordView::getName(char *buffer, int buffer_len) const {
+	return decodeDnsName(buffer, 0, buffer_len, packet, packet_size,
+			name_offset) >= 0 && (int) strlen(buffer) < buffer_len - 1;
+}
+
+bool RecordView::getRdataName(char *buffer, int buffer_len,
+		unsigned int offset) const {
+	if (offset >= rdlength) {
+		buffer[0] = '\0';
+		return false;
+	}
+	return decodeDnsName(buffer, 0, buffer_len, packet, packet_size,
+			rdata_offset + offset) >= 0 && (int) strlen(buffer) < buffer_len - 1;
+}
+
+IPAddress RecordView::getIPv4() const {
+	if (rdlength < 4) {
+		return INADDR_NONE;
+	}
+	const byte *rdata = packet + rdata_offset;
+	return IPAddress(rdata[0], rdata[1], rdata[2], rdata[3]);
+}
+
+bool RecordView::getIPv6(uint8_t address[16]) const {
+	if (rdlength < 16) {
+		return false;
+	}
+	memcpy(address, packet + rdata_offset, 16);
+	return true;
+}
+
+uint16_t RecordView::getSrvPort() const {
+	if (rdlength < 6) {
+		return 0;
+	}
+	return readUint16(packet + rdata_offset + 4);
+}
 
-	switch (answer->rrtype) {
+void RecordView::toAnswer(Answer &answer) const {
+#ifdef DEBUG_OUTPUT
+	answer.buffer_pointer = name_offset;
+#endif
+	answer.valid = decodeDnsName(answer.name_buffer, 0, MAX_MDNS_NAME_LEN,
+			packet, packet_size, name_offset) >= 0;
+	answer.rrtype = rrtype;
+	answer.rrclass = rrclass;
+	answer.rrttl = rrttl;
+	answer.rrset = rrset;
+	answer.rdlength = rdlength;
+
+	const byte * rdata = packet + rdata_offset;
+	switch (rrtype) {
+	case MDNS_TYPE_PTR:  // Pointer to a canonical name.
+		if (decodeDnsName(answer.rdata_buffer, 0, MAX_MDNS_NAME_LEN, packet,
+				packet_size, rdata_offset) < 0) {
+			answer.valid = false;
+		}
+		return;
+	case MDNS_TYPE_SRV:  // Server Selection.
+		answer.rdata_buffer[0] = '\0';
+		answer.priority = answer.weight = answer.port = 0;
+		answer.target_offset = 0;
+		if (rdlength >= 6) {
+			answer.priority = readUint16(rdata);
+			answer.weight = readUint16(rdata + 2);
+			answer.port = readUint16(rdata + 4);
+			answer.target_offset = rdata_offset + 6;
+			if (decodeDnsName(answer.rdata_buffer, 0, MAX_MDNS_NAME_LEN, packet,
+					packet_size, answer.target_offset) < 0) {
+				answer.valid = false;
+			}
+		}
+		return;
 	case MDNS_TYPE_A:  // Returns a 32-bit IPv4 address
-		if (MAX_MDNS_NAME_LEN >= 16) {
-			answer->ipAddress = IPAddress(
-					data_buffer[buffer_pointer],
-					data_buffer[buffer_pointer + 1],
-					data_buffer[buffer_pointer + 2],
-					data_buffer[buffer_pointer + 3]);
-			strcpy(answer->rdata_buffer, answer->ipAddress.get_address());
+		answer.ipAddress = getIPv4();
+		break;
+	case MDNS_TYPE_AAAA:  // Returns a 128-bit IPv6 address.
+		if (rdlength == 16) {
+			memcpy(answer.ipv6, rdata, 16);
 		} else {
-			sprintf(answer->rdata_buffer, "ipv4");
+			memset(answer.ipv6, 0, 16);
 		}
-		buffer_pointer += 4;
 		break;
-	case MDNS_TYPE_PTR:  // Pointer to a canonical name.
-		buffer_pointer = nameFromDnsPointer(answer->rdata_buffer, 0,
-				MAX_MDNS_NAME_LEN, data_buffer, buffer_pointer);
+	}
+
+	// Everything else, eg: TXT, is kept as it is. Only the first
+	// MAX_MDNS_NAME_LEN - 1 bytes fit.
+	const unsigned int length = rdlength < MAX_MDNS_NAME_LEN ?
+			rdlength : MAX_MDNS_NAME_LEN - 1;
+	memcpy(answer.rdata_buffer, rdata, length);
+	answer.rdata_buffer[length] = '\0';
+}
+
+// Longest TTL honoured, so TTLs in milliseconds fit an unsigned long. (7 days)
+#define MAX_CACHE_TTL 604800UL
+
+unsigned long CacheEntry::remaining(unsigned long now) const {
+	const unsigned long age = now - received;
+	const unsigned long lifetime = rrttl * 1000;
+	return age < lifetime ? lifetime - age : 0;
+}
+
+bool CacheEntry::getName(char *buffer, int buffer_len) const {
+	return decodeDnsName(buffer, 0, buffer_len, name, name_length, 0) >= 0
+			&& (int) strlen(buffer) < buffer_len - 1;
+}
+
+bool CacheEntry::getRdataName(char *buffer, int buffer_len,
+		unsigned int offset) const {
+	if (offset >= rdlength) {
+		buffer[0] = '\0';
+		return false;
+	}
+	return decodeDnsName(buffer, 0, buffer_len, rdata, rdlength, offset) >= 0
+			&& (int) strlen(buffer) < buffer_len - 1;
+}
+
+IPAddress CacheEntry::getIPv4() const {
+	if (rdlength < 4) {
+		return INADDR_NONE;
+	}
+	return IPAddress(rdata[0], rdata[1], rdata[2], rdata[3]);
+}
+
+bool CacheEntry::getIPv6(uint8_t address[16]) const {
+	if (rdlength < 16) {
+		return false;
+	}
+	memcpy(address, rdata, 16);
+	return true;
+}
+
+uint16_t CacheEntry::getSrvPort() const {
+	if (rdlength < 6) {
+		return 0;
+	}
+	return readUint16(rdata + 4);
+}
+
+// Length of the leading strings of TXT rdata which fit in limit bytes.
+static unsigned int txtFit(const byte *txt, unsigned int length,
+		unsigned int limit) {
+	if (length <= limit) {
+		return length;
+	}
+	unsigned int fit = 0;
+	while (fit + 1 + txt[fit] <= limit) {
+		fit += 1 + txt[fit];
+	}
+	return fit;
+}
+
+RecordCache::RecordCache(CacheEntry *entries_, unsigned int capacity_) :
+		entries(entries_), capacity(capacity_) {
+	clear();
+}
+
+void RecordCache::clear() {
+	for (unsigned int i = 0; i < capacity; i++) {
+		entries[i].rrttl = 0;
+	}
+}
+
+void RecordCache::insert(const RecordView &record, unsigned long now) {
+	if (capacity == 0) {
+		return;
+	}
+
+	// Copy the rdata with any names in it expanded, so the entry doesn't
+	// depend on the packet it came from.
+	byte rdata[MDNS_CACHE_RDATA_SIZE];
+	int rdlength;
+	bool truncated = false;
+	switch (record.rrtype) {
+	case MDNS_TYPE_PTR:
+		rdlength = copyDnsName(rdata, MDNS_CACHE_RDATA_LEN, record.packet,
+				record.packet_size, record.rdata_offset);
 		break;
-	case MDNS_TYPE_HINFO:  // HINFO. host information
-		buffer_pointer = parseText(answer->rdata_buffer, MAX_MDNS_NAME_LEN,
-				rdlength, data_buffer, buffer_pointer);
+	case MDNS_TYPE_SRV:
+		if (record.rdlength < 6) {
+			return;
+		}
+		memcpy(rdata, record.packet + record.rdata_offset, 6);
+		rdlength = copyDnsName(rdata + 6, MDNS_CACHE_RDATA_LEN - 6,
+				record.packet, record.packet_size, record.rdata_offset + 6);
+		if (rdlength >= 0) {
+			rdlength += 6;
+		}
 		break;
-	case MDNS_TYPE_TXT: // Originally for arbitrary human-readable text in a DNS record.
-		// We only return the first MAX_MDNS_NAME_LEN bytes of this record type.
-		buffer_pointer = parseText(answer->rdata_buffer, MAX_MDNS_NAME_LEN,
-				rdlength, data_buffer, buffer_pointer);
+	case MDNS_TYPE_A:
+	case MDNS_TYPE_AAAA:
+		if (record.rdlength > MDNS_CACHE_RDATA_LEN) {
+			return;
+		}
+		rdlength = record.rdlength;
+		memcpy(rdata, record.packet + record.rdata_offset, rdlength);
 		break;
-	case MDNS_TYPE_AAAA:  // Returns a 128-bit IPv6 address.
-		{
-			int buffer_pos = 0;
-			for (int i = 0; i < rdlength; i++) {
-				if (buffer_pos < MAX_MDNS_NAME_LEN - 3) {
-					sprintf(answer->rdata_buffer + buffer_pos, "%02X:",
-							data_buffer[buffer_pointer++]);
-				} else {
-					buffer_pointer++;
-				}
-				buffer_pos += 3;
+	case MDNS_TYPE_TXT:
+		rdlength = txtFit(record.packet + record.rdata_offset, record.rdlength,
+				MDNS_CACHE_TXT_LEN);
+		truncated = (unsigned int) rdlength < record.rdlength;
+		memcpy(rdata, record.packet + record.rdata_offset, rdlength);
+		break;
+	default:
+		return;
+	}
+	if (rdlength < 0) {
+		return;
+	}
+
+	// Likewise the name, before any entry is touched: a record which can't be
+	// stored must not evict one.
+	byte name[MDNS_CACHE_NAME_LEN];
+	const int name_length = copyDnsName(name, MDNS_CACHE_NAME_LEN,
+			record.packet, record.packet_size, record.name_offset);
+	if (name_length < 0) {
+		return;
+	}
+
+	const uint32_t hash = hashDnsName(record.packet, record.packet_size,
+			record.name_offset);
+	CacheEntry *same = NULL;
+	CacheEntry *slot = NULL;
+	CacheEntry *oldest = &entries[0];
+	unsigned long oldest_remaining = (unsigned long) -1;
+
+	for (unsigned int i = 0; i < capacity; i++) {
+		CacheEntry &entry = entries[i];
+		const unsigned long remaining = entry.remaining(now);
+		if (remaining == 0) {
+			entry.rrttl = 0;
+			if (!slot) {
+				slot = &entry;
 			}
-			answer->rdata_buffer[--buffer_pos] = '\0';  // Remove trailing ':'
+			continue;
 		}
-		break;
-	case MDNS_TYPE_SRV:  // Server Selection.
-		{
-			unsigned int priority = (data_buffer[buffer_pointer++] << 8);
-			priority += data_buffer[buffer_pointer++];
-			unsigned int weight = (data_buffer[buffer_pointer++] << 8);
-			weight += data_buffer[buffer_pointer++];
-			unsigned int port = (data_buffer[buffer_pointer++] << 8);
-			port += data_buffer[buffer_pointer++];
-			sprintf(answer->rdata_buffer, "p=%d;w=%d;port=%d;host=", priority,
-					weight, port);
-			answer->port = port;
-
-			buffer_pointer = nameFromDnsPointer(answer->rdata_buffer,
-					strlen(answer->rdata_buffer),
-					MAX_MDNS_NAME_LEN - strlen(answer->rdata_buffer) - 1,
-					data_buffer, buffer_pointer);
+		if (entry.name_hash != hash || entry.rrtype != record.rrtype
+				|| entry.rrclass != record.rrclass
+				|| !dnsNameEquals(record.packet, record.packet_size,
+						record.name_offset, entry.name)) {
+			if (remaining < oldest_remaining) {
+				oldest = &entry;
+				oldest_remaining = remaining;
+			}
+			continue;
 		}
-		break;
-	default: {
-		int buffer_pos = 0;
-		for (int i = 0; i < rdlength; i++) {
-			if (buffer_pos < MAX_MDNS_NAME_LEN - 3) {
-				sprintf(answer->rdata_buffer + buffer_pos, "%02X ",
-						data_buffer[buffer_pointer++]);
-			} else {
-				buffer_pointer++;
+
+		if (entry.rdlength == rdlength && entry.truncated == truncated
+				&& memcmp(entry.rdata, rdata, rdlength) == 0) {
+			same = &entry;
+			continue;
+		}
+		if (record.rrset && record.rrttl != 0 && now - entry.received > 1000) {
+			// Cache flush: the sender owns this RRset, so records of it not
+			// re-announced in the last second are stale.
+			entry.rrttl = 0;
+			if (!slot) {
+				slot = &entry;
 			}
-			buffer_pos += 3;
+		} else if (remaining < oldest_remaining) {
+			oldest = &entry;
+			oldest_remaining = remaining;
 		}
 	}
-		break;
+
+	if (same) {
+		if (record.rrttl == 0) {
+			// Goodbye packet.
+			same->rrttl = 0;
+		} else {
+			// Refresh the record we already have.
+			same->received = now;
+			same->rrttl = record.rrttl < MAX_CACHE_TTL ?
+					record.rrttl : MAX_CACHE_TTL;
+		}
+		return;
 	}
+	if (record.rrttl == 0) {
+		// Goodbye for a record we never had.
+		return;
+	}
+
+	if (!slot) {
+		slot = oldest;
+	}
+	memcpy(slot->name, name, name_length);
+	slot->name_length = name_length;
+	slot->name_hash = hash;
+	slot->rrtype = record.rrtype;
+	slot->rrclass = record.rrclass;
+	slot->rdlength = rdlength;
+	slot->truncated = truncated;
+	memcpy(slot->rdata, rdata, rdlength);
+	slot->received = now;
+	slot->rrttl = record.rrttl < MAX_CACHE_TTL ? record.rrttl : MAX_CACHE_TTL;
 }
 
-IPAddress MDns::getRemoteIP() {
+const CacheEntry * RecordCache::find(const DnsName &name, unsigned int rrtype,
+		unsigned long now, const CacheEntry *after,
+		unsigned int rrclass) const {
+	if (name.empty()) {
+		return NULL;
+	}
+	return find(name.getWire(), rrtype, now, after, rrclass);
+}
+
+const CacheEntry * RecordCache::find(const byte *wire_name,
+		unsigned int rrtype, unsigned long now, const CacheEntry *after,
+		unsigned int rrclass) const {
+	const uint32_t hash = hashDnsName(wire_name, MAX_MDNS_NAME_LEN, 0);
+	unsigned int i = after ? (after - entries) + 1 : 0;
+	for (; i < capacity; i++) {
+		const CacheEntry &entry = entries[i];
+		if (entry.name_hash == hash && entry.rrtype == rrtype
+				&& entry.rrclass == rrclass && entry.remaining(now) > 0
+				&& dnsNameEquals(entry.name, entry.name_length, 0, wire_name)) {
+			return &entry;
+		}
+	}
+	return NULL;
+}
+
+void Callback::onQuestion(const QuestionView &question) {
+	Query query;
+	question.toQuery(query);
+	if (query.valid) {
+		onQuery(&query);
+	}
+}
+
+void Callback::onRecord(const RecordView &record) {
+	Answer answer;
+	record.toAnswer(answer);
+	if (answer.valid) {
+		onAnswer(&answer);
+	}
+}
+
+IPAddress MDns::getRemoteIP() const {
 	return srcIP;
 }
 
 MDns::~MDns() {
 	udp->stop();
+	if (owns_buffer) {
+		delete[] data_buffer;
+	}
+	if (owns_cache) {
+		delete[] cache_entries;
+	}
 }
 ;
 
@@ -612,64 +1346,345 @@ bool writeToBuffer(const byte value, char *p_name_buffer,
 	return false;
 }
 
+int skipDnsName(const byte *p_packet_buffer, int packet_size,
+		int packet_buffer_pos) {
+	int wire_len = 0;
+	while (packet_buffer_pos < packet_size) {
+		const byte word_len = p_packet_buffer[packet_buffer_pos];
+		if (word_len == 0) {
+			// End of string.
+			return packet_buffer_pos + 1;
+		}
+		if ((word_len & 0xC0) == 0xC0) {
+			// Message Compression used. The name ends with this 2 byte pointer.
+			return packet_buffer_pos + 2 <= packet_size ?
+					packet_buffer_pos + 2 : -1;
+		}
+		if (word_len & 0xC0) {
+			// Reserved label types.
+			return -1;
+		}
+		wire_len += word_len + 1;
+		if (wire_len >= MAX_DNS_NAME_WIRE_LEN) {
+			return -1;
+		}
+		packet_buffer_pos += word_len + 1;
+	}
+	return -1;
+}
+
+// ASCII only lower casing, as RFC 6762 requires for name comparison.
+static inline byte dnsToLower(const byte c) {
+	return (c >= 'A' && c <= 'Z') ? c + ('a' - 'A') : c;
+}
+
+static inline uint32_t dnsHashByte(uint32_t hash, const byte c) {
+	// FNV-1a
+	return (hash ^ c) * 16777619UL;
+}
+
+#define DNS_HASH_SEED 2166136261UL
+
+// Follow compression pointers from *p_packet_buffer_pos until it lands on a
+// label. Returns false if the name runs past packet_size or loops.
+static bool resolveLabel(const byte *p_packet_buffer, int packet_size,
+		int *p_packet_buffer_pos, int *p_jumps) {
+	while (*p_packet_buffer_pos < packet_size) {
+		const byte word_len = p_packet_buffer[*p_packet_buffer_pos];
+		if ((word_len & 0xC0) == 0) {
+			return *p_packet_buffer_pos + 1 + word_len <= packet_size;
+		}
+		if ((word_len & 0xC0) != 0xC0
+				|| *p_packet_buffer_pos + 1 >= packet_size
+				|| ++(*p_jumps) > MAX_MDNS_NAME_JUMPS) {
+			return false;
+		}
+		*p_packet_buffer_pos = ((word_len & 0x3F) << 8)
+				+ p_packet_buffer[*p_packet_buffer_pos + 1];
+	}
+	return false;
+}
+
+bool dnsNameEquals(const byte *p_packet_buffer, int packet_size,
+		int packet_buffer_pos, const byte *wire_name) {
+	int jumps = 0;
+	while (resolveLabel(p_packet_buffer, packet_size, &packet_buffer_pos,
+			&jumps)) {
+		const byte word_len = p_packet_buffer[packet_buffer_pos];
+		if (word_len != *wire_name) {
+			return false;
+		}
+		if (word_len == 0) {
+			return true;
+		}
+		for (int l = 1; l <= word_len; l++) {
+			if (dnsToLower(p_packet_buffer[packet_buffer_pos + l])
+					!= dnsToLower(wire_name[l])) {
+				return false;
+			}
+		}
+		packet_buffer_pos += word_len + 1;
+		wire_name += word_len + 1;
+	}
+	return false;
+}
+
+bool dnsNameEquals(const byte *p_packet_buffer, int packet_size,
+		int packet_buffer_pos, const char *name) {
+	int jumps = 0;
+	while (resolveLabel(p_packet_buffer, packet_size, &packet_buffer_pos,
+			&jumps)) {
+		const byte word_len = p_packet_buffer[packet_buffer_pos++];
+		if (word_len == 0) {
+			return *name == '\0';
+		}
+		for (int l = 0; l < word_len; l++) {
+			if (name[l] == '\0'
+					|| dnsToLower(name[l])
+							!= dnsToLower(p_packet_buffer[packet_buffer_pos + l])) {
+				return false;
+			}
+		}
+		name += word_len;
+		if (*name == '.') {
+			name++;
+		} else if (*name != '\0') {
+			return false;
+		}
+		packet_buffer_pos += word_len;
+	}
+	return false;
+}
+
+uint32_t hashDnsName(const byte *p_packet_buffer, int packet_size,
+		int packet_buffer_pos) {
+	uint32_t hash = DNS_HASH_SEED;
+	int jumps = 0;
+	int wire_len = 0;
+	while (resolveLabel(p_packet_buffer, packet_size, &packet_buffer_pos,
+			&jumps)) {
+		const byte word_len = p_packet_buffer[packet_buffer_pos++];
+		hash = dnsHashByte(hash, word_len);
+		if (word_len == 0) {
+			return hash;
+		}
+		wire_len += word_len + 1;
+		if (wire_len >= MAX_DNS_NAME_WIRE_LEN) {
+			return 0;
+		}
+		for (int l = 0; l < word_len; l++) {
+			hash = dnsHashByte(hash,
+					dnsToLower(p_packet_buffer[packet_buffer_pos++]));
+		}
+	}
+	return 0;
+}
+
+int copyDnsName(byte *wire_name, const int wire_name_len,
+		const byte *p_packet_buffer, const int packet_size,
+		int packet_buffer_pos) {
+	int length = 0;
+	int jumps = 0;
+	while (resolveLabel(p_packet_buffer, packet_size, &packet_buffer_pos,
+			&jumps)) {
+		const byte word_len = p_packet_buffer[packet_buffer_pos];
+		if (length + word_len + 1 > wire_name_len) {
+			return -1;
+		}
+		memcpy(wire_name + length, p_packet_buffer + packet_buffer_pos,
+				word_len + 1);
+		length += word_len + 1;
+		if (word_len == 0) {
+			return length;
+		}
+		packet_buffer_pos += word_len + 1;
+	}
+	return -1;
+}
+
+int encodeDnsName(byte *wire_name, const int wire_name_len,
+		const char *name) {
+	int pos = 0;
+	while (*name != '\0') {
+		const char *word_end = strchr(name, '.');
+		const int word_len = word_end ? word_end - name : strlen(name);
+		if (word_len == 0 || word_len > 63
+				|| pos + word_len + 2 > wire_name_len - 1) {
+			// Empty or oversized label, or the name is too long.
+			return -1;
+		}
+		wire_name[pos++] = word_len;
+		memcpy(wire_name + pos, name, word_len);
+		pos += word_len;
+		name += word_len;
+		if (*name == '.') {
+			name++;
+		}
+	}
+	wire_name[pos++] = 0;
+	return pos;
+}
+
+bool DnsName::set(const char *name) {
+	clear();
+	const int encoded = encodeDnsName(wire, MAX_MDNS_NAME_LEN, name);
+	if (encoded < 0) {
+		return false;
+	}
+	length = encoded;
+	hash = hashDnsName(wire, length, 0);
+	return true;
+}
+
+bool DnsName::matches(const byte *packet, unsigned int packet_size,
+		unsigned int offset) const {
+	return length != 0 && dnsNameEquals(packet, packet_size, offset, wire);
+}
+
+bool TxtEntry::keyEquals(const char *name) const {
+	unsigned int i = 0;
+	for (; i < key_length; i++) {
+		if (name[i] == '\0' || dnsToLower(key[i]) != dnsToLower(name[i])) {
+			return false;
+		}
+	}
+	return name[i] == '\0';
+}
+
+bool TxtEntry::getValue(char *buffer, int buffer_len) const {
+	if (buffer_len <= 0) {
+		return false;
+	}
+	const unsigned int length = value_length < (unsigned int) buffer_len ?
+			value_length : buffer_len - 1;
+	if (value) {
+		memcpy(buffer, value, length);
+	}
+	buffer[value ? length : 0] = '\0';
+	return value && length == value_length;
+}
+
+bool TxtIterator::next(TxtEntry &entry) {
+	while (position < rdlength) {
+		const unsigned int length = rdata[position];
+		const char *text = (const char*) rdata + position + 1;
+		if (length >= rdlength - position) {
+			// Overruns the rdata.
+			position = rdlength;
+			return false;
+		}
+		position += 1 + length;
+		const char *equals = (const char*) memchr(text, '=', length);
+		if (length == 0 || equals == text) {
+			continue;
+		}
+		entry.key = text;
+		if (equals) {
+			entry.key_length = equals - text;
+			entry.value = equals + 1;
+			entry.value_length = length - entry.key_length - 1;
+		} else {
+			entry.key_length = length;
+			entry.value = NULL;
+			entry.value_length = 0;
+		}
+		return true;
+	}
+	return false;
+}
+
+bool TxtIterator::find(const char *key, TxtEntry &entry) const {
+	TxtIterator it(rdata, rdlength);
+	while (it.next(entry)) {
+		if (entry.keyEquals(key)) {
+			return true;
+		}
+	}
+	return false;
+}
+
 int parseText(char *data_buffer, const int data_buffer_len, const int data_len,
 		const byte *p_packet_buffer, int packet_buffer_pos) {
 	int i, data_buffer_pos = 0;
+	data_buffer[0] = '\0';
 	for (i = 0; i < data_len; i++) {
+		// writeToBuffer() keeps data_buffer terminated and stops at data_buffer_len.
 		writeToBuffer(p_packet_buffer[packet_buffer_pos++], data_buffer,
 				&data_buffer_pos, data_buffer_len);
 	}
-	data_buffer[data_buffer_pos] = '\0';
 	return packet_buffer_pos;
 }
 
-int nameFromDnsPointer(char *p_name_buffer, int name_buffer_pos,
-		const int name_buffer_len, const byte *p_packet_buffer,
-		int packet_buffer_pos) {
-	return nameFromDnsPointer(p_name_buffer, name_buffer_pos, name_buffer_len,
-			p_packet_buffer, packet_buffer_pos, false);
-}
-
-int nameFromDnsPointer(char *p_name_buffer, int name_buffer_pos,
+int decodeDnsName(char *p_name_buffer, int name_buffer_pos,
 		const int name_buffer_len, const byte *p_packet_buffer,
-		int packet_buffer_pos, const bool recurse) {
-	if (recurse) {
-		// Since we are adding more to an already populated buffer,
-		// replace the trailing EOL with the FQDN seperator.
-		name_buffer_pos--;
-		writeToBuffer('.', p_name_buffer, &name_buffer_pos, name_buffer_len);
+		const int packet_size, int packet_buffer_pos) {
+	// Position following the name, known once the first pointer is seen.
+	int name_end = -1;
+	int jumps = 0;
+	int wire_len = 0;
+	bool first_word = true;
+
+	if (name_buffer_pos < name_buffer_len) {
+		p_name_buffer[name_buffer_pos] = '\0';
 	}
 
-	if (p_packet_buffer[packet_buffer_pos] < 0xC0) {
-		// Since the first 2 bits are not set,
-		// this is the start of a name section.
-		// http://www.tcpipguide.com/free/t_DNSNameNotationandMessageCompressionTechnique.htm
-
-		const int word_len = p_packet_buffer[packet_buffer_pos++];
-		for (int l = 0; l < word_len; l++) {
-			writeToBuffer(*(p_packet_buffer + packet_buffer_pos++),
-					p_name_buffer, &name_buffer_pos, name_buffer_len);
+	while (true) {
+		if (packet_buffer_pos < 0 || packet_buffer_pos >= packet_size) {
+			return -1;
+		}
+		const byte word_len = p_packet_buffer[packet_buffer_pos];
+
+		if ((word_len & 0xC0) == 0xC0) {
+			// Message Compression used. Next 2 bytes are a pointer to the actual name section.
+			// http://www.tcpipguide.com/free/t_DNSNameNotationandMessageCompressionTechnique.htm
+			if (packet_buffer_pos + 1 >= packet_size
+					|| ++jumps > MAX_MDNS_NAME_JUMPS) {
+				return -1;
+			}
+			if (name_end < 0) {
+				name_end = packet_buffer_pos + 2;
+			}
+			packet_buffer_pos = ((word_len & 0x3F) << 8)
+					+ p_packet_buffer[packet_buffer_pos + 1];
+			continue;
+		}
+		if (word_len & 0xC0) {
+			// Reserved label types.
+			return -1;
 		}
 
-		writeToBuffer('\0', p_name_buffer, &name_buffer_pos, name_buffer_len);
+		packet_buffer_pos++;
+		wire_len += word_len + 1;
+		if (word_len == 0) {
+			// End of string.
+			break;
+		}
+		if (packet_buffer_pos + word_len > packet_size
+				|| wire_len >= MAX_MDNS_NAME_LEN) {
+			return -1;
+		}
 
-		if (p_packet_buffer[packet_buffer_pos] > 0) {
+		if (!first_word) {
 			// Next word.
-			packet_buffer_pos = nameFromDnsPointer(p_name_buffer,
-					name_buffer_pos, name_buffer_len, p_packet_buffer,
-					packet_buffer_pos, true);
-		} else {
-			// End of string.
-			packet_buffer_pos++;
+			writeToBuffer('.', p_name_buffer, &name_buffer_pos,
+					name_buffer_len);
+		}
+		first_word = false;
+		for (int l = 0; l < word_len; l++) {
+			writeToBuffer(p_packet_buffer[packet_buffer_pos++], p_name_buffer,
+					&name_buffer_pos, name_buffer_len);
 		}
-	} else {
-		// Message Compression used. Next 2 bytes are a pointer to the actual name section.
-		int pointer = (p_packet_buffer[packet_buffer_pos++] - 0xC0) << 8;
-		pointer += p_packet_buffer[packet_buffer_pos++];
-		nameFromDnsPointer(p_name_buffer, name_buffer_pos, name_buffer_len,
-				p_packet_buffer, pointer, false);
 	}
-	return packet_buffer_pos;
+
+	return name_end < 0 ? packet_buffer_pos : name_end;
+}
+
+int nameFromDnsPointer(char *p_name_buffer, int name_buffer_pos,
+		const int name_buffer_len, const byte *p_packet_buffer,
+		int packet_buffer_pos) {
+	// A compression pointer can't reach further than 0x3FFF, plus one label.
+	return decodeDnsName(p_name_buffer, name_buffer_pos, name_buffer_len,
+			p_packet_buffer, 0x4000 + 64, packet_buffer_pos);
 }
 
 void Query::Display(Print * debug) const {
@@ -712,7 +1727,58 @@ void Answer::Display(Print * debug) const {
 		debug->print("      RRSET: ");
 		debug->println(rrset);
 		debug->print(" RRDATA:    ");
-		debug->println(rdata_buffer);
+
+		char text[8];
+		switch (rrtype) {
+		case MDNS_TYPE_A:
+			debug->println(ipAddress);
+			break;
+		case MDNS_TYPE_SRV:
+			debug->print("p=");
+			debug->print(priority);
+			debug->print(";w=");
+			debug->print(weight);
+			debug->print(";port=");
+			debug->print(port);
+			debug->print(";host=");
+			debug->println(rdata_buffer);
+			break;
+		case MDNS_TYPE_PTR:
+		case MDNS_TYPE_HINFO:
+			debug->println(rdata_buffer);
+			break;
+		case MDNS_TYPE_TXT: {
+			TxtIterator txt((const byte*) rdata_buffer,
+					rdlength < MAX_MDNS_NAME_LEN ? rdlength : MAX_MDNS_NAME_LEN - 1);
+			TxtEntry entry;
+			while (txt.next(entry)) {
+				debug->write((const uint8_t*) entry.key, entry.key_length);
+				if (entry.value) {
+					debug->print('=');
+					debug->write((const uint8_t*) entry.value, entry.value_length);
+				}
+				debug->print(';');
+			}
+			debug->println();
+		}
+			break;
+		case MDNS_TYPE_AAAA:
+			for (unsigned int i = 0; i < 16; i += 2) {
+				snprintf(text, sizeof(text), i < 14 ? "%x:" : "%x",
+						(ipv6[i] << 8) | ipv6[i + 1]);
+				debug->print(text);
+			}
+			debug->println();
+			break;
+		default:
+			for (unsigned int i = 0; i < rdlength and i < MAX_MDNS_NAME_LEN - 1;
+					i++) {
+				snprintf(text, sizeof(text), "%02X ", (byte) rdata_buffer[i]);
+				debug->print(text);
+			}
+			debug->println();
+			break;
+		}
 	}
 }
 
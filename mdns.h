@@ -26,7 +26,53 @@
 #define MAX_PACKET_SIZE 1024
 
 // The mDNS spec says this should never be more than 256 (including trailing '\0').
-#define MAX_MDNS_NAME_LEN 256  
+// Sizes the names of every Query, Answer and DnsName; builds which only deal
+// with short names can make it smaller.
+#ifndef MAX_MDNS_NAME_LEN
+#define MAX_MDNS_NAME_LEN 256
+#endif
+
+// Longest name the protocol allows, in wire format with its terminating zero
+// (RFC 1035 section 3.1). A packet carrying a longer name is malformed.
+#define MAX_DNS_NAME_WIRE_LEN 255
+
+// Maximum number of compression pointers followed while reading one name.
+// A name can't have more labels than this, so a longer chain must be a loop.
+#define MAX_MDNS_NAME_JUMPS 127
+
+// Number of name suffixes remembered for compression while building a packet.
+#ifndef MDNS_COMPRESSION_ENTRIES
+#define MDNS_COMPRESSION_ENTRIES 16
+#endif
+
+// Number of resource records MDns keeps in its cache. 0 disables the cache.
+#ifndef MDNS_CACHE_ENTRIES
+#define MDNS_CACHE_ENTRIES 16
+#endif
+
+// Number of subscriptions, by type and name, MDns can hold for its
+// listeners. See MDns::subscribe().
+#ifndef MDNS_SUBSCRIPTIONS
+#define MDNS_SUBSCRIPTIONS 8
+#endif
+
+// Longest name and rdata, uncompressed, a cache entry can hold.
+// Records which don't fit are not cached.
+#ifndef MDNS_CACHE_NAME_LEN
+#define MDNS_CACHE_NAME_LEN 64
+#endif
+#ifndef MDNS_CACHE_RDATA_LEN
+#define MDNS_CACHE_RDATA_LEN 64
+#endif
+
+// Longest TXT rdata a cache entry can hold. A longer TXT record keeps as many
+// of its leading strings as fit and is marked truncated. Above
+// MDNS_CACHE_RDATA_LEN every cache entry grows to hold it.
+#ifndef MDNS_CACHE_TXT_LEN
+#define MDNS_CACHE_TXT_LEN MDNS_CACHE_RDATA_LEN
+#endif
+#define MDNS_CACHE_RDATA_SIZE (MDNS_CACHE_TXT_LEN > MDNS_CACHE_RDATA_LEN ? \
+		MDNS_CACHE_TXT_LEN : MDNS_CACHE_RDATA_LEN)
 
 namespace mdns {
 
@@ -50,19 +96,311 @@ typedef struct Answer {
 	unsigned int buffer_pointer; // Position of Answer in packet. (Used for debugging only.)
 #endif
 	char name_buffer[MAX_MDNS_NAME_LEN];  // object, domain or zone name.
-	char rdata_buffer[MAX_MDNS_NAME_LEN]; // The data portion of the resource record.
+	// The data portion of the resource record: the dotted name of a PTR
+	// record or the target of an SRV record, otherwise the rdata as it is in
+	// the packet, eg: the 4 bytes of an A record. Always '\0' terminated.
+	char rdata_buffer[MAX_MDNS_NAME_LEN];
 	unsigned int rrtype;                  // ResourceRecord Type.
 	unsigned int rrclass; // ResourceRecord Class: Normally the value 1 for Internet (“IN”)
 	unsigned long int rrttl; // ResourceRecord Time To Live: Number of seconds ths should be remembered.
 	bool rrset;                    // Flush cache of records matching this name.
 	bool valid;           // False if problems were encountered decoding packet.
-	IPAddress ipAddress = INADDR_NONE;
-	uint16_t port = 0;
+	unsigned int rdlength = 0;            // Length of the rdata in the packet;
+	                                      // of the TXT rdata for AddAnswer().
+
+	// Decoded rdata, by type. Text is only made of them by Display().
+	IPAddress ipAddress = INADDR_NONE;    // A: the address.
+	uint8_t ipv6[16] = { 0 };             // AAAA: the address.
+	uint16_t priority = 0;                // SRV
+	uint16_t weight = 0;                  // SRV
+	uint16_t port = 0;                    // SRV
+	unsigned int target_offset = 0;       // SRV: position of the target in the packet.
 	void Display(Print * debug) const;    // Display a summary of this Answer on Serial port.
 } Answer;
 
 class MDns;
 
+// A name encoded once in DNS wire format (length prefixed labels) so it can be
+// compared against the names in incoming packets without expanding them.
+// Comparison is case-insensitive for ASCII, as required by RFC 6762.
+class DnsName {
+public:
+	DnsName() : length(0), hash(0) {}
+	explicit DnsName(const char *name) : length(0), hash(0) {
+		set(name);
+	}
+
+	// Encode a dotted name, eg: "twinkle.local".
+	// Returns false, leaving the DnsName empty, if the name is not valid.
+	bool set(const char *name);
+
+	void clear() {
+		length = 0;
+		hash = 0;
+	}
+
+	bool empty() const {
+		return length == 0;
+	}
+
+	// The encoded name, terminated by a zero length label.
+	const byte * getWire() const {
+		return wire;
+	}
+
+	// Length of the encoded name including the terminating zero.
+	unsigned int getLength() const {
+		return length;
+	}
+
+	// Precomputed hashDnsName() of this name. Names with different hashes
+	// can't be equal, so comparing hashes is a cheap first test.
+	uint32_t getHash() const {
+		return hash;
+	}
+
+	// Compare with the (possibly compressed) name at offset in packet.
+	bool matches(const byte *packet, unsigned int packet_size,
+			unsigned int offset) const;
+
+private:
+	byte wire[MAX_MDNS_NAME_LEN];
+	unsigned int length;
+	uint32_t hash;
+};
+
+// Section of the packet a question or resource record was found in.
+enum Section {
+	SECTION_QUESTION,
+	SECTION_ANSWER,
+	SECTION_AUTHORITY,
+	SECTION_ADDITIONAL
+};
+
+// One string of a TXT record, split at the first '=' (RFC 6763 section 6).
+// Points into the record's rdata; nothing is '\0' terminated.
+struct TxtEntry {
+	const char * key;
+	unsigned int key_length;
+	const char * value;           // NULL for a key given without '='.
+	unsigned int value_length;
+
+	// Compare the key with name, ignoring ASCII case.
+	bool keyEquals(const char *name) const;
+
+	// Copy the value, '\0' terminated. Returns false if it was truncated or
+	// there is no value.
+	bool getValue(char * buffer, int buffer_len) const;
+};
+
+// Walks the length prefixed strings of TXT rdata in place, however long.
+// Empty strings and strings without a key are skipped.
+//
+// eg:
+//   TxtIterator txt = record.getTxt();
+//   TxtEntry entry;
+//   while (txt.next(entry)) { ... }
+class TxtIterator {
+public:
+	TxtIterator() : rdata(NULL), rdlength(0), position(0) {}
+	TxtIterator(const byte * rdata_, unsigned int rdlength_) :
+			rdata(rdata_), rdlength(rdlength_), position(0) {}
+
+	// Step to the next string. Returns false at the end of the rdata or at
+	// a string overrunning it.
+	bool next(TxtEntry & entry);
+
+	// Find the first string with the given key, ignoring ASCII case. Later
+	// strings with the same key don't count (RFC 6763 section 6.4).
+	bool find(const char *key, TxtEntry & entry) const;
+
+	void rewind() {
+		position = 0;
+	}
+
+private:
+	const byte * rdata;
+	unsigned int rdlength;
+	unsigned int position;
+};
+
+// A question as it sits in the packet. Only the fixed size fields are
+// decoded; the name stays in data_buffer until asked for.
+// Only valid for the duration of the callback it was passed to.
+struct QuestionView {
+	const byte * packet;          // Start of the mDNS packet.
+	unsigned int packet_size;     // Size of the mDNS packet.
+	unsigned int name_offset;     // Position of QNAME in packet.
+	unsigned int qtype;           // Question Type.
+	unsigned int qclass;          // Question Class, without the unicast-response bit.
+	bool unicast_response;
+
+	// Expand QNAME as a dotted string. Returns false if it was truncated.
+	bool getName(char * buffer, int buffer_len) const;
+
+	// Decode the whole question into a Query.
+	void toQuery(Query & query) const;
+};
+
+// A resource record as it sits in the packet. Only the fixed size fields are
+// decoded; the name and rdata stay in data_buffer until asked for.
+// Only valid for the duration of the callback it was passed to.
+struct RecordView {
+	const byte * packet;          // Start of the mDNS packet.
+	unsigned int packet_size;     // Size of the mDNS packet.
+	Section section;              // Answer, Authority or Additional.
+	unsigned int name_offset;     // Position of the record name in packet.
+	unsigned int rrtype;          // ResourceRecord Type.
+	unsigned int rrclass;         // ResourceRecord Class, without the cache-flush bit.
+	unsigned long int rrttl;      // ResourceRecord Time To Live in seconds.
+	bool rrset;                   // Flush cache of records matching this name.
+	unsigned int rdata_offset;    // Position of the rdata in packet.
+	unsigned int rdlength;        // Length of the rdata.
+
+	// Expand the record name as a dotted string. Returns false if it was truncated.
+	bool getName(char * buffer, int buffer_len) const;
+
+	// Expand a name stored in the rdata, eg: offset 0 for PTR or 6 for SRV.
+	// Returns false if it was truncated.
+	bool getRdataName(char * buffer, int buffer_len, unsigned int offset = 0) const;
+
+	// Address carried by an A record.
+	IPAddress getIPv4() const;
+
+	// Copy the address carried by an AAAA record. Returns false if too short.
+	bool getIPv6(uint8_t address[16]) const;
+
+	// Port carried by an SRV record.
+	uint16_t getSrvPort() const;
+
+	// Strings carried by a TXT record, read in place in the packet.
+	TxtIterator getTxt() const {
+		return TxtIterator(packet + rdata_offset, rdlength);
+	}
+
+	// Decode the whole record into an Answer.
+	void toAnswer(Answer & answer) const;
+};
+
+// Walks the questions and resource records of a packet in place.
+// Each record is checked against the packet bounds before it is returned.
+//
+// eg:
+//   RecordIterator it = mdns->getRecordIterator();
+//   RecordView record;
+//   while (it.nextRecord(record)) { ... }
+class RecordIterator {
+public:
+	RecordIterator(const byte * packet, unsigned int packet_size);
+
+	// Step to the next question. Returns false once all questions are read
+	// or the packet turns out to be malformed.
+	bool nextQuestion(QuestionView & question);
+
+	// Step to the next resource record in the Answer, Authority or Additional
+	// section, skipping any questions not yet read. Returns false once all
+	// records are read or the packet turns out to be malformed.
+	bool nextRecord(RecordView & record);
+
+	// True if the packet was found to be malformed.
+	bool malformed() const {
+		return error;
+	}
+
+private:
+	const byte * packet;
+	unsigned int packet_size;
+	unsigned int position;
+	unsigned int questions_left;
+	unsigned int answers_left;
+	unsigned int authority_left;
+	unsigned int additional_left;
+	bool error;
+};
+
+// A resource record held in RecordCache. Names, including those in the rdata
+// of PTR and SRV records, are stored uncompressed in wire format.
+struct CacheEntry {
+	byte name[MDNS_CACHE_NAME_LEN];
+	byte rdata[MDNS_CACHE_RDATA_SIZE];
+	uint32_t name_hash;           // hashDnsName() of name.
+	unsigned long received;       // millis() when the record was last seen.
+	unsigned long rrttl;          // Time To Live in seconds. 0 if unused.
+	uint16_t rrtype;
+	uint16_t rrclass;
+	uint16_t rdlength;
+	uint8_t name_length;
+	bool truncated;               // TXT strings past MDNS_CACHE_TXT_LEN left out.
+
+	// Milliseconds until the record expires. 0 if expired or unused.
+	unsigned long remaining(unsigned long now) const;
+
+	// Expand the record name as a dotted string.
+	bool getName(char * buffer, int buffer_len) const;
+
+	// Expand a name stored in the rdata, eg: offset 0 for PTR or 6 for SRV.
+	bool getRdataName(char * buffer, int buffer_len, unsigned int offset = 0) const;
+
+	// Address carried by an A record.
+	IPAddress getIPv4() const;
+
+	// Copy the address carried by an AAAA record. Returns false if too short.
+	bool getIPv6(uint8_t address[16]) const;
+
+	// Port carried by an SRV record.
+	uint16_t getSrvPort() const;
+
+	// Strings carried by a TXT record, only the leading ones if truncated.
+	TxtIterator getTxt() const {
+		return TxtIterator(rdata, rdlength);
+	}
+};
+
+// Fixed capacity cache of the resource records seen in responses, kept in a
+// pool of CacheEntry supplied by the owner.
+// Follows RFC 6762 section 10: records expire after their TTL, a record with
+// the cache-flush bit set replaces older records of the same name, type and
+// class, and a TTL of 0 ("goodbye") removes the record.
+class RecordCache {
+public:
+	RecordCache(CacheEntry *entries_, unsigned int capacity_);
+
+	// Store a record, refreshing it if already cached. Only A, AAAA, PTR, SRV
+	// and TXT records are kept, and of a long TXT record the strings which
+	// fit. When full, the record closest to expiry makes way.
+	void insert(const RecordView &record, unsigned long now);
+
+	// Find an unexpired record by name, type and class. Pass the previous
+	// result as after to step through all records of an RRset.
+	const CacheEntry * find(const DnsName &name, unsigned int rrtype,
+			unsigned long now, const CacheEntry *after = NULL,
+			unsigned int rrclass = 1) const;
+
+	// As above, for a name in wire format such as the rdata of a CacheEntry.
+	const CacheEntry * find(const byte *wire_name, unsigned int rrtype,
+			unsigned long now, const CacheEntry *after = NULL,
+			unsigned int rrclass = 1) const;
+
+	void clear();
+
+	unsigned int getCapacity() const {
+		return capacity;
+	}
+
+private:
+	CacheEntry *entries;
+	unsigned int capacity;
+};
+
+// Kinds of packet a Callback wants to see, see Callback::getInterest().
+enum Interest {
+	INTEREST_QUERIES = 0x01,          // Questions of other hosts.
+	INTEREST_RESPONSES = 0x02,        // Answers, which the cache keeps too.
+	INTEREST_ALL = 0x03,
+	INTEREST_QUESTION_FILTER = 0x04   // Only queries with a question for
+	                                  // which isInterestingQuestion() holds.
+};
+
 class Callback {
 public:
 	virtual ~Callback()
@@ -70,8 +408,54 @@ public:
 		//
 	}
 	virtual void onPacket(const MDns* packet) {};
+
+	// Kinds of packet the callback wants, from enum Interest. MDns drops a
+	// packet no callback or listener wants on its 12 byte header, before any
+	// callback or the cache sees it. eg: a client only wants responses.
+	virtual uint8_t getInterest() const {
+		return INTEREST_ALL;
+	}
+
+	// With INTEREST_QUESTION_FILTER: whether a question with this name
+	// hash, see hashDnsName(), and type may concern the callback. When every
+	// callback wanting queries filters them, a query none of them finds a
+	// question of interest in is dropped once its questions are read, before
+	// any callback is called.
+	virtual bool isInterestingQuestion(uint32_t name_hash,
+			unsigned int qtype) const {
+		return true;
+	}
+
+	// With INTEREST_QUESTION_FILTER: whether a query from asker, none of
+	// whose questions is of interest, still concerns the callback, eg: one
+	// carrying more Known Answers for a truncated query (RFC 6762 section
+	// 7.2), which usually has no questions at all.
+	virtual bool isInterestingAsker(IPAddress asker) const {
+		return false;
+	}
+
+	// Called for every question in an incoming packet. The default decodes
+	// it into a Query and calls onQuery(). Override to skip the decoding of
+	// questions which are of no interest.
+	virtual void onQuestion(const QuestionView& question);
+
+	// Called for every resource record in an incoming packet. The default
+	// decodes it into an Answer and calls onAnswer(). Override to skip the
+	// decoding of records which are of no interest.
+	virtual void onRecord(const RecordView& record);
+
 	virtual void onQuery(const Query* query) {};
 	virtual void onAnswer(const Answer* answer) {};
+
+	// Called at the end of every MDns::loop(), whether a packet arrived or
+	// not. The packet has been handled by then, so the buffer may be used to
+	// build and send packets.
+	virtual void onLoop(MDns* mdns) {};
+
+private:
+	friend class MDns;
+	Callback * _next_listener = NULL;  // Link in MDns' list of listeners.
+	bool _subscribed = false;  // Only gets what it subscribed to.
 };
 
 class MDns {
@@ -79,11 +463,19 @@ private:
 	Print * debug = NULL;
 public:
 
+	// Uses data_buffer_ for packets if given, otherwise allocates a buffer
+	// of max_packet_size_ bytes. The MDNS_CACHE_ENTRIES entries of the record
+	// cache are allocated too. Use BasicMDns for storage fixed at compile time.
 	MDns(WiFiUDP& udp, byte *data_buffer_ = NULL, int max_packet_size_ = MAX_PACKET_SIZE, Print * debug_ = &Serial):
 #ifdef DEBUG_STATISTICS
 		buffer_size_fail(0), largest_packet_seen(0), packet_count(0),
+		dropped_count(0),
 #endif
-		buffer_pointer(0), max_packet_size(max_packet_size_)
+		buffer_pointer(0), max_packet_size(max_packet_size_),
+		owns_buffer(data_buffer_ == NULL),
+		cache_entries(MDNS_CACHE_ENTRIES > 0 ?
+				new CacheEntry[MDNS_CACHE_ENTRIES] : NULL),
+		cache(cache_entries, MDNS_CACHE_ENTRIES)
 	{
 		if (data_buffer_ != NULL)
 		{
@@ -96,7 +488,7 @@ public:
 		this->debug = debug_;
 	};
 
-	~MDns();
+	virtual ~MDns();
 
 // added to call startUdpMulticast
 	void begin();
@@ -107,8 +499,9 @@ public:
 	// Send this MDns packet.
 	void Send() const;
 
-	// Send this MDns packet to a unicast address
-	void SendUnicast(IPAddress) const;
+	// Send this MDns packet to a unicast address, at the mDNS port unless the
+	// reply goes to a legacy resolver's port (RFC 6762 section 6.7).
+	void SendUnicast(IPAddress addr, uint16_t port = MDNS_TARGET_PORT) const;
 
 	// Resets everything to represent an empty packet.
 	// Do this before building a packet for sending.
@@ -116,11 +509,66 @@ public:
 
 	// Add a query to packet prior to sending.
 	// May only be done before any Answers have been added.
+	// Returns false, leaving the packet unchanged, if the query does not fit
+	// in max_packet_size. Send the packet and start another one.
 	bool AddQuery(const Query &query);
 
-	// Add an answer to packet prior to sending.
+	// Add a question whose name is already in wire format. Set bit 0x8000 of
+	// qclass to ask for a unicast reply.
+	// Returns false, leaving the packet unchanged, if it does not fit.
+	bool AddRawQuery(const byte *name, unsigned int name_length,
+			unsigned int qtype, unsigned int qclass);
+
+	// Add an answer to packet prior to sending. The rdata is taken from:
+	//   A:    ipAddress, or the 4 bytes of rdata_buffer if it is INADDR_NONE.
+	//   AAAA: ipv6, or the 16 bytes of rdata_buffer if it is all zeros.
+	//   PTR:  the dotted name in rdata_buffer.
+	//   SRV:  priority, weight, port, and the dotted target host name in
+	//         rdata_buffer.
+	//   TXT:  the first rdlength bytes of rdata_buffer, as received: each
+	//         string preceded by its length. An rdlength of 0 sends one empty
+	//         string.
+	// Returns false, leaving the packet unchanged, if the answer does not fit
+	// or its type is not supported.
 	bool AddAnswer(const Answer &answer);
 
+	// As AddAnswer(), into the Authority or Additional section. Sections
+	// follow each other, so add all the answers first, then the authority
+	// records, then the additional records. The packet flags are left alone.
+	// Additional records let a response carry everything needed to use the
+	// answers, eg: the SRV, TXT and A records of a service along with its PTR
+	// record (RFC 6763 section 12).
+	bool AddAuthority(const Answer &answer);
+	bool AddAdditional(const Answer &answer);
+
+	// Add a cached record to the Answer section of a query, listing it as a
+	// Known Answer (RFC 6762 section 7.1) with its remaining TTL. Add all the
+	// queries first. The packet stays a query.
+	// Returns false, leaving the packet unchanged, if the record does not fit.
+	bool AddKnownAnswer(const CacheEntry &entry, unsigned long now);
+
+	// Add an answer whose name and rdata are already in wire format.
+	// rdata_name_offset is where a name starts in the rdata, so it can be
+	// compressed: 0 for PTR, 6 for SRV, rdlength if there is none.
+	// Returns false, leaving the packet unchanged, if the record does not fit.
+	bool AddRawAnswer(const byte *name, unsigned int name_length,
+			unsigned int rrtype, unsigned int rrclass, unsigned long rrttl,
+			const byte *rdata, unsigned int rdlength,
+			unsigned int rdata_name_offset);
+
+	// As AddRawAnswer(), into the Authority section. Probes list the records
+	// they propose there (RFC 6762 section 8.2). The packet stays a query.
+	bool AddRawAuthority(const byte *name, unsigned int name_length,
+			unsigned int rrtype, unsigned int rrclass, unsigned long rrttl,
+			const byte *rdata, unsigned int rdlength,
+			unsigned int rdata_name_offset);
+
+	// As AddRawAnswer(), into the Additional section.
+	bool AddRawAdditional(const byte *name, unsigned int name_length,
+			unsigned int rrtype, unsigned int rrclass, unsigned long rrttl,
+			const byte *rdata, unsigned int rdlength,
+			unsigned int rdata_name_offset);
+
 	// Display a summary of the packet on Serial port.
 	void Display() const;
 
@@ -128,7 +576,42 @@ public:
 	void DisplayRawPacket() const;
 
 	// Get the source IP address of the packet
-	IPAddress getRemoteIP();
+	IPAddress getRemoteIP() const;
+
+	// Source port of the packet. Queries from a port other than 5353 come
+	// from legacy resolvers, which want a plain DNS reply (RFC 6762 section
+	// 6.7).
+	uint16_t getRemotePort() const {
+		return srcPort;
+	}
+
+	// ID of the packet received last. Only legacy queries set it; their
+	// replies must repeat it.
+	uint16_t getQueryId() const {
+		return query_id;
+	}
+
+	// Set the ID of the packet being built. Clear() resets it to 0.
+	void setQueryId(uint16_t id) {
+		data_buffer[0] = id >> 8;
+		data_buffer[1] = id & 0xFF;
+	}
+
+	// Set the TC bit of the query being built: more Known Answers follow in
+	// the next packet (RFC 6762 section 7.2). Clear() resets it.
+	void setTruncated() {
+		data_buffer[2] |= 0b00000010;
+	}
+
+	// Whether the packet received last is a query rather than a response.
+	bool isQuery() const {
+		return type;
+	}
+
+	// Whether the sender has more Known Answers to come in further packets.
+	bool isTruncated() const {
+		return truncated;
+	}
 
 	// Get the destination IP address of the packet (unicast or multicast)
 	IPAddress getDestinationIP();
@@ -141,6 +624,33 @@ public:
 		return this->_callback;
 	}
 
+	// Listeners get the same events as the callback set with setCallback(),
+	// after it. Unlike the callback they are not replaced by setCallback(),
+	// so library components such as MDNSClient can stay registered.
+	void addListener(Callback * listener);
+	void removeListener(Callback * listener);
+
+	// Have a listener called only for the questions and records of type
+	// rrtype, and only those named name if it is not NULL, eg: the PTR
+	// records of "_mqtt._tcp.local". Subscribe again for other kinds. The
+	// listener is added if need be; addListener() makes it get everything
+	// again. Questions and records nobody subscribed to are skipped on their
+	// type and name hash, before anything of them is decoded.
+	// name is kept, not copied, until removeListener().
+	// Returns false if MDNS_SUBSCRIPTIONS are in use or name is not valid.
+	bool subscribe(Callback * listener, unsigned int rrtype,
+			const char * name = NULL);
+
+	// Walk the questions and records of the current packet without copying them.
+	RecordIterator getRecordIterator() const {
+		return RecordIterator(data_buffer, data_size);
+	}
+
+	// Records collected from the responses seen by loop().
+	RecordCache& getCache() {
+		return cache;
+	}
+
 #ifdef DEBUG_STATISTICS
 	// Counter gets increased every time an incoming mDNS packet arrives that does
 	// not fit in the data_buffer.
@@ -152,18 +662,77 @@ public:
 
 	// How many mDNS packets have arrived so far.
 	unsigned int packet_count;
+
+	// How many of them no callback was interested in. See Callback::getInterest().
+	unsigned int dropped_count;
+#endif
+protected:
+	// For subclasses which supply the packet buffer and the cache entries.
+	// They are not freed.
+	MDns(WiFiUDP& udp, byte *data_buffer_, unsigned int max_packet_size_,
+			CacheEntry *cache_entries_, unsigned int cache_capacity_,
+			Print * debug_):
+#ifdef DEBUG_STATISTICS
+		buffer_size_fail(0), largest_packet_seen(0), packet_count(0),
+		dropped_count(0),
 #endif
+		buffer_pointer(0), data_buffer(data_buffer_),
+		max_packet_size(max_packet_size_), owns_buffer(false),
+		cache_entries(cache_entries_), cache(cache_entries, cache_capacity_),
+		owns_cache(false)
+	{
+		this->udp = &udp;
+		this->debug = debug_;
+	};
+
 private:
+	MDns(const MDns&);
+	MDns& operator=(const MDns&);
+
 	// Initializes udp multicast
 	uint8_t startUdpMulticast();
 
-	void Parse_Query(Query &query);
-	void Parse_Answer(Answer &answer);
+	bool receive();
+	bool isInteresting() const;
+	const Callback * nextCallback(const Callback * l) const;
+	bool AddAnswerRecord(Section section, const Answer &answer);
+	bool AddRecord(Section section, const byte *name,
+			unsigned int name_length, unsigned int rrtype, unsigned int rrclass,
+			unsigned long rrttl, const byte *rdata, unsigned int rdlength,
+			unsigned int rdata_name_offset);
+	unsigned int reserve(unsigned int needed) const;
 	unsigned int PopulateName(const char *name_buffer);
-	void PopulateAnswerResult(Answer *answer);
+	unsigned int PopulateWireName(const byte *wire, unsigned int length);
 	void PrintHex(const unsigned char data) const;
 
+	struct Subscription {
+		Callback * listener;
+		const char * name;  // NULL for any name.
+		uint32_t hash;      // hashDnsName() of name.
+		uint16_t type;
+	};
+
+	bool wants(const Subscription &subscription, unsigned int type,
+			unsigned int name_offset, uint32_t &hash) const;
+	void dropSubscriptions(Callback * listener);
+
 	Callback * _callback = NULL;
+	Callback * _listeners = NULL;
+
+	// Subscriptions of the listeners which have any, those of a listener
+	// next to each other.
+	Subscription subscriptions[MDNS_SUBSCRIPTIONS];
+	unsigned int subscription_count = 0;
+
+	// Bit type % 32 set for every type subscribed to: no subscriber wants a
+	// question or record whose bit is clear.
+	uint32_t subscribed_types = 0;
+
+	// While listeners are being called: the next one to call, and the index
+	// of the subscription being served, else -1. removeListener() and
+	// subscribe() keep both right when a callback changes the listeners.
+	Callback * dispatch_next = NULL;
+	int dispatch_at = -1;
 
 	WiFiUDP* udp;
 
@@ -176,12 +745,18 @@ private:
 	// Buffer size for incoming MDns packet.
 	unsigned int max_packet_size;
 
+	// Whether data_buffer was allocated by the constructor.
+	bool owns_buffer;
+
 	// Size of mDNS packet.
 	unsigned int data_size = 0;
 
 	// Query or Answer
 	bool type = false;
 
+	// ID of the packet received last.
+	uint16_t query_id = 0;
+
 	// Whether more follows in another packet.
 	bool truncated = false;
 
@@ -194,23 +769,109 @@ private:
 	unsigned int ns_count = 0;
 	unsigned int ar_count = 0;
 
+	// Suffixes of the names written to the packet being built, which later
+	// names can point to.
+	struct NameOffset {
+		uint32_t hash;    // hashDnsName() of the suffix.
+		uint16_t offset;  // Where it starts in data_buffer.
+	};
+	NameOffset name_offsets[MDNS_COMPRESSION_ENTRIES];
+	unsigned int name_offset_count = 0;
+
 	// source & destination IP for incoming UDP packet
 	IPAddress srcIP;
 	IPAddress destIP;
+	uint16_t srcPort = 0;
+
+	// Pool backing cache.
+	CacheEntry *cache_entries;
+	RecordCache cache;
+
+	// Whether cache_entries was allocated by the constructor.
+	bool owns_cache = true;
+};
+
+// Storage of a BasicMDns. A base class, so it is in place before MDns is
+// constructed.
+template<unsigned int PacketSize, unsigned int CacheEntries>
+struct BasicMDnsStorage {
+	byte packet_storage[PacketSize];
+	// Always at least one entry so the array is legal.
+	CacheEntry cache_storage[CacheEntries > 0 ? CacheEntries : 1];
+};
+
+// MDns whose packet buffer and record cache are members, sized at compile
+// time, so it allocates nothing. A global or static one takes a fixed amount
+// of RAM known at link time.
+// eg:
+//   BasicMDns<512, 8> mdns(udp);  // 512 byte packets, 8 cached records.
+// It is an MDns, so MDNSClient and MDNSResponder take it as one.
+template<unsigned int PacketSize = MAX_PACKET_SIZE,
+		unsigned int CacheEntries = MDNS_CACHE_ENTRIES>
+class BasicMDns : private BasicMDnsStorage<PacketSize, CacheEntries>,
+		public MDns {
+public:
+	BasicMDns(WiFiUDP& udp, Print * debug_ = &Serial) :
+			MDns(udp, this->packet_storage, PacketSize, this->cache_storage,
+					CacheEntries, debug_) {}
 };
 
 // Display a byte on serial console in hexadecimal notation,
 // padding with leading zero if necessary to provide evenly tabulated display data.
 void PrintHex(unsigned char data);
 
-// Extract Name from DNS data. Will follow pointers used by Message Compression.
-// TODO Check for exceeding packet size.
-int nameFromDnsPointer(char *p_name_buffer, int name_buffer_pos,
+// Extract Name from DNS data as a dotted string, starting at name_buffer_pos.
+// Will follow pointers used by Message Compression, at most
+// MAX_MDNS_NAME_JUMPS of them. Never reads past packet_size and uses a fixed
+// amount of stack. Names which don't fit are truncated.
+// Returns the position following the name in the packet, or -1 if the name is
+// malformed.
+int decodeDnsName(char *p_name_buffer, int name_buffer_pos,
 		const int name_buffer_len, const byte *p_packet_buffer,
-		int packet_buffer_pos);
+		const int packet_size, int packet_buffer_pos);
+
+// As decodeDnsName() for callers which don't know the packet size.
+// Pointer loops are still caught but reads are only bounded by the range a
+// compression pointer can reach. Prefer decodeDnsName().
 int nameFromDnsPointer(char *p_name_buffer, int name_buffer_pos,
 		const int name_buffer_len, const byte *p_packet_buffer,
-		int packet_buffer_pos, const bool recurse);
+		int packet_buffer_pos);
+
+// Find the end of the DNS name starting at packet_buffer_pos without expanding it.
+// Returns the position following the name, or -1 if it runs past packet_size
+// or its labels add up to more than MAX_DNS_NAME_WIRE_LEN.
+int skipDnsName(const byte *p_packet_buffer, int packet_size,
+		int packet_buffer_pos);
+
+// Compare the (possibly compressed) name at packet_buffer_pos with a name in
+// wire format, following compression pointers. Case-insensitive for ASCII.
+bool dnsNameEquals(const byte *p_packet_buffer, int packet_size,
+		int packet_buffer_pos, const byte *wire_name);
+
+// Compare the (possibly compressed) name at packet_buffer_pos with a dotted
+// name as produced by nameFromDnsPointer(). Case-insensitive for ASCII.
+bool dnsNameEquals(const byte *p_packet_buffer, int packet_size,
+		int packet_buffer_pos, const char *name);
+
+// Hash of the lower cased labels of the name at packet_buffer_pos, following
+// compression pointers. Equal names hash the same however they are
+// compressed, and the same as DnsName::getHash(). Returns 0 if malformed or
+// longer than MAX_DNS_NAME_WIRE_LEN.
+uint32_t hashDnsName(const byte *p_packet_buffer, int packet_size,
+		int packet_buffer_pos);
+
+// Copy the (possibly compressed) name at packet_buffer_pos into wire_name
+// without compression. Returns the length written, or -1 if the name is
+// malformed or longer than wire_name_len.
+int copyDnsName(byte *wire_name, const int wire_name_len,
+		const byte *p_packet_buffer, const int packet_size,
+		int packet_buffer_pos);
+
+// Encode a dotted name, eg: "mydevice.local", into wire_name in wire format.
+// Returns the length written, which is less than wire_name_len, or -1 if a
+// label is empty or longer than 63 bytes, or the name doesn't fit.
+int encodeDnsName(byte *wire_name, const int wire_name_len,
+		const char *name);
 
 bool writeToBuffer(const byte value, char *p_name_buffer,
 		int *p_name_buffer_pos, const int name_buffer_len);